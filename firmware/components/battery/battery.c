@@ -0,0 +1,105 @@
+#include "battery.h"
+#include "battery_filter.h"
+
+#if CONFIG_BATTERY_ADC_ENABLE
+
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_log.h"
+
+static const char *TAG = "BATTERY";
+
+static adc_oneshot_unit_handle_t s_adc = NULL;
+static adc_cali_handle_t s_cali = NULL;
+static battery_filter_t s_filter;
+
+esp_err_t battery_init(void)
+{
+    if (s_adc != NULL) {
+        return ESP_OK;
+    }
+
+    const adc_oneshot_unit_init_cfg_t unit_cfg = {
+        .unit_id = ADC_UNIT_1,
+    };
+    esp_err_t err = adc_oneshot_new_unit(&unit_cfg, &s_adc);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // 12 dB covers up to about 3.1 V at the pin, 6.2 V at the battery with the default divider
+    const adc_oneshot_chan_cfg_t chan_cfg = {
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    err = adc_oneshot_config_channel(s_adc, CONFIG_BATTERY_ADC_CHANNEL, &chan_cfg);
+    if (err == ESP_OK) {
+        const adc_cali_curve_fitting_config_t cali_cfg = {
+            .unit_id = ADC_UNIT_1,
+            .chan = CONFIG_BATTERY_ADC_CHANNEL,
+            .atten = ADC_ATTEN_DB_12,
+            .bitwidth = ADC_BITWIDTH_DEFAULT,
+        };
+        err = adc_cali_create_scheme_curve_fitting(&cali_cfg, &s_cali);
+    }
+    if (err != ESP_OK) {
+        adc_oneshot_del_unit(s_adc);
+        s_adc = NULL;
+        return err;
+    }
+
+    battery_filter_init(&s_filter, CONFIG_BATTERY_FILTER_SHIFT, CONFIG_BATTERY_HYSTERESIS_PCT);
+    ESP_LOGI(TAG, "Battery on ADC1 channel %d, divider %d/100", CONFIG_BATTERY_ADC_CHANNEL,
+             CONFIG_BATTERY_DIVIDER_RATIO_X100);
+    return ESP_OK;
+}
+
+esp_err_t battery_sample(uint8_t *percent)
+{
+    if (s_adc == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint16_t readings[CONFIG_BATTERY_OVERSAMPLE];
+    for (int i = 0; i < CONFIG_BATTERY_OVERSAMPLE; i++) {
+        int raw, pin_mv;
+        esp_err_t err = adc_oneshot_read(s_adc, CONFIG_BATTERY_ADC_CHANNEL, &raw);
+        if (err == ESP_OK) {
+            err = adc_cali_raw_to_voltage(s_cali, raw, &pin_mv);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        readings[i] = pin_mv * CONFIG_BATTERY_DIVIDER_RATIO_X100 / 100;
+    }
+
+    uint16_t mv = battery_filter_oversample(readings, CONFIG_BATTERY_OVERSAMPLE);
+    *percent = battery_filter_update(&s_filter, mv);
+    ESP_LOGD(TAG, "Battery %d mV, filtered %d mV, %d%%", mv, battery_filter_mv(&s_filter), *percent);
+    return ESP_OK;
+}
+
+uint16_t battery_voltage_mv(void)
+{
+    return battery_filter_mv(&s_filter);
+}
+
+#else
+
+esp_err_t battery_init(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t battery_sample(uint8_t *percent)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+uint16_t battery_voltage_mv(void)
+{
+    return 0;
+}
+
+#endif
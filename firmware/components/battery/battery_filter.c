@@ -0,0 +1,96 @@
+#include "battery_filter.h"
+
+// Single-cell LiPo at rest, light load
+static const struct {
+    uint16_t mv;
+    uint8_t percent;
+} s_curve[] = {
+    { 4200, 100 },
+    { 4110, 90 },
+    { 4020, 80 },
+    { 3950, 70 },
+    { 3870, 60 },
+    { 3840, 50 },
+    { 3800, 40 },
+    { 3770, 30 },
+    { 3730, 20 },
+    { 3690, 10 },
+    { 3610, 5 },
+    { 3270, 0 },
+};
+
+#define CURVE_POINTS (sizeof(s_curve) / sizeof(s_curve[0]))
+
+uint8_t battery_mv_to_percent(uint16_t mv)
+{
+    if (mv >= s_curve[0].mv) {
+        return 100;
+    }
+    for (size_t i = 1; i < CURVE_POINTS; i++) {
+        if (mv >= s_curve[i].mv) {
+            uint32_t span_mv = s_curve[i - 1].mv - s_curve[i].mv;
+            uint32_t span_pct = s_curve[i - 1].percent - s_curve[i].percent;
+            return s_curve[i].percent + ((mv - s_curve[i].mv) * span_pct + span_mv / 2) / span_mv;
+        }
+    }
+    return 0;
+}
+
+void battery_filter_init(battery_filter_t *filter, uint8_t shift, uint8_t hysteresis_pct)
+{
+    filter->shift = shift;
+    filter->hysteresis_pct = hysteresis_pct;
+    filter->primed = false;
+    filter->filtered_mv_x256 = 0;
+    filter->percent = 0;
+}
+
+uint16_t battery_filter_oversample(uint16_t *readings, size_t count)
+{
+    // Insertion sort: a few dozen readings at most
+    for (size_t i = 1; i < count; i++) {
+        uint16_t value = readings[i];
+        size_t j = i;
+        while (j > 0 && readings[j - 1] > value) {
+            readings[j] = readings[j - 1];
+            j--;
+        }
+        readings[j] = value;
+    }
+
+    size_t trim = count / 4;
+    uint32_t sum = 0;
+    for (size_t i = trim; i < count - trim; i++) {
+        sum += readings[i];
+    }
+    size_t kept = count - 2 * trim;
+    return (sum + kept / 2) / kept;
+}
+
+uint8_t battery_filter_update(battery_filter_t *filter, uint16_t mv)
+{
+    int32_t sample = (int32_t)mv << 8;
+
+    if (!filter->primed) {
+        filter->primed = true;
+        filter->filtered_mv_x256 = sample;
+        filter->percent = battery_mv_to_percent(mv);
+        return filter->percent;
+    }
+
+    int32_t state = (int32_t)filter->filtered_mv_x256;
+    state += (sample - state) / (1 << filter->shift);
+    filter->filtered_mv_x256 = state;
+
+    uint8_t level = battery_mv_to_percent(battery_filter_mv(filter));
+    int diff = level > filter->percent ? level - filter->percent : filter->percent - level;
+    if (diff != 0 && diff >= filter->hysteresis_pct) {
+        filter->percent = level;
+    }
+    return filter->percent;
+}
+
+uint16_t battery_filter_mv(const battery_filter_t *filter)
+{
+    return (filter->filtered_mv_x256 + 128) >> 8;
+}
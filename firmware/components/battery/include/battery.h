@@ -0,0 +1,39 @@
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Set up the ADC channel and its calibration
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if the ADC path is disabled
+ */
+esp_err_t battery_init(void);
+
+/**
+ * @brief Take one oversampled reading and update the filtered level
+ *
+ * Call while the radio and the LEDs are idle: their current pulls the
+ * voltage down. Takes well under a millisecond.
+ *
+ * @param[out] percent Reported level after filtering and hysteresis
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized
+ */
+esp_err_t battery_sample(uint8_t *percent);
+
+/**
+ * @brief Filtered battery voltage in mV, 0 before the first sample
+ */
+uint16_t battery_voltage_mv(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BATTERY_H
@@ -0,0 +1,77 @@
+#ifndef BATTERY_FILTER_H
+#define BATTERY_FILTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Battery voltage to level pipeline, without hardware dependencies so the
+ * host tests can replay voltage traces through it:
+ *
+ *   readings -> battery_filter_oversample() -> battery_filter_update()
+ *            -> low-pass -> battery_mv_to_percent() -> hysteresis
+ */
+
+typedef struct {
+    uint8_t shift;              // Low-pass: 1/2^shift of the difference per sample
+    uint8_t hysteresis_pct;
+    bool primed;                // First sample seen
+    uint32_t filtered_mv_x256;  // Low-pass state, fixed point
+    uint8_t percent;            // Reported level
+} battery_filter_t;
+
+/**
+ * @brief Reset a filter
+ *
+ * @param filter Filter state
+ * @param shift Low-pass shift, 0 for none
+ * @param hysteresis_pct Distance the level must move before it is reported
+ */
+void battery_filter_init(battery_filter_t *filter, uint8_t shift, uint8_t hysteresis_pct);
+
+/**
+ * @brief Combine back-to-back readings into one sample
+ *
+ * Sorts the readings in place and averages the middle half, so a quarter of
+ * them can be pulled down by a load step without moving the result.
+ *
+ * @param readings Readings in mV, reordered
+ * @param count Number of readings, at least 1
+ * @return Trimmed mean in mV
+ */
+uint16_t battery_filter_oversample(uint16_t *readings, size_t count);
+
+/**
+ * @brief Feed one sample and get the level to report
+ *
+ * The first sample sets the filter and the level directly.
+ *
+ * @param filter Filter state
+ * @param mv Sample in mV
+ * @return Reported level in percent
+ */
+uint8_t battery_filter_update(battery_filter_t *filter, uint16_t mv);
+
+/**
+ * @brief Filtered voltage in mV, 0 before the first sample
+ */
+uint16_t battery_filter_mv(const battery_filter_t *filter);
+
+/**
+ * @brief Single-cell LiPo level at rest, interpolated from a discharge curve
+ *
+ * @param mv Cell voltage in mV
+ * @return Level in percent, 0 to 100
+ */
+uint8_t battery_mv_to_percent(uint16_t mv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BATTERY_FILTER_H
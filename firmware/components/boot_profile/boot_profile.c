@@ -0,0 +1,93 @@
+#include "boot_profile.h"
+#include "esp_timer.h"
+
+#if CONFIG_BOOT_PROFILE_ENABLE
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include <stddef.h>
+#include <string.h>
+
+static const char *TAG = "BOOT_PROFILE";
+
+typedef struct {
+    const char *phase;
+    int64_t at_us;
+} boot_mark_t;
+
+static boot_mark_t s_marks[CONFIG_BOOT_PROFILE_MAX_PHASES];
+static size_t s_count = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+uint32_t boot_profile_mark(const char *phase)
+{
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_count < CONFIG_BOOT_PROFILE_MAX_PHASES) {
+        s_marks[s_count].phase = phase;
+        s_marks[s_count].at_us = now;
+        s_count++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return (uint32_t)(now / 1000);
+}
+
+int32_t boot_profile_get_ms(const char *phase)
+{
+    int32_t ms = -1;
+
+    taskENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < s_count; i++) {
+        if (strcmp(s_marks[i].phase, phase) == 0) {
+            ms = (int32_t)(s_marks[i].at_us / 1000);
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return ms;
+}
+
+void boot_profile_report(void)
+{
+    boot_mark_t marks[CONFIG_BOOT_PROFILE_MAX_PHASES];
+    size_t count;
+
+    // Copy out so no log call runs in the critical section
+    taskENTER_CRITICAL(&s_lock);
+    count = s_count;
+    memcpy(marks, s_marks, count * sizeof(marks[0]));
+    taskEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "Boot timeline, ms since start-up (+ms since the previous phase):");
+    int64_t prev_us = 0;
+    for (size_t i = 0; i < count; i++) {
+        ESP_LOGI(TAG, "  %-14s %6lu  +%lu", marks[i].phase,
+                 (unsigned long)(marks[i].at_us / 1000),
+                 (unsigned long)((marks[i].at_us - prev_us) / 1000));
+        prev_us = marks[i].at_us;
+    }
+    if (count == CONFIG_BOOT_PROFILE_MAX_PHASES) {
+        ESP_LOGW(TAG, "Phase table full, later marks were dropped");
+    }
+}
+
+#else // CONFIG_BOOT_PROFILE_ENABLE
+
+uint32_t boot_profile_mark(const char *phase)
+{
+    (void)phase;
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+int32_t boot_profile_get_ms(const char *phase)
+{
+    (void)phase;
+    return -1;
+}
+
+void boot_profile_report(void)
+{
+}
+
+#endif // CONFIG_BOOT_PROFILE_ENABLE
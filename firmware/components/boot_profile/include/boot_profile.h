@@ -0,0 +1,39 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Record that a boot phase has been reached
+ *
+ * Safe to call from any task or an esp_timer callback, not from an ISR.
+ *
+ * @param phase Phase name, must have static storage
+ * @return Milliseconds since start-up
+ */
+uint32_t boot_profile_mark(const char *phase);
+
+/**
+ * @brief Look up when a phase was reached
+ *
+ * @param phase Phase name, compared by content
+ * @return Milliseconds since start-up of its first mark, -1 if not reached
+ *         or the profile is disabled
+ */
+int32_t boot_profile_get_ms(const char *phase);
+
+/**
+ * @brief Log the phases recorded so far with the time spent in each
+ */
+void boot_profile_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_PROFILE_H
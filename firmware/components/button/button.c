@@ -0,0 +1,223 @@
+#include "button.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+_Static_assert(CONFIG_BUTTON_LONG_PRESS_MS < CONFIG_BUTTON_RESET_WARNING_MS &&
+               CONFIG_BUTTON_RESET_WARNING_MS < CONFIG_BUTTON_RESET_CRITICAL_MS &&
+               CONFIG_BUTTON_RESET_CRITICAL_MS < CONFIG_BUTTON_RESET_HOLD_MS,
+               "Button hold thresholds must be increasing");
+
+/*
+ * The pin keeps a level interrupt armed for the level that would end the
+ * debounced state: the active level while released, the other one while
+ * pressed. Unlike an edge, a level is still seen if it was reached while
+ * the interrupt was off, so nothing is lost between sampling and re-arming,
+ * and the same level serves as the light sleep wakeup level.
+ *
+ * The ISR only disables the interrupt and starts the debounce timer. All
+ * state lives in the two timer callbacks, which the esp_timer task runs one
+ * at a time, so it needs no lock. Each button has its own pair of timers
+ * and its own state; the callbacks get the button as their argument.
+ */
+
+typedef struct {
+    uint32_t ms;
+    button_event_t event;
+} hold_stage_t;
+
+static const hold_stage_t s_stages[] = {
+    { CONFIG_BUTTON_LONG_PRESS_MS,      BUTTON_EVENT_LONG_PRESS },
+    { CONFIG_BUTTON_RESET_WARNING_MS,   BUTTON_EVENT_RESET_WARNING },
+    { CONFIG_BUTTON_RESET_CRITICAL_MS,  BUTTON_EVENT_RESET_WARNING },
+    { CONFIG_BUTTON_RESET_HOLD_MS,      BUTTON_EVENT_RESET_HOLD },
+};
+
+#define STAGE_COUNT (sizeof(s_stages) / sizeof(s_stages[0]))
+
+typedef struct {
+    button_config_t config;
+    esp_timer_handle_t debounce_timer;
+    esp_timer_handle_t hold_timer;
+    bool pressed;
+    int64_t press_start_us;
+    size_t stage;               // Next hold stage while pressed
+} button_t;
+
+static button_t s_buttons[CONFIG_BUTTON_MAX_COUNT];
+static size_t s_count = 0;
+static volatile bool s_wakeup = false;
+
+static void emit(button_t *btn, button_event_t event, uint32_t hold_ms)
+{
+    button_evt_t evt = {
+        .event = event,
+        .hold_ms = hold_ms,
+    };
+    btn->config.callback(&evt, btn->config.arg);
+}
+
+static uint32_t held_ms(const button_t *btn)
+{
+    return (uint32_t)((esp_timer_get_time() - btn->press_start_us) / 1000);
+}
+
+static void arm_interrupt(button_t *btn)
+{
+    int level = btn->pressed ? !btn->config.active_level : btn->config.active_level;
+    gpio_int_type_t type = level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL;
+
+    if (s_wakeup) {
+        gpio_wakeup_enable(btn->config.gpio, type);     // Sets the interrupt type as well
+    } else {
+        gpio_set_intr_type(btn->config.gpio, type);
+    }
+    gpio_intr_enable(btn->config.gpio);
+}
+
+static void arm_hold_timer(button_t *btn)
+{
+    uint32_t held = held_ms(btn);
+    uint32_t due = s_stages[btn->stage].ms;
+    esp_timer_start_once(btn->hold_timer, due > held ? (uint64_t)(due - held) * 1000 : 0);
+}
+
+/* Timer callbacks */
+
+static void debounce_cb(void *arg)
+{
+    button_t *btn = arg;
+    bool pressed = gpio_get_level(btn->config.gpio) == btn->config.active_level;
+
+    if (pressed && !btn->pressed) {
+        btn->pressed = true;
+        // The edge came one debounce period ago
+        btn->press_start_us = esp_timer_get_time() - CONFIG_BUTTON_DEBOUNCE_MS * 1000;
+        btn->stage = 0;
+        emit(btn, BUTTON_EVENT_PRESS, 0);
+        arm_hold_timer(btn);
+    } else if (!pressed && btn->pressed) {
+        btn->pressed = false;
+        esp_timer_stop(btn->hold_timer);
+        if (btn->stage == 0) {
+            emit(btn, BUTTON_EVENT_TAP, held_ms(btn));
+        } else if (btn->stage < STAGE_COUNT) {
+            emit(btn, BUTTON_EVENT_RELEASE, held_ms(btn));
+        }
+    }
+
+    arm_interrupt(btn);
+}
+
+static void hold_cb(void *arg)
+{
+    button_t *btn = arg;
+    if (!btn->pressed || btn->stage >= STAGE_COUNT) {
+        return;
+    }
+
+    emit(btn, s_stages[btn->stage].event, held_ms(btn));
+    btn->stage++;
+    if (btn->stage < STAGE_COUNT) {
+        arm_hold_timer(btn);
+    }
+}
+
+static void button_isr(void *arg)
+{
+    button_t *btn = arg;
+    gpio_intr_disable(btn->config.gpio);
+    esp_timer_start_once(btn->debounce_timer, CONFIG_BUTTON_DEBOUNCE_MS * 1000);
+}
+
+/* Public API */
+
+esp_err_t button_init(const button_config_t *config)
+{
+    if (config == NULL || config->callback == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < s_count; i++) {
+        if (s_buttons[i].config.gpio == config->gpio) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    if (s_count == CONFIG_BUTTON_MAX_COUNT) {
+        return ESP_ERR_NO_MEM;
+    }
+    button_t *btn = &s_buttons[s_count];
+    btn->config = *config;
+
+    // Pull towards the released level, interrupt armed below
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << config->gpio),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = config->active_level ? GPIO_PULLUP_DISABLE : GPIO_PULLUP_ENABLE,
+        .pull_down_en = config->active_level ? GPIO_PULLDOWN_ENABLE : GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    esp_err_t err = gpio_config(&io_conf);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // A slot that failed half way keeps its timers for the next attempt
+    if (btn->debounce_timer == NULL) {
+        const esp_timer_create_args_t debounce_args = {
+            .callback = debounce_cb,
+            .arg = btn,
+            .name = "btn_debounce",
+        };
+        err = esp_timer_create(&debounce_args, &btn->debounce_timer);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    if (btn->hold_timer == NULL) {
+        const esp_timer_create_args_t hold_args = {
+            .callback = hold_cb,
+            .arg = btn,
+            .name = "btn_hold",
+        };
+        err = esp_timer_create(&hold_args, &btn->hold_timer);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {   // Already installed by someone else
+        return err;
+    }
+    err = gpio_isr_handler_add(config->gpio, button_isr, btn);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Released state: a button held at boot fires the interrupt right away
+    btn->pressed = false;
+    s_count++;
+    arm_interrupt(btn);
+    return ESP_OK;
+}
+
+esp_err_t button_enable_wakeup(void)
+{
+    if (s_count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = esp_sleep_enable_gpio_wakeup();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Re-arm from the timer task; if a debounce is already pending it does the same
+    s_wakeup = true;
+    for (size_t i = 0; i < s_count; i++) {
+        gpio_intr_disable(s_buttons[i].config.gpio);
+        esp_timer_start_once(s_buttons[i].debounce_timer, 0);
+    }
+    return ESP_OK;
+}
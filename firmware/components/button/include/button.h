@@ -0,0 +1,72 @@
+#ifndef BUTTON_H
+#define BUTTON_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    BUTTON_EVENT_PRESS,         // Debounced press
+    BUTTON_EVENT_TAP,           // Released before CONFIG_BUTTON_LONG_PRESS_MS
+    BUTTON_EVENT_LONG_PRESS,    // Still held at CONFIG_BUTTON_LONG_PRESS_MS
+    BUTTON_EVENT_RESET_WARNING, // Still held at the first or the second reset warning
+    BUTTON_EVENT_RESET_HOLD,    // Held for CONFIG_BUTTON_RESET_HOLD_MS
+    BUTTON_EVENT_RELEASE,       // Released after a long press, before the reset hold
+} button_event_t;
+
+typedef struct {
+    button_event_t event;
+    uint32_t hold_ms;           // Time held so far, 0 for BUTTON_EVENT_PRESS
+} button_evt_t;
+
+/**
+ * @brief Event callback
+ *
+ * Runs in the esp_timer task: it must not block. Hand the event to a task
+ * (e.g. copy it into a queue) for anything slower than a log line.
+ */
+typedef void (*button_cb_t)(const button_evt_t *evt, void *arg);
+
+typedef struct {
+    gpio_num_t gpio;
+    int active_level;           // Level while pressed
+    button_cb_t callback;
+    void *arg;
+} button_config_t;
+
+/**
+ * @brief Configure a button GPIO and start watching it
+ *
+ * The pin gets a pull towards the released level and a level interrupt
+ * for the next change; nothing runs while the button is idle. Each edge
+ * starts a CONFIG_BUTTON_DEBOUNCE_MS one-shot timer that samples the
+ * level, and while the button is held another one-shot timer fires at each
+ * hold threshold. Installs the GPIO ISR service if needed. Call once per
+ * button; tell them apart by the callback argument.
+ *
+ * @param config Button configuration, copied
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the GPIO is already
+ *         a button, ESP_ERR_NO_MEM past CONFIG_BUTTON_MAX_COUNT buttons
+ */
+esp_err_t button_init(const button_config_t *config);
+
+/**
+ * @brief Let the buttons wake the chip from light sleep
+ *
+ * Enables GPIO wakeup on the level each button is waiting for, so both a
+ * press and a release end a light sleep. Call after the button_init() calls.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if no button is started
+ */
+esp_err_t button_enable_wakeup(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BUTTON_H
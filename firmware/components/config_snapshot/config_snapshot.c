@@ -0,0 +1,560 @@
+#include "config_snapshot.h"
+
+#if CONFIG_SNAPSHOT_ENABLE
+
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "mbedtls/aes.h"
+#include "mbedtls/md.h"
+#include "mbedtls/constant_time.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "SNAPSHOT";
+
+/*
+ * A snapshot is a header, the payload and an HMAC-SHA256 of both. The
+ * payload is AES-256-CTR encrypted under the header nonce and holds one
+ * record per NVS entry:
+ *
+ *   u8 namespace length, namespace, u8 key length, key,
+ *   u8 nvs_type_t, u16 value length, value
+ *
+ * Integers are little endian in their own width, strings keep their
+ * terminator. Both keys are derived from CONFIG_SNAPSHOT_SECRET.
+ */
+#define SNAPSHOT_MAGIC      0x4E534753      // "SGSN"
+#define SNAPSHOT_VERSION    1
+#define MAC_LEN             32
+#define NAME_LEN            16              // NVS key and namespace names, with terminator
+#define MAX_NAMESPACES      32
+
+// BLE Mesh sequence number, 24 bit little endian (see CONFIG_SNAPSHOT_SEQ_MARGIN)
+#define SEQ_KEY             "mesh/seq"
+#define SEQ_MAX             0xFFFFFF
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t reserved[3];
+    uint32_t payload_len;
+    uint8_t nonce[16];
+} snapshot_header_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    esp_err_t err;              // First failure, later writes are dropped
+} writer_t;
+
+typedef struct {
+    const uint8_t *p;
+    size_t left;
+} reader_t;
+
+typedef struct {
+    char namespace_name[NAME_LEN];
+    char key[NAME_LEN];
+    nvs_type_t type;
+    const uint8_t *value;
+    uint16_t len;
+} record_t;
+
+/* Crypto */
+
+static esp_err_t derive_key(const char *label, uint8_t key[32])
+{
+    const char *secret = CONFIG_SNAPSHOT_SECRET;
+    int ret = mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                              (const uint8_t *)secret, strlen(secret),
+                              (const uint8_t *)label, strlen(label), key);
+    return ret == 0 ? ESP_OK : ESP_FAIL;
+}
+
+// Encrypts or decrypts in place
+static esp_err_t payload_crypt(const uint8_t nonce[16], uint8_t *data, size_t len)
+{
+    uint8_t key[32];
+    esp_err_t err = derive_key("snapshot-enc", key);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    uint8_t counter[16];
+    uint8_t stream[16];
+    size_t offset = 0;
+    memcpy(counter, nonce, sizeof(counter));
+
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    int ret = mbedtls_aes_setkey_enc(&aes, key, 256);
+    if (ret == 0) {
+        ret = mbedtls_aes_crypt_ctr(&aes, len, &offset, counter, stream, data, data);
+    }
+    mbedtls_aes_free(&aes);
+    memset(key, 0, sizeof(key));
+    return ret == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t sign(const uint8_t *data, size_t len, uint8_t mac[MAC_LEN])
+{
+    uint8_t key[32];
+    esp_err_t err = derive_key("snapshot-mac", key);
+    if (err == ESP_OK) {
+        int ret = mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                                  key, sizeof(key), data, len, mac);
+        err = ret == 0 ? ESP_OK : ESP_FAIL;
+    }
+    memset(key, 0, sizeof(key));
+    return err;
+}
+
+static size_t int_width(nvs_type_t type)
+{
+    switch (type) {
+    case NVS_TYPE_U8:  case NVS_TYPE_I8:  return 1;
+    case NVS_TYPE_U16: case NVS_TYPE_I16: return 2;
+    case NVS_TYPE_U32: case NVS_TYPE_I32: return 4;
+    case NVS_TYPE_U64: case NVS_TYPE_I64: return 8;
+    default: return 0;
+    }
+}
+
+/* Export */
+
+static void put(writer_t *w, const void *data, size_t n)
+{
+    if (w->err != ESP_OK) {
+        return;
+    }
+    if (w->len + n > CONFIG_SNAPSHOT_MAX_SIZE) {
+        w->err = ESP_ERR_INVALID_SIZE;
+        return;
+    }
+    if (w->len + n > w->cap) {
+        size_t cap = w->cap ? w->cap : 1024;
+        while (cap < w->len + n) {
+            cap *= 2;
+        }
+        if (cap > CONFIG_SNAPSHOT_MAX_SIZE) {
+            cap = CONFIG_SNAPSHOT_MAX_SIZE;
+        }
+        uint8_t *buf = realloc(w->buf, cap);
+        if (buf == NULL) {
+            w->err = ESP_ERR_NO_MEM;
+            return;
+        }
+        w->buf = buf;
+        w->cap = cap;
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+static void put_u8(writer_t *w, uint8_t value)
+{
+    put(w, &value, 1);
+}
+
+static void put_le(writer_t *w, uint64_t value, size_t width)
+{
+    for (size_t i = 0; i < width; i++) {
+        put_u8(w, (uint8_t)(value >> (8 * i)));
+    }
+}
+
+static esp_err_t get_int(nvs_handle_t h, const char *key, nvs_type_t type, uint64_t *value)
+{
+    esp_err_t err = ESP_ERR_NVS_TYPE_MISMATCH;
+    switch (type) {
+    case NVS_TYPE_U8:  { uint8_t v;  err = nvs_get_u8(h, key, &v);  *value = v; break; }
+    case NVS_TYPE_I8:  { int8_t v;   err = nvs_get_i8(h, key, &v);  *value = (uint8_t)v; break; }
+    case NVS_TYPE_U16: { uint16_t v; err = nvs_get_u16(h, key, &v); *value = v; break; }
+    case NVS_TYPE_I16: { int16_t v;  err = nvs_get_i16(h, key, &v); *value = (uint16_t)v; break; }
+    case NVS_TYPE_U32: { uint32_t v; err = nvs_get_u32(h, key, &v); *value = v; break; }
+    case NVS_TYPE_I32: { int32_t v;  err = nvs_get_i32(h, key, &v); *value = (uint32_t)v; break; }
+    case NVS_TYPE_U64: { uint64_t v; err = nvs_get_u64(h, key, &v); *value = v; break; }
+    case NVS_TYPE_I64: { int64_t v;  err = nvs_get_i64(h, key, &v); *value = (uint64_t)v; break; }
+    default: break;
+    }
+    return err;
+}
+
+static esp_err_t put_entry(writer_t *w, nvs_handle_t h, const nvs_entry_info_t *info)
+{
+    uint64_t number = 0;
+    uint8_t *data = NULL;
+    size_t len = int_width(info->type);
+    esp_err_t err;
+
+    if (len > 0) {
+        err = get_int(h, info->key, info->type, &number);
+    } else if (info->type == NVS_TYPE_STR) {
+        err = nvs_get_str(h, info->key, NULL, &len);
+        if (err == ESP_OK && (data = malloc(len)) == NULL) {
+            err = ESP_ERR_NO_MEM;
+        }
+        if (err == ESP_OK) {
+            err = nvs_get_str(h, info->key, (char *)data, &len);
+        }
+    } else if (info->type == NVS_TYPE_BLOB) {
+        err = nvs_get_blob(h, info->key, NULL, &len);
+        if (err == ESP_OK && len > 0 && (data = malloc(len)) == NULL) {
+            err = ESP_ERR_NO_MEM;
+        }
+        if (err == ESP_OK && len > 0) {
+            err = nvs_get_blob(h, info->key, data, &len);
+        }
+    } else {
+        ESP_LOGW(TAG, "Skipping %s/%s of type 0x%02x", info->namespace_name, info->key, info->type);
+        return ESP_OK;
+    }
+    if (err == ESP_OK && len > UINT16_MAX) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+
+    if (err == ESP_OK) {
+        size_t ns_len = strnlen(info->namespace_name, NAME_LEN - 1);
+        size_t key_len = strnlen(info->key, NAME_LEN - 1);
+        put_u8(w, ns_len);
+        put(w, info->namespace_name, ns_len);
+        put_u8(w, key_len);
+        put(w, info->key, key_len);
+        put_u8(w, info->type);
+        put_le(w, len, 2);
+        if (data != NULL) {
+            put(w, data, len);
+        } else {
+            put_le(w, number, len);
+        }
+        err = w->err;
+    }
+    free(data);
+    return err;
+}
+
+static esp_err_t put_namespace(writer_t *w, const char *namespace_name, size_t *entries)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(namespace_name, NVS_READONLY, &h);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;      // Never written
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    nvs_iterator_t it = NULL;
+    err = nvs_entry_find(NVS_DEFAULT_PART_NAME, namespace_name, NVS_TYPE_ANY, &it);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        err = put_entry(w, h, &info);
+        if (err == ESP_OK) {
+            (*entries)++;
+            err = nvs_entry_next(&it);
+        }
+    }
+    nvs_release_iterator(it);
+    nvs_close(h);
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+}
+
+esp_err_t config_snapshot_export(const char *const *namespaces, size_t count, uint8_t **out, size_t *out_len)
+{
+    if (namespaces == NULL || out == NULL || out_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (CONFIG_SNAPSHOT_SECRET[0] == '\0') {
+        ESP_LOGE(TAG, "CONFIG_SNAPSHOT_SECRET is not set");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    writer_t w = { .err = ESP_OK };
+    snapshot_header_t header = {
+        .magic = SNAPSHOT_MAGIC,
+        .version = SNAPSHOT_VERSION,
+    };
+    esp_fill_random(header.nonce, sizeof(header.nonce));
+    put(&w, &header, sizeof(header));
+
+    size_t entries = 0;
+    for (size_t i = 0; i < count && w.err == ESP_OK; i++) {
+        esp_err_t err = put_namespace(&w, namespaces[i], &entries);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to export namespace %s: %s", namespaces[i], esp_err_to_name(err));
+            w.err = err;
+        }
+    }
+
+    if (w.err == ESP_OK) {
+        header.payload_len = w.len - sizeof(header);
+        memcpy(w.buf, &header, sizeof(header));
+        w.err = payload_crypt(header.nonce, w.buf + sizeof(header), header.payload_len);
+    }
+    if (w.err == ESP_OK) {
+        uint8_t mac[MAC_LEN];
+        w.err = sign(w.buf, w.len, mac);
+        put(&w, mac, sizeof(mac));
+    }
+    if (w.err != ESP_OK) {
+        free(w.buf);
+        return w.err;
+    }
+
+    ESP_LOGI(TAG, "Exported %u entries from %u namespaces (%u bytes)",
+             (unsigned)entries, (unsigned)count, (unsigned)w.len);
+    *out = w.buf;
+    *out_len = w.len;
+    return ESP_OK;
+}
+
+/* Import */
+
+static const uint8_t *get(reader_t *r, size_t n)
+{
+    if (n > r->left) {
+        return NULL;
+    }
+    const uint8_t *p = r->p;
+    r->p += n;
+    r->left -= n;
+    return p;
+}
+
+static bool get_name(reader_t *r, char name[NAME_LEN])
+{
+    const uint8_t *len = get(r, 1);
+    if (len == NULL || *len == 0 || *len >= NAME_LEN) {
+        return false;
+    }
+    const uint8_t *p = get(r, *len);
+    if (p == NULL || memchr(p, '\0', *len) != NULL) {
+        return false;
+    }
+    memcpy(name, p, *len);
+    name[*len] = '\0';
+    return true;
+}
+
+static esp_err_t next_record(reader_t *r, record_t *rec)
+{
+    if (!get_name(r, rec->namespace_name) || !get_name(r, rec->key)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const uint8_t *type = get(r, 1);
+    const uint8_t *len = get(r, 2);
+    if (type == NULL || len == NULL) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    rec->type = (nvs_type_t)*type;
+    rec->len = len[0] | (len[1] << 8);
+    rec->value = get(r, rec->len);
+    if (rec->value == NULL) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t width = int_width(rec->type);
+    if (width > 0) {
+        return rec->len == width ? ESP_OK : ESP_ERR_INVALID_SIZE;
+    }
+    if (rec->type == NVS_TYPE_STR) {
+        return rec->len > 0 && rec->value[rec->len - 1] == '\0' ? ESP_OK : ESP_ERR_INVALID_SIZE;
+    }
+    return rec->type == NVS_TYPE_BLOB ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+static int namespace_index(const char *const *namespaces, size_t count, const char *namespace_name)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(namespaces[i], namespace_name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// The replacement must not reuse sequence numbers the failed device already sent
+static uint32_t advance_seq(const uint8_t *value)
+{
+    uint32_t seq = value[0] | (value[1] << 8) | ((uint32_t)value[2] << 16);
+    uint32_t advanced = seq + CONFIG_SNAPSHOT_SEQ_MARGIN;
+    if (advanced > SEQ_MAX) {
+        ESP_LOGW(TAG, "Sequence number 0x%06lx near the end, IV update needed", (unsigned long)seq);
+        advanced = SEQ_MAX;
+    }
+    return advanced;
+}
+
+static esp_err_t write_record(nvs_handle_t h, const record_t *rec)
+{
+    uint64_t number = 0;
+    for (size_t i = int_width(rec->type); i > 0; i--) {
+        number = (number << 8) | rec->value[i - 1];
+    }
+
+    switch (rec->type) {
+    case NVS_TYPE_U8:  return nvs_set_u8(h, rec->key, (uint8_t)number);
+    case NVS_TYPE_I8:  return nvs_set_i8(h, rec->key, (int8_t)number);
+    case NVS_TYPE_U16: return nvs_set_u16(h, rec->key, (uint16_t)number);
+    case NVS_TYPE_I16: return nvs_set_i16(h, rec->key, (int16_t)number);
+    case NVS_TYPE_U32: return nvs_set_u32(h, rec->key, (uint32_t)number);
+    case NVS_TYPE_I32: return nvs_set_i32(h, rec->key, (int32_t)number);
+    case NVS_TYPE_U64: return nvs_set_u64(h, rec->key, number);
+    case NVS_TYPE_I64: return nvs_set_i64(h, rec->key, (int64_t)number);
+    case NVS_TYPE_STR: return nvs_set_str(h, rec->key, (const char *)rec->value);
+    default: break;
+    }
+
+    if (strcmp(rec->namespace_name, SNAPSHOT_BLE_MESH_NAMESPACE) == 0 &&
+        strcmp(rec->key, SEQ_KEY) == 0 && rec->len == 3) {
+        uint32_t seq = advance_seq(rec->value);
+        uint8_t value[3] = { seq & 0xFF, (seq >> 8) & 0xFF, (seq >> 16) & 0xFF };
+        return nvs_set_blob(h, rec->key, value, sizeof(value));
+    }
+    return nvs_set_blob(h, rec->key, rec->value, rec->len);
+}
+
+// Replace one namespace with its records from the payload
+static esp_err_t restore_namespace(const char *namespace_name, const uint8_t *payload, size_t len, size_t *entries)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(namespace_name, NVS_READWRITE, &h);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_erase_all(h);
+    reader_t r = { .p = payload, .left = len };
+    record_t rec;
+    while (err == ESP_OK && r.left > 0) {
+        err = next_record(&r, &rec);
+        if (err == ESP_OK && strcmp(rec.namespace_name, namespace_name) == 0) {
+            err = write_record(h, &rec);
+            if (err == ESP_OK) {
+                (*entries)++;
+            }
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(h);
+    }
+    nvs_close(h);
+    return err;
+}
+
+esp_err_t config_snapshot_import(const char *const *namespaces, size_t count,
+                                 const uint8_t *blob, size_t len, size_t *entries)
+{
+    if (namespaces == NULL || blob == NULL || count > MAX_NAMESPACES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (CONFIG_SNAPSHOT_SECRET[0] == '\0') {
+        ESP_LOGE(TAG, "CONFIG_SNAPSHOT_SECRET is not set");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    snapshot_header_t header;
+    if (len < sizeof(header) + MAC_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&header, blob, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.payload_len != len - sizeof(header) - MAC_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Signature first: nothing of an unsigned snapshot is parsed
+    uint8_t mac[MAC_LEN];
+    esp_err_t err = sign(blob, len - MAC_LEN, mac);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (mbedtls_ct_memcmp(mac, blob + len - MAC_LEN, MAC_LEN) != 0) {
+        ESP_LOGE(TAG, "Snapshot signature mismatch (other secret?)");
+        return ESP_ERR_INVALID_CRC;
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    uint8_t *payload = malloc(header.payload_len ? header.payload_len : 1);
+    if (payload == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(payload, blob + sizeof(header), header.payload_len);
+    err = payload_crypt(header.nonce, payload, header.payload_len);
+
+    // Check every record before the first namespace is erased
+    uint32_t present = 0;
+    reader_t r = { .p = payload, .left = header.payload_len };
+    record_t rec;
+    while (err == ESP_OK && r.left > 0) {
+        err = next_record(&r, &rec);
+        if (err == ESP_OK) {
+            int index = namespace_index(namespaces, count, rec.namespace_name);
+            if (index < 0) {
+                ESP_LOGE(TAG, "Snapshot namespace %s not allowed", rec.namespace_name);
+                err = ESP_ERR_NOT_ALLOWED;
+            } else {
+                present |= 1UL << index;
+            }
+        }
+    }
+
+    size_t written = 0;
+    for (size_t i = 0; i < count && err == ESP_OK; i++) {
+        if (present & (1UL << i)) {
+            err = restore_namespace(namespaces[i], payload, header.payload_len, &written);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to restore namespace %s: %s", namespaces[i], esp_err_to_name(err));
+            }
+        }
+    }
+    memset(payload, 0, header.payload_len);
+    free(payload);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Imported %u entries", (unsigned)written);
+    }
+    if (entries != NULL) {
+        *entries = written;
+    }
+    return err;
+}
+
+bool config_snapshot_authorized(const char *authorization)
+{
+    static const char prefix[] = "Bearer ";
+    const char *token = CONFIG_SNAPSHOT_TOKEN;
+    size_t len = strlen(token);
+
+    if (authorization == NULL || len == 0 || strncmp(authorization, prefix, sizeof(prefix) - 1) != 0) {
+        return false;
+    }
+    authorization += sizeof(prefix) - 1;
+    return strlen(authorization) == len && mbedtls_ct_memcmp(authorization, token, len) == 0;
+}
+
+#else // CONFIG_SNAPSHOT_ENABLE
+
+esp_err_t config_snapshot_export(const char *const *namespaces, size_t count, uint8_t **out, size_t *out_len)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t config_snapshot_import(const char *const *namespaces, size_t count,
+                                 const uint8_t *blob, size_t len, size_t *entries)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+bool config_snapshot_authorized(const char *authorization)
+{
+    return false;
+}
+
+#endif // CONFIG_SNAPSHOT_ENABLE
@@ -0,0 +1,68 @@
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Namespace of the ESP-BLE-Mesh stack settings (CONFIG_BLE_MESH_SETTINGS)
+#define SNAPSHOT_BLE_MESH_NAMESPACE "mesh_core"
+
+/**
+ * @brief Serialize NVS namespaces into an encrypted, signed snapshot
+ *
+ * Every entry of the listed namespaces on the default partition is
+ * included. The snapshot is AES-256-CTR encrypted and HMAC-SHA256 signed
+ * with keys derived from CONFIG_SNAPSHOT_SECRET.
+ *
+ * @param namespaces Namespaces to export
+ * @param count Number of namespaces
+ * @param out Set to a heap buffer holding the snapshot; free() it
+ * @param out_len Set to the snapshot length
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if larger than
+ *         CONFIG_SNAPSHOT_MAX_SIZE, ESP_ERR_INVALID_STATE without a secret,
+ *         ESP_ERR_NOT_SUPPORTED if disabled
+ */
+esp_err_t config_snapshot_export(const char *const *namespaces, size_t count, uint8_t **out, size_t *out_len);
+
+/**
+ * @brief Verify a snapshot and write it back to NVS
+ *
+ * The whole snapshot is checked before anything is written. Each listed
+ * namespace it contains is then erased and rewritten; entries of other
+ * namespaces are refused. The BLE Mesh sequence number is advanced by
+ * CONFIG_SNAPSHOT_SEQ_MARGIN. Restart afterwards: modules that cache NVS
+ * contents (mesh_storage, the BLE Mesh stack) still hold the old state.
+ *
+ * @param namespaces Namespaces the snapshot may restore
+ * @param count Number of namespaces
+ * @param blob Snapshot from config_snapshot_export()
+ * @param len Snapshot length
+ * @param entries Set to the number of entries written, may be NULL
+ * @return ESP_OK on success, ESP_ERR_INVALID_CRC if the signature does not
+ *         match, ESP_ERR_INVALID_VERSION or ESP_ERR_INVALID_SIZE for a
+ *         malformed snapshot, ESP_ERR_NOT_ALLOWED for another namespace,
+ *         ESP_ERR_NOT_SUPPORTED if disabled
+ */
+esp_err_t config_snapshot_import(const char *const *namespaces, size_t count,
+                                 const uint8_t *blob, size_t len, size_t *entries);
+
+/**
+ * @brief Check an HTTP Authorization header against CONFIG_SNAPSHOT_TOKEN
+ *
+ * @param authorization Header value, "Bearer <token>"
+ * @return true if it matches, false otherwise or if no token is configured
+ */
+bool config_snapshot_authorized(const char *authorization);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONFIG_SNAPSHOT_H
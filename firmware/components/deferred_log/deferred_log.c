@@ -0,0 +1,198 @@
+#include "deferred_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef CONFIG_DLOG_RING_SIZE
+#define CONFIG_DLOG_RING_SIZE 128
+#endif
+
+#define RING_SIZE   CONFIG_DLOG_RING_SIZE
+#define RING_MASK   (RING_SIZE - 1)
+
+_Static_assert((RING_SIZE & RING_MASK) == 0, "CONFIG_DLOG_RING_SIZE must be a power of two");
+_Static_assert(sizeof(void *) == sizeof(uint32_t), "DLOG_STR() needs 32-bit pointers");
+
+#define DRAIN_BATCH 8
+
+/*
+ * Each slot carries a sequence number: 0 while a writer is filling it,
+ * index + 1 once the record for that ring index is complete. Readers copy
+ * the record and re-check the sequence to detect a concurrent overwrite.
+ */
+typedef struct {
+    atomic_uint_least32_t seq;
+    dlog_record_t record;
+} dlog_slot_t;
+
+static dlog_slot_t s_ring[RING_SIZE];
+static atomic_uint_least32_t s_head = 0;   // Next index to reserve
+static uint32_t s_tail = 0;                // Next index to consume (under s_lock)
+static SemaphoreHandle_t s_lock = NULL;
+
+void dlog_write(uint8_t level, const char *tag, const char *fmt, uint8_t nargs, const uint32_t *args)
+{
+    uint32_t idx = atomic_fetch_add_explicit(&s_head, 1, memory_order_relaxed);
+    dlog_slot_t *slot = &s_ring[idx & RING_MASK];
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->record.timestamp_us = (uint32_t)esp_timer_get_time();
+    slot->record.tag = tag;
+    slot->record.fmt = fmt;
+    slot->record.level = level;
+    slot->record.nargs = nargs;
+    for (uint8_t i = 0; i < nargs; i++) {
+        slot->record.args[i] = args[i];
+    }
+
+    atomic_store_explicit(&slot->seq, idx + 1, memory_order_release);
+}
+
+// Returns 1 when copied, 0 when the record is still being written, -1 when it was overwritten
+static int read_slot(uint32_t idx, dlog_record_t *out)
+{
+    dlog_slot_t *slot = &s_ring[idx & RING_MASK];
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+    if (seq == 0) {
+        return 0;
+    }
+    if (seq != idx + 1) {
+        return ((int32_t)(seq - (idx + 1)) > 0) ? -1 : 0;
+    }
+
+    memcpy(out, &slot->record, sizeof(*out));
+    atomic_thread_fence(memory_order_acquire);
+
+    return (atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq) ? 1 : -1;
+}
+
+size_t dlog_read(dlog_record_t *records, size_t max_records, uint32_t *dropped)
+{
+    if (records == NULL || s_lock == NULL) {
+        return 0;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    uint32_t head = atomic_load_explicit(&s_head, memory_order_acquire);
+    uint32_t lost = 0;
+    if (head - s_tail > RING_SIZE) {
+        lost = head - s_tail - RING_SIZE;
+        s_tail = head - RING_SIZE;
+    }
+
+    size_t count = 0;
+    while (count < max_records && s_tail != head) {
+        int res = read_slot(s_tail, &records[count]);
+        if (res == 0) {
+            break;
+        }
+        if (res > 0) {
+            count++;
+        } else {
+            lost++;
+        }
+        s_tail++;
+    }
+
+    xSemaphoreGive(s_lock);
+
+    if (dropped) {
+        *dropped += lost;
+    }
+    return count;
+}
+
+size_t dlog_peek_recent(dlog_record_t *records, size_t max_records)
+{
+    if (records == NULL) {
+        return 0;
+    }
+
+    uint32_t head = atomic_load_explicit(&s_head, memory_order_acquire);
+    uint32_t span = max_records < RING_SIZE ? max_records : RING_SIZE;
+    if (span > head) {
+        span = head;
+    }
+
+    size_t count = 0;
+    for (uint32_t idx = head - span; idx != head; idx++) {
+        if (read_slot(idx, &records[count]) > 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int dlog_format(const dlog_record_t *record, char *buf, size_t len)
+{
+    const uint32_t *a = record->args;
+
+    // Unused trailing arguments are ignored by snprintf
+    return snprintf(buf, len, record->fmt, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+char dlog_level_char(uint8_t level)
+{
+    switch (level) {
+    case DLOG_LEVEL_ERROR: return 'E';
+    case DLOG_LEVEL_WARN:  return 'W';
+    case DLOG_LEVEL_INFO:  return 'I';
+    case DLOG_LEVEL_DEBUG: return 'D';
+    default:               return '?';
+    }
+}
+
+#if CONFIG_DLOG_DRAIN_TASK
+static void drain_task(void *pvParameters)
+{
+    dlog_record_t batch[DRAIN_BATCH];
+    char line[160];
+
+    while (1) {
+        uint32_t dropped = 0;
+        size_t count;
+
+        while ((count = dlog_read(batch, DRAIN_BATCH, &dropped)) > 0) {
+            for (size_t i = 0; i < count; i++) {
+                dlog_format(&batch[i], line, sizeof(line));
+                printf("%c (%lu) %s: %s\n", dlog_level_char(batch[i].level),
+                       (unsigned long)(batch[i].timestamp_us / 1000), batch[i].tag, line);
+            }
+        }
+
+        if (dropped > 0) {
+            printf("W (dlog) %lu records dropped\n", (unsigned long)dropped);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_DLOG_DRAIN_PERIOD_MS));
+    }
+}
+#endif
+
+esp_err_t dlog_init(void)
+{
+    if (s_lock != NULL) {
+        return ESP_OK;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+#if CONFIG_DLOG_DRAIN_TASK
+    if (xTaskCreate(drain_task, "dlog_drain", 3072, NULL, tskIDLE_PRIORITY + 1, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+    return ESP_OK;
+}
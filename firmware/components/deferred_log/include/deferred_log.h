@@ -0,0 +1,133 @@
+#ifndef DEFERRED_LOG_H
+#define DEFERRED_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Deferred binary logging.
+ *
+ * DLOG_x() stores a fixed-size record (timestamp, tag, format pointer and
+ * up to DLOG_MAX_ARGS 32-bit arguments) in a RAM ring without taking a
+ * lock and without formatting. Text is produced later by the drain task or
+ * when the records are fetched.
+ *
+ * Because formatting happens later, the format string must be a literal
+ * and every argument must be a 32-bit integer. Strings can only be passed
+ * through DLOG_STR() and must have static storage (string literals).
+ */
+
+#define DLOG_LEVEL_NONE     0
+#define DLOG_LEVEL_ERROR    1
+#define DLOG_LEVEL_WARN     2
+#define DLOG_LEVEL_INFO     3
+#define DLOG_LEVEL_DEBUG    4
+
+#define DLOG_MAX_ARGS       6
+
+#ifndef CONFIG_DLOG_LEVEL
+#define CONFIG_DLOG_LEVEL DLOG_LEVEL_INFO
+#endif
+
+// One log record as stored in the ring
+typedef struct {
+    uint32_t timestamp_us;       // Low 32 bits of esp_timer_get_time()
+    const char *tag;
+    const char *fmt;
+    uint32_t args[DLOG_MAX_ARGS];
+    uint8_t level;
+    uint8_t nargs;
+} dlog_record_t;
+
+/**
+ * @brief Create the reader lock and start the drain task (if enabled)
+ *
+ * Records written before this call are kept and drained afterwards.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t dlog_init(void);
+
+/**
+ * @brief Append a record to the ring (use the DLOG_x macros instead)
+ *
+ * Lock-free, safe from any task. Never blocks.
+ */
+void dlog_write(uint8_t level, const char *tag, const char *fmt, uint8_t nargs, const uint32_t *args);
+
+/**
+ * @brief Consume pending records in order
+ *
+ * @param records Output array
+ * @param max_records Capacity of records
+ * @param dropped Optional, incremented by the number of records lost to overwrite
+ * @return Number of records copied
+ */
+size_t dlog_read(dlog_record_t *records, size_t max_records, uint32_t *dropped);
+
+/**
+ * @brief Copy the most recent records without consuming them
+ *
+ * @param records Output array, oldest first
+ * @param max_records Capacity of records
+ * @return Number of records copied
+ */
+size_t dlog_peek_recent(dlog_record_t *records, size_t max_records);
+
+/**
+ * @brief Format the message of a record (without timestamp or tag)
+ *
+ * @return Number of characters written, as snprintf()
+ */
+int dlog_format(const dlog_record_t *record, char *buf, size_t len);
+
+/**
+ * @brief Single letter for a level (E, W, I, D)
+ */
+char dlog_level_char(uint8_t level);
+
+#define DLOG_STR(s) ((uint32_t)(uintptr_t)(s))
+
+#define DLOG_WRITE(level, tag, fmt, ...) do {                                       \
+        const uint32_t __dlog_args[] = { 0, ##__VA_ARGS__ };                        \
+        _Static_assert(sizeof(__dlog_args) / sizeof(uint32_t) - 1 <= DLOG_MAX_ARGS, \
+                       "too many deferred log arguments");                          \
+        dlog_write(level, tag, "" fmt "",                                           \
+                   sizeof(__dlog_args) / sizeof(uint32_t) - 1, &__dlog_args[1]);    \
+    } while (0)
+
+#if CONFIG_DLOG_LEVEL >= DLOG_LEVEL_ERROR
+#define DLOG_E(tag, fmt, ...) DLOG_WRITE(DLOG_LEVEL_ERROR, tag, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_E(tag, fmt, ...) do { } while (0)
+#endif
+
+#if CONFIG_DLOG_LEVEL >= DLOG_LEVEL_WARN
+#define DLOG_W(tag, fmt, ...) DLOG_WRITE(DLOG_LEVEL_WARN, tag, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_W(tag, fmt, ...) do { } while (0)
+#endif
+
+#if CONFIG_DLOG_LEVEL >= DLOG_LEVEL_INFO
+#define DLOG_I(tag, fmt, ...) DLOG_WRITE(DLOG_LEVEL_INFO, tag, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_I(tag, fmt, ...) do { } while (0)
+#endif
+
+#if CONFIG_DLOG_LEVEL >= DLOG_LEVEL_DEBUG
+#define DLOG_D(tag, fmt, ...) DLOG_WRITE(DLOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_D(tag, fmt, ...) do { } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEFERRED_LOG_H
@@ -0,0 +1,222 @@
+#include "energy_model.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "esp_attr.h"
+#include <string.h>
+
+static const char *s_state_names[ENERGY_STATE_MAX] = {
+    [ENERGY_STATE_CPU] = "cpu",
+    [ENERGY_STATE_SLEEP] = "sleep",
+    [ENERGY_STATE_RADIO_RX] = "rx",
+    [ENERGY_STATE_RADIO_TX] = "tx",
+    [ENERGY_STATE_LED] = "led",
+};
+
+const char *energy_model_state_name(energy_state_t state)
+{
+    return state < ENERGY_STATE_MAX ? s_state_names[state] : "?";
+}
+
+#if CONFIG_ENERGY_MODEL_ENABLE
+
+/*
+ * Charge is kept in uA x us. Awake and light sleep time split the window:
+ * the sleep callbacks measure sleep, the rest is awake. Radio and LED
+ * current comes on top, from the events and loads the application reports.
+ */
+#define UA_US_PER_UAH   3600000000ULL
+
+static const energy_state_t s_load_state[ENERGY_LOAD_MAX] = {
+    [ENERGY_LOAD_STATUS_LED] = ENERGY_STATE_LED,
+    [ENERGY_LOAD_SCAN] = ENERGY_STATE_RADIO_RX,
+    [ENERGY_LOAD_RGB_LED] = ENERGY_STATE_LED,
+};
+
+static const uint32_t s_load_ua[ENERGY_LOAD_MAX] = {
+    [ENERGY_LOAD_STATUS_LED] = CONFIG_ENERGY_MODEL_STATUS_LED_UA,
+    [ENERGY_LOAD_SCAN] = CONFIG_ENERGY_MODEL_RX_UA,
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_started = false;
+static int64_t s_window_start_us = 0;
+static int64_t s_sleep_enter_us = 0;
+static uint64_t s_sleep_us = 0;
+static uint64_t s_time_us[ENERGY_STATE_MAX];
+static uint64_t s_charge[ENERGY_STATE_MAX];
+
+static struct {
+    uint32_t current_ua;
+    int64_t since_us;
+} s_loads[ENERGY_LOAD_MAX];
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+// Both run in the idle task with interrupts disabled
+static esp_err_t IRAM_ATTR sleep_enter_cb(int64_t sleep_time_us, void *arg)
+{
+    s_sleep_enter_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+static esp_err_t IRAM_ATTR sleep_exit_cb(int64_t sleep_time_us, void *arg)
+{
+    s_sleep_us += esp_timer_get_time() - s_sleep_enter_us;
+    return ESP_OK;
+}
+#endif
+
+// Time two loads of one state overlap counts twice; their charge adds up
+// Call with s_lock held
+static void close_load(energy_load_t load, int64_t now_us)
+{
+    uint64_t elapsed_us = now_us - s_loads[load].since_us;
+    if (s_loads[load].current_ua > 0) {
+        s_time_us[s_load_state[load]] += elapsed_us;
+        s_charge[s_load_state[load]] += elapsed_us * s_loads[load].current_ua;
+    }
+    s_loads[load].since_us = now_us;
+}
+
+esp_err_t energy_model_start(void)
+{
+    if (s_started) {
+        return ESP_OK;
+    }
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    esp_pm_sleep_cbs_register_config_t cbs = {
+        .enter_cb = sleep_enter_cb,
+        .exit_cb = sleep_exit_cb,
+    };
+    esp_err_t err = esp_pm_light_sleep_register_cbs(&cbs);
+    if (err != ESP_OK) {
+        return err;
+    }
+#endif
+
+    int64_t now_us = esp_timer_get_time();
+    taskENTER_CRITICAL(&s_lock);
+    s_window_start_us = now_us;
+    for (int i = 0; i < ENERGY_LOAD_MAX; i++) {
+        s_loads[i].since_us = now_us;
+    }
+    s_started = true;
+    taskEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+void energy_model_add(energy_state_t state, uint32_t duration_us)
+{
+    uint32_t current_ua;
+    if (state == ENERGY_STATE_RADIO_RX) {
+        current_ua = CONFIG_ENERGY_MODEL_RX_UA;
+    } else if (state == ENERGY_STATE_RADIO_TX) {
+        current_ua = CONFIG_ENERGY_MODEL_TX_UA;
+    } else {
+        return;     // Awake and sleep time are measured
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    s_time_us[state] += duration_us;
+    s_charge[state] += (uint64_t)duration_us * current_ua;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static void set_load_current(energy_load_t load, uint32_t current_ua)
+{
+    if (!s_started) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    close_load(load, esp_timer_get_time());
+    s_loads[load].current_ua = current_ua;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void energy_model_set_load(energy_load_t load, bool on)
+{
+    if (load < ENERGY_LOAD_RGB_LED) {
+        set_load_current(load, on ? s_load_ua[load] : 0);
+    } else if (load == ENERGY_LOAD_RGB_LED && !on) {
+        set_load_current(load, 0);
+    }
+}
+
+void energy_model_set_strip(uint8_t leds, uint32_t channel_sum)
+{
+    set_load_current(ENERGY_LOAD_RGB_LED, leds * CONFIG_ENERGY_MODEL_LED_IDLE_UA +
+                     channel_sum * CONFIG_ENERGY_MODEL_LED_CHANNEL_UA / 255);
+}
+
+esp_err_t energy_model_get_report(energy_model_report_t *report, bool reset)
+{
+    if (!s_started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint64_t time_us[ENERGY_STATE_MAX];
+    uint64_t charge[ENERGY_STATE_MAX];
+    int64_t now_us = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < ENERGY_LOAD_MAX; i++) {
+        close_load(i, now_us);
+    }
+    uint64_t window_us = now_us - s_window_start_us;
+    uint64_t sleep_us = s_sleep_us < window_us ? s_sleep_us : window_us;
+    memcpy(time_us, s_time_us, sizeof(time_us));
+    memcpy(charge, s_charge, sizeof(charge));
+    if (reset) {
+        s_window_start_us = now_us;
+        s_sleep_us = 0;
+        memset(s_time_us, 0, sizeof(s_time_us));
+        memset(s_charge, 0, sizeof(s_charge));
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    time_us[ENERGY_STATE_SLEEP] = sleep_us;
+    time_us[ENERGY_STATE_CPU] = window_us - sleep_us;
+    charge[ENERGY_STATE_SLEEP] = sleep_us * CONFIG_ENERGY_MODEL_SLEEP_UA;
+    charge[ENERGY_STATE_CPU] = (window_us - sleep_us) * CONFIG_ENERGY_MODEL_CPU_UA;
+
+    memset(report, 0, sizeof(*report));
+    uint64_t total = 0;
+    for (int i = 0; i < ENERGY_STATE_MAX; i++) {
+        report->states[i].time_ms = time_us[i] / 1000;
+        report->states[i].charge_uah = charge[i] / UA_US_PER_UAH;
+        total += charge[i];
+    }
+    report->window_s = window_us / 1000000;
+    report->charge_uah = total / UA_US_PER_UAH;
+    report->average_ua = window_us ? total / window_us : 0;
+    report->mah_per_day_x10 = report->average_ua * 24 / 100;
+    return ESP_OK;
+}
+
+#else
+
+esp_err_t energy_model_start(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void energy_model_add(energy_state_t state, uint32_t duration_us)
+{
+}
+
+void energy_model_set_load(energy_load_t load, bool on)
+{
+}
+
+void energy_model_set_strip(uint8_t leds, uint32_t channel_sum)
+{
+}
+
+esp_err_t energy_model_get_report(energy_model_report_t *report, bool reset)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
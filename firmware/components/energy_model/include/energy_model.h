@@ -0,0 +1,102 @@
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// States charge is accounted to; radio and LED current adds to CPU or sleep
+typedef enum {
+    ENERGY_STATE_CPU = 0,       // Awake
+    ENERGY_STATE_SLEEP,         // Light sleep
+    ENERGY_STATE_RADIO_RX,
+    ENERGY_STATE_RADIO_TX,
+    ENERGY_STATE_LED,
+    ENERGY_STATE_MAX,
+} energy_state_t;
+
+// Loads that stay on until changed, each with its Kconfig current
+typedef enum {
+    ENERGY_LOAD_STATUS_LED = 0,
+    ENERGY_LOAD_SCAN,           // Radio receiving continuously
+    ENERGY_LOAD_RGB_LED,        // Current set by energy_model_set_strip()
+    ENERGY_LOAD_MAX,
+} energy_load_t;
+
+typedef struct {
+    uint32_t time_ms;
+    uint32_t charge_uah;
+} energy_state_stats_t;
+
+typedef struct {
+    uint32_t window_s;
+    energy_state_stats_t states[ENERGY_STATE_MAX];
+    uint32_t charge_uah;        // All states
+    uint32_t average_ua;
+    uint32_t mah_per_day_x10;   // At the average current of the window
+} energy_model_report_t;
+
+/**
+ * @brief Start accounting
+ *
+ * Registers the light sleep callbacks when power management is enabled;
+ * without it the chip never sleeps and all time counts as awake.
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if the model is disabled
+ */
+esp_err_t energy_model_start(void);
+
+/**
+ * @brief Account a radio activity of known length
+ *
+ * @param state ENERGY_STATE_RADIO_RX or ENERGY_STATE_RADIO_TX
+ * @param duration_us Length of the activity
+ */
+void energy_model_add(energy_state_t state, uint32_t duration_us);
+
+/**
+ * @brief Switch a load on or off until the next change
+ *
+ * ENERGY_LOAD_RGB_LED can only be switched off, i.e. its power removed;
+ * energy_model_set_strip() powers it again.
+ *
+ * @param load Load to switch
+ * @param on New state
+ */
+void energy_model_set_load(energy_load_t load, bool on);
+
+/**
+ * @brief Set what a powered RGB LED strip shows
+ *
+ * Each LED draws its idle current, plus the channel current scaled by
+ * the channel values.
+ *
+ * @param leds LEDs on the powered rail
+ * @param channel_sum Sum of every channel value of every LED, 0 for dark
+ */
+void energy_model_set_strip(uint8_t leds, uint32_t channel_sum);
+
+/**
+ * @brief Report the window since the last reset
+ *
+ * @param report Output report
+ * @param reset Start a new window
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not started
+ */
+esp_err_t energy_model_get_report(energy_model_report_t *report, bool reset);
+
+/**
+ * @brief Short name of a state ("cpu", "sleep", ...)
+ */
+const char *energy_model_state_name(energy_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENERGY_MODEL_H
@@ -0,0 +1,394 @@
+#include "heap_monitor.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *s_subsys_names[HEAP_SUBSYS_MAX] = {
+    [HEAP_SUBSYS_OTHER] = "other",
+    [HEAP_SUBSYS_MQTT]  = "mqtt",
+    [HEAP_SUBSYS_HTTP]  = "http",
+    [HEAP_SUBSYS_CJSON] = "cjson",
+    [HEAP_SUBSYS_NET]   = "net",
+    [HEAP_SUBSYS_BT]    = "bt",
+};
+
+const char *heap_monitor_subsys_name(heap_subsys_t subsys)
+{
+    return (subsys < HEAP_SUBSYS_MAX) ? s_subsys_names[subsys] : "?";
+}
+
+#if CONFIG_HEAP_MONITOR_ENABLE
+
+static const char *TAG = "HEAP_MONITOR";
+
+#define HISTORY_LEN         CONFIG_HEAP_MONITOR_HISTORY
+#define HEAP_CAPS           MALLOC_CAP_8BIT
+#define WARN_FRAG_PCT       50
+#define WARN_HOURS          72
+
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t free_bytes;
+    uint32_t min_free_bytes;
+    uint32_t largest_block;
+} heap_sample_t;
+
+static heap_sample_t s_history[HISTORY_LEN];
+static size_t s_history_count = 0;
+static size_t s_history_next = 0;
+static SemaphoreHandle_t s_lock = NULL;
+
+/* Allocation attribution */
+
+#if CONFIG_HEAP_MONITOR_ATTRIBUTION
+
+#define TRACKED_ALLOCS      CONFIG_HEAP_MONITOR_TRACKED_ALLOCS
+#define SIZE_MASK           0x00FFFFFFu
+#define SUBSYS_SHIFT        24
+
+// Open-addressed pointer table; size and subsystem packed into one word
+typedef struct {
+    void *ptr;
+    uint32_t size_subsys;
+} alloc_entry_t;
+
+static DRAM_ATTR alloc_entry_t s_allocs[TRACKED_ALLOCS];
+static DRAM_ATTR size_t s_alloc_count = 0;
+static DRAM_ATTR heap_subsys_stats_t s_subsys[HEAP_SUBSYS_MAX];
+static DRAM_ATTR uint32_t s_untracked = 0;
+static DRAM_ATTR bool s_tracking = false;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static IRAM_ATTR size_t slot_of(const void *ptr)
+{
+    return (((uintptr_t)ptr >> 3) * 2654435761u) % TRACKED_ALLOCS;
+}
+
+static IRAM_ATTR bool name_starts(const char *name, const char *prefix)
+{
+    while (*prefix) {
+        if (*name++ != *prefix++) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Attribute by the allocating task; interrupts and unknown tasks count as "other"
+static IRAM_ATTR heap_subsys_t classify_current_task(void)
+{
+    if (xPortInIsrContext()) {
+        return HEAP_SUBSYS_OTHER;
+    }
+
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    if (task == NULL) {
+        return HEAP_SUBSYS_OTHER;
+    }
+
+    const char *name = pcTaskGetName(task);
+    if (name_starts(name, "mqtt")) {
+        return HEAP_SUBSYS_MQTT;
+    }
+    if (name_starts(name, "httpd")) {
+        return HEAP_SUBSYS_HTTP;
+    }
+    if (name_starts(name, "tiT") || name_starts(name, "wifi") || name_starts(name, "sys_evt")) {
+        return HEAP_SUBSYS_NET;
+    }
+    if (name_starts(name, "BT") || name_starts(name, "bt") || name_starts(name, "BLE") ||
+        name_starts(name, "ble") || name_starts(name, "hci") || name_starts(name, "mesh")) {
+        return HEAP_SUBSYS_BT;
+    }
+    return HEAP_SUBSYS_OTHER;
+}
+
+static IRAM_ATTR alloc_entry_t *find_entry(const void *ptr)
+{
+    size_t i = slot_of(ptr);
+    for (size_t n = 0; n < TRACKED_ALLOCS && s_allocs[i].ptr != NULL; n++) {
+        if (s_allocs[i].ptr == ptr) {
+            return &s_allocs[i];
+        }
+        i = (i + 1) % TRACKED_ALLOCS;
+    }
+    return NULL;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+static IRAM_ATTR void remove_entry(alloc_entry_t *entry)
+{
+    size_t hole = entry - s_allocs;
+    size_t i = hole;
+
+    s_allocs[hole].ptr = NULL;
+    while (1) {
+        i = (i + 1) % TRACKED_ALLOCS;
+        if (s_allocs[i].ptr == NULL) {
+            break;
+        }
+        size_t home = slot_of(s_allocs[i].ptr);
+        // Move the entry back if its home slot is not between the hole and i (cyclically)
+        bool movable = (hole <= i) ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (movable) {
+            s_allocs[hole] = s_allocs[i];
+            s_allocs[i].ptr = NULL;
+            hole = i;
+        }
+    }
+    s_alloc_count--;
+}
+
+static IRAM_ATTR void account(heap_subsys_t subsys, uint32_t size)
+{
+    heap_subsys_stats_t *stats = &s_subsys[subsys];
+    stats->live_bytes += size;
+    stats->live_count++;
+    stats->alloc_count++;
+    if (stats->live_bytes > stats->peak_bytes) {
+        stats->peak_bytes = stats->live_bytes;
+    }
+}
+
+static IRAM_ATTR void unaccount(heap_subsys_t subsys, uint32_t size)
+{
+    s_subsys[subsys].live_bytes -= size;
+    s_subsys[subsys].live_count--;
+}
+
+// Called by the heap component for every allocation (CONFIG_HEAP_USE_HOOKS)
+IRAM_ATTR void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    if (!s_tracking || ptr == NULL) {
+        return;
+    }
+
+    heap_subsys_t subsys = classify_current_task();
+
+    portENTER_CRITICAL_SAFE(&s_mux);
+    if (s_alloc_count >= TRACKED_ALLOCS * 3 / 4 || size > SIZE_MASK) {
+        s_untracked++;
+    } else {
+        size_t i = slot_of(ptr);
+        while (s_allocs[i].ptr != NULL) {
+            i = (i + 1) % TRACKED_ALLOCS;
+        }
+        s_allocs[i].ptr = ptr;
+        s_allocs[i].size_subsys = size | ((uint32_t)subsys << SUBSYS_SHIFT);
+        s_alloc_count++;
+        account(subsys, size);
+    }
+    portEXIT_CRITICAL_SAFE(&s_mux);
+}
+
+// Called by the heap component for every free (CONFIG_HEAP_USE_HOOKS)
+IRAM_ATTR void esp_heap_trace_free_hook(void *ptr)
+{
+    if (!s_tracking || ptr == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL_SAFE(&s_mux);
+    alloc_entry_t *entry = find_entry(ptr);
+    if (entry) {
+        unaccount(entry->size_subsys >> SUBSYS_SHIFT, entry->size_subsys & SIZE_MASK);
+        remove_entry(entry);
+    }
+    portEXIT_CRITICAL_SAFE(&s_mux);
+}
+
+static void retag(void *ptr, heap_subsys_t subsys)
+{
+    portENTER_CRITICAL_SAFE(&s_mux);
+    alloc_entry_t *entry = find_entry(ptr);
+    if (entry) {
+        uint32_t size = entry->size_subsys & SIZE_MASK;
+        unaccount(entry->size_subsys >> SUBSYS_SHIFT, size);
+        // Moving an allocation is not a new allocation
+        account(subsys, size);
+        s_subsys[subsys].alloc_count--;
+        entry->size_subsys = size | ((uint32_t)subsys << SUBSYS_SHIFT);
+    }
+    portEXIT_CRITICAL_SAFE(&s_mux);
+}
+
+// cJSON allocator wrapper: allocate normally, then move the entry to cJSON
+static void *cjson_malloc(size_t size)
+{
+    void *ptr = malloc(size);
+    if (ptr) {
+        retag(ptr, HEAP_SUBSYS_CJSON);
+    }
+    return ptr;
+}
+
+static void cjson_free(void *ptr)
+{
+    free(ptr);
+}
+
+#endif // CONFIG_HEAP_MONITOR_ATTRIBUTION
+
+/* Sampling and trends */
+
+static void take_sample(heap_sample_t *sample)
+{
+    sample->uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    sample->free_bytes = heap_caps_get_free_size(HEAP_CAPS);
+    sample->min_free_bytes = heap_caps_get_minimum_free_size(HEAP_CAPS);
+    sample->largest_block = heap_caps_get_largest_free_block(HEAP_CAPS);
+}
+
+// Least-squares slope in bytes per hour; field selects the sample member
+static int32_t trend_bph(size_t offset)
+{
+    if (s_history_count < 2) {
+        return 0;
+    }
+
+    size_t oldest = (s_history_next + HISTORY_LEN - s_history_count) % HISTORY_LEN;
+    int64_t t0 = s_history[oldest].uptime_s;
+    int64_t n = s_history_count;
+    int64_t sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+
+    for (size_t k = 0; k < s_history_count; k++) {
+        const heap_sample_t *s = &s_history[(oldest + k) % HISTORY_LEN];
+        int64_t x = (int64_t)s->uptime_s - t0;
+        int64_t y = *(const uint32_t *)((const uint8_t *)s + offset);
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+    }
+
+    int64_t denom = n * sum_xx - sum_x * sum_x;
+    if (denom == 0) {
+        return 0;
+    }
+    return (int32_t)(((n * sum_xy - sum_x * sum_y) * 3600) / denom);
+}
+
+static void build_report(heap_monitor_report_t *report)
+{
+    heap_sample_t now;
+    take_sample(&now);
+
+    memset(report, 0, sizeof(*report));
+    report->uptime_s = now.uptime_s;
+    report->free_bytes = now.free_bytes;
+    report->min_free_bytes = now.min_free_bytes;
+    report->largest_block = now.largest_block;
+    report->fragmentation_pct = now.free_bytes ?
+                                (uint8_t)(100 - (uint64_t)now.largest_block * 100 / now.free_bytes) : 0;
+    report->sample_count = s_history_count;
+    report->free_trend_bph = trend_bph(offsetof(heap_sample_t, free_bytes));
+    report->largest_trend_bph = trend_bph(offsetof(heap_sample_t, largest_block));
+    if (report->free_trend_bph < 0) {
+        report->hours_to_exhaustion = now.free_bytes / (uint32_t)(-report->free_trend_bph);
+    }
+
+#if CONFIG_HEAP_MONITOR_ATTRIBUTION
+    portENTER_CRITICAL_SAFE(&s_mux);
+    memcpy(report->subsys, s_subsys, sizeof(report->subsys));
+    report->untracked_allocs = s_untracked;
+    portEXIT_CRITICAL_SAFE(&s_mux);
+#endif
+}
+
+static void monitor_task(void *pvParameters)
+{
+    heap_monitor_report_t *report = malloc(sizeof(heap_monitor_report_t));
+    uint32_t samples_since_warning = HISTORY_LEN;
+
+    while (1) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        take_sample(&s_history[s_history_next]);
+        s_history_next = (s_history_next + 1) % HISTORY_LEN;
+        if (s_history_count < HISTORY_LEN) {
+            s_history_count++;
+        }
+        if (report) {
+            build_report(report);
+        }
+        xSemaphoreGive(s_lock);
+
+        // Warn at most once per history window
+        samples_since_warning++;
+        if (report && samples_since_warning >= HISTORY_LEN && s_history_count == HISTORY_LEN &&
+            (report->fragmentation_pct >= WARN_FRAG_PCT ||
+             (report->hours_to_exhaustion > 0 && report->hours_to_exhaustion < WARN_HOURS))) {
+            ESP_LOGW(TAG, "Heap: free %lu, largest %lu (%u%% fragmented), trend %ld B/h, ~%lu h to exhaustion",
+                     (unsigned long)report->free_bytes, (unsigned long)report->largest_block,
+                     report->fragmentation_pct, (long)report->free_trend_bph,
+                     (unsigned long)report->hours_to_exhaustion);
+            samples_since_warning = 0;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_HEAP_MONITOR_PERIOD_S * 1000));
+    }
+}
+
+esp_err_t heap_monitor_start(void)
+{
+    if (s_lock != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+#if CONFIG_HEAP_MONITOR_ATTRIBUTION
+    cJSON_Hooks hooks = {
+        .malloc_fn = cjson_malloc,
+        .free_fn = cjson_free,
+    };
+    cJSON_InitHooks(&hooks);
+    s_tracking = true;
+#endif
+
+    if (xTaskCreate(monitor_task, "heap_mon", 3072, NULL, tskIDLE_PRIORITY + 1, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Heap monitor started (every %d s, %d samples)",
+             CONFIG_HEAP_MONITOR_PERIOD_S, HISTORY_LEN);
+    return ESP_OK;
+}
+
+esp_err_t heap_monitor_get_report(heap_monitor_report_t *report)
+{
+    if (report == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    build_report(report);
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+#else // CONFIG_HEAP_MONITOR_ENABLE
+
+esp_err_t heap_monitor_start(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t heap_monitor_get_report(heap_monitor_report_t *report)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif // CONFIG_HEAP_MONITOR_ENABLE
@@ -0,0 +1,71 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Subsystems that live allocations are attributed to
+typedef enum {
+    HEAP_SUBSYS_OTHER = 0,
+    HEAP_SUBSYS_MQTT,
+    HEAP_SUBSYS_HTTP,
+    HEAP_SUBSYS_CJSON,
+    HEAP_SUBSYS_NET,        // WiFi driver and lwIP
+    HEAP_SUBSYS_BT,         // Bluetooth controller, host and BLE Mesh
+    HEAP_SUBSYS_MAX,
+} heap_subsys_t;
+
+typedef struct {
+    uint32_t live_bytes;
+    uint32_t live_count;
+    uint32_t peak_bytes;
+    uint32_t alloc_count;       // Total allocations since start
+} heap_subsys_stats_t;
+
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t free_bytes;
+    uint32_t min_free_bytes;    // Minimum ever since boot
+    uint32_t largest_block;
+    uint8_t fragmentation_pct;  // 100 - largest block / free bytes
+    uint32_t sample_count;      // Samples used for the trends
+    int32_t free_trend_bph;     // Least-squares slope of free bytes (bytes per hour)
+    int32_t largest_trend_bph;  // Same for the largest free block
+    uint32_t hours_to_exhaustion; // From the free trend, 0 if not shrinking
+    heap_subsys_stats_t subsys[HEAP_SUBSYS_MAX];
+    uint32_t untracked_allocs;  // Allocations that did not fit the pointer table
+} heap_monitor_report_t;
+
+/**
+ * @brief Start the sampling task and install the cJSON allocator wrapper
+ *
+ * Call before the first cJSON allocation so cJSON memory is attributed.
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if the monitor is disabled
+ */
+esp_err_t heap_monitor_start(void);
+
+/**
+ * @brief Build a report from the current heap state and the sample history
+ *
+ * @param report Output report
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not started
+ */
+esp_err_t heap_monitor_get_report(heap_monitor_report_t *report);
+
+/**
+ * @brief Short name of a subsystem ("mqtt", "http", ...)
+ */
+const char *heap_monitor_subsys_name(heap_subsys_t subsys);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HEAP_MONITOR_H
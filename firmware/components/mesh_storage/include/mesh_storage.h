@@ -3,8 +3,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
-#include "esp_ble_mesh_defs.h"
+#include "sdkconfig.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,6 +15,9 @@ extern "C" {
 #define MESH_NVS_NAMESPACE "ble_mesh"
 
 // NVS keys
+#define NVS_KEY_PROV_BLOB       "prov_blob"     // Versioned, CRC-protected mesh_prov_data_t
+
+// Legacy per-field provisioning keys (read once and migrated to NVS_KEY_PROV_BLOB)
 #define NVS_KEY_PROVISIONED     "provisioned"
 #define NVS_KEY_NODE_ADDR       "node_addr"
 #define NVS_KEY_NET_IDX         "net_idx"
@@ -22,11 +26,18 @@ extern "C" {
 #define NVS_KEY_APP_KEY         "app_key"
 #define NVS_KEY_DEV_KEY         "dev_key"
 #define NVS_KEY_IV_INDEX        "iv_index"
-#define NVS_KEY_MODEL_BOUND     "model_bound"
-#define NVS_KEY_PUB_ADDR        "pub_addr"
-#define NVS_KEY_PUB_APP_IDX     "pub_app_idx"
-#define NVS_KEY_PUB_TTL         "pub_ttl"
-#define NVS_KEY_PUB_PERIOD      "pub_period"
+
+// Per-model keys, at most 15 characters: the model ID is limited to 12
+#define NVS_KEY_MODEL_PREFIX    "m_"            // Binding and publication ("m_onoff_cli")
+#define NVS_KEY_SUB_PREFIX      "s"             // Subscription chunk ("s0_onoff_cli", "s1_onoff_cli", ...)
+
+// Tuning from Kconfig ("Mesh Storage"), defaults per node role
+#define MESH_STORAGE_CACHED_MODELS      CONFIG_MESH_STORAGE_CACHED_MODELS
+#define MESH_STORAGE_COMMIT_DELAY_MS    CONFIG_MESH_STORAGE_COMMIT_DELAY_MS
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+#define MESH_STORAGE_SUB_MAX            CONFIG_MESH_STORAGE_SUB_MAX
+#define MESH_STORAGE_SUB_CHUNK          CONFIG_MESH_STORAGE_SUB_CHUNK
+#endif
 
 // Structure to store provisioning data
 typedef struct {
@@ -54,13 +65,6 @@ typedef struct {
     uint8_t period;
 } mesh_pub_settings_t;
 
-// Structure to store subscription addresses
-#define MAX_SUBSCRIPTION_ADDRS 8
-typedef struct {
-    uint16_t sub_addrs[MAX_SUBSCRIPTION_ADDRS];
-    uint8_t sub_count;
-} mesh_subscription_t;
-
 /**
  * @brief Initialize mesh storage (NVS)
  * 
@@ -68,8 +72,20 @@ typedef struct {
  */
 esp_err_t mesh_storage_init(void);
 
+/**
+ * @brief Write saves that are still waiting for the quiet period to NVS
+ *
+ * Call before esp_restart() so the last configuration change is not lost.
+ *
+ * @return ESP_OK on success or when nothing is pending
+ */
+esp_err_t mesh_storage_flush(void);
+
 /**
  * @brief Save provisioning data to NVS
+ *
+ * Like all save functions this only updates the RAM copy; the write is
+ * committed after MESH_STORAGE_COMMIT_DELAY_MS or by mesh_storage_flush().
  * 
  * @param prov_data Provisioning data to save
  * @return ESP_OK on success
@@ -121,29 +137,48 @@ esp_err_t mesh_storage_save_pub_settings(const char *model_id, const mesh_pub_se
 esp_err_t mesh_storage_load_pub_settings(const char *model_id, mesh_pub_settings_t *pub_settings);
 
 /**
- * @brief Save subscription addresses to NVS
+ * @brief Replace the subscription addresses of a model
+ *
+ * This and the other subscription functions return ESP_ERR_NOT_SUPPORTED
+ * (or false) when CONFIG_MESH_STORAGE_SUBSCRIPTIONS is disabled.
+ *
+ * The addresses are stored sorted and without duplicates; only the NVS
+ * chunks from the first changed address on are rewritten.
  *
  * @param model_id Model ID
- * @param subscription Subscription data
- * @return ESP_OK on success
+ * @param addrs Subscription addresses, in any order
+ * @param count Number of addresses, 0 to clear
+ * @return ESP_OK on success, ESP_ERR_NO_MEM above MESH_STORAGE_SUB_MAX
  */
-esp_err_t mesh_storage_save_subscription(const char *model_id, const mesh_subscription_t *subscription);
+esp_err_t mesh_storage_save_subscriptions(const char *model_id, const uint16_t *addrs, size_t count);
 
 /**
- * @brief Load subscription addresses from NVS
+ * @brief Load the subscription addresses of a model in ascending order
  *
  * @param model_id Model ID
- * @param subscription Buffer to store loaded subscriptions
+ * @param addrs Buffer for up to max_addrs addresses
+ * @param max_addrs Size of addrs; only the count is returned when 0
+ * @param count Number of addresses subscribed, which may exceed max_addrs
  * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no subscriptions
  */
-esp_err_t mesh_storage_load_subscription(const char *model_id, mesh_subscription_t *subscription);
+esp_err_t mesh_storage_load_subscriptions(const char *model_id, uint16_t *addrs, size_t max_addrs, size_t *count);
+
+/**
+ * @brief Check whether a model is subscribed to an address
+ *
+ * @param model_id Model ID
+ * @param sub_addr Subscription address
+ * @return true if subscribed
+ */
+bool mesh_storage_has_subscription(const char *model_id, uint16_t sub_addr);
 
 /**
  * @brief Add a subscription address to a model
  *
  * @param model_id Model ID
  * @param sub_addr Subscription address to add
- * @return ESP_OK on success
+ * @return ESP_OK on success or if already subscribed,
+ *         ESP_ERR_NO_MEM if the model has MESH_STORAGE_SUB_MAX addresses
  */
 esp_err_t mesh_storage_add_subscription(const char *model_id, uint16_t sub_addr);
 
@@ -152,13 +187,15 @@ esp_err_t mesh_storage_add_subscription(const char *model_id, uint16_t sub_addr)
  *
  * @param model_id Model ID
  * @param sub_addr Subscription address to remove
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if not subscribed
  */
 esp_err_t mesh_storage_remove_subscription(const char *model_id, uint16_t sub_addr);
 
 /**
  * @brief Clear all mesh storage data (unprovision)
  *
+ * Saves still waiting to be committed are discarded.
+ *
  * @return ESP_OK on success
  */
 esp_err_t mesh_storage_clear(void);
@@ -0,0 +1,1227 @@
+#include "mesh_storage.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "deferred_log.h"
+#include "tracepoint.h"
+#include "esp_rom_crc.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "MESH_STORAGE";
+
+/*
+ * Provisioning data is stored as a single versioned blob with a CRC.
+ * Older firmware wrote one NVS entry per field (the NVS_KEY_* legacy keys);
+ * with CONFIG_MESH_STORAGE_LEGACY_MIGRATION that layout is still read and
+ * migrated on first load.
+ */
+#define PROV_BLOB_VERSION       1
+#define PROV_FLAG_PROVISIONED   0x01
+#define PROV_FLAG_LEGACY_KEYS   0x02    // Migrated, legacy keys not yet erased
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t flags;
+    uint16_t node_addr;
+    uint16_t net_idx;
+    uint16_t app_idx;
+    uint32_t iv_index;
+    uint8_t net_key[16];
+    uint8_t app_key[16];
+    uint8_t dev_key[16];
+    uint32_t crc;               // CRC32 of all preceding bytes
+} prov_blob_t;
+
+/*
+ * Binding and publication of one model share a record stored under
+ * NVS_KEY_MODEL_PREFIX + model ID. The per-field keys used before
+ * ("onoff_cli_pub_addr", ...) exceeded the 15 character NVS key limit and
+ * were never written, so there is nothing to migrate from them.
+ */
+#define MODEL_BLOB_VERSION      1
+#define MODEL_FLAG_BOUND        0x01
+#define MODEL_FLAG_PUB          0x02
+
+/*
+ * Subscription addresses of a model are kept as a sorted set, so lookups,
+ * adds and removals are binary searches. On flash the set is split into
+ * chunks of MESH_STORAGE_SUB_CHUNK addresses stored under
+ * NVS_KEY_SUB_PREFIX + chunk index (one hex digit) + "_" + model ID
+ * ("s0_onoff_srv"). A change only rewrites the chunks from the first changed
+ * position on; group addresses are usually handed out in ascending order,
+ * which makes that the last chunk.
+ */
+#define SUB_KEY_PREFIX_LEN      (sizeof(NVS_KEY_SUB_PREFIX) - 1 + 2)
+#define SUB_MAX_CHUNKS          16
+#define SUB_CLEAN               UINT16_MAX
+#define MODEL_ID_MAX_LEN        (NVS_KEY_NAME_MAX_SIZE - 1 - SUB_KEY_PREFIX_LEN)
+
+_Static_assert(sizeof(NVS_KEY_MODEL_PREFIX) - 1 <= SUB_KEY_PREFIX_LEN, "model record key must fit the model ID limit");
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+_Static_assert(MESH_STORAGE_SUB_MAX <= SUB_MAX_CHUNKS * MESH_STORAGE_SUB_CHUNK, "subscription set needs more than 16 chunks");
+#endif
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t flags;
+    uint16_t app_idx;
+    uint16_t pub_addr;
+    uint16_t pub_app_idx;
+    uint8_t pub_ttl;
+    uint8_t pub_period;
+    uint32_t crc;               // CRC32 of all preceding bytes
+} model_blob_t;
+
+/*
+ * Saves only update this RAM copy and mark it dirty; everything dirty is
+ * written with a single commit once no save has arrived for
+ * MESH_STORAGE_COMMIT_DELAY_MS, or on mesh_storage_flush(). A provisioner
+ * configuring several models back to back therefore costs one commit, and
+ * the BLE Mesh callbacks never wait for flash. The commit runs in its own
+ * task, not in the esp_timer task, whose other callbacks (button, LEDs,
+ * Friend polls) would otherwise stall for a flash erase.
+ */
+typedef struct {
+    char model_id[MODEL_ID_MAX_LEN + 1];
+    model_blob_t rec;
+    bool rec_dirty;
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+    uint16_t *subs;             // Sorted, grown a chunk at a time
+    uint16_t sub_count;
+    uint16_t sub_cap;
+    uint16_t sub_stored;        // Addresses on flash after the last commit
+    uint16_t sub_chunks;        // Chunk keys on flash
+    uint16_t sub_dirty_from;    // First position changed since, SUB_CLEAN if none
+#endif
+} model_cache_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static esp_timer_handle_t s_commit_timer = NULL;
+static TaskHandle_t s_commit_task = NULL;
+
+static mesh_prov_data_t s_prov;
+static bool s_prov_cached = false;          // s_prov reflects NVS or a newer save
+static bool s_prov_dirty = false;
+
+static model_cache_t s_models[MESH_STORAGE_CACHED_MODELS];
+static size_t s_model_count = 0;
+
+#if CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+static const char *s_legacy_prov_keys[] = {
+    NVS_KEY_PROVISIONED, NVS_KEY_NODE_ADDR, NVS_KEY_NET_IDX, NVS_KEY_APP_IDX,
+    NVS_KEY_NET_KEY, NVS_KEY_APP_KEY, NVS_KEY_DEV_KEY, NVS_KEY_IV_INDEX,
+};
+#endif
+
+static void cache_lock(void)
+{
+    if (s_lock) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+    }
+}
+
+static void cache_unlock(void)
+{
+    if (s_lock) {
+        xSemaphoreGive(s_lock);
+    }
+}
+
+static void prov_blob_encode(const mesh_prov_data_t *prov_data, uint8_t flags, prov_blob_t *blob)
+{
+    memset(blob, 0, sizeof(*blob));
+    blob->version = PROV_BLOB_VERSION;
+    blob->flags = flags | (prov_data->provisioned ? PROV_FLAG_PROVISIONED : 0);
+    blob->node_addr = prov_data->node_addr;
+    blob->net_idx = prov_data->net_idx;
+    blob->app_idx = prov_data->app_idx;
+    blob->iv_index = prov_data->iv_index;
+    memcpy(blob->net_key, prov_data->net_key, 16);
+    memcpy(blob->app_key, prov_data->app_key, 16);
+    memcpy(blob->dev_key, prov_data->dev_key, 16);
+    blob->crc = esp_rom_crc32_le(0, (const uint8_t *)blob, offsetof(prov_blob_t, crc));
+}
+
+static esp_err_t prov_blob_decode(const prov_blob_t *blob, size_t len, mesh_prov_data_t *prov_data)
+{
+    if (len != sizeof(prov_blob_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (blob->crc != esp_rom_crc32_le(0, (const uint8_t *)blob, offsetof(prov_blob_t, crc))) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    if (blob->version != PROV_BLOB_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    prov_data->provisioned = (blob->flags & PROV_FLAG_PROVISIONED) != 0;
+    prov_data->node_addr = blob->node_addr;
+    prov_data->net_idx = blob->net_idx;
+    prov_data->app_idx = blob->app_idx;
+    prov_data->iv_index = blob->iv_index;
+    memcpy(prov_data->net_key, blob->net_key, 16);
+    memcpy(prov_data->app_key, blob->app_key, 16);
+    memcpy(prov_data->dev_key, blob->dev_key, 16);
+    return ESP_OK;
+}
+
+static void model_key(const char *model_id, char *key)
+{
+    snprintf(key, NVS_KEY_NAME_MAX_SIZE, NVS_KEY_MODEL_PREFIX "%s", model_id);
+}
+
+/* Subscription set */
+
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+static void sub_key(size_t chunk, const char *model_id, char *key)
+{
+    snprintf(key, NVS_KEY_NAME_MAX_SIZE, NVS_KEY_SUB_PREFIX "%X_%s", (unsigned)chunk, model_id);
+}
+
+static size_t sub_chunk_count(size_t count)
+{
+    return (count + MESH_STORAGE_SUB_CHUNK - 1) / MESH_STORAGE_SUB_CHUNK;
+}
+
+static bool sub_dirty(const model_cache_t *m)
+{
+    return m->sub_dirty_from != SUB_CLEAN;
+}
+
+static void sub_release(model_cache_t *m)
+{
+    free(m->subs);
+    m->subs = NULL;
+    m->sub_count = 0;
+    m->sub_cap = 0;
+}
+
+// Position of the first address not below addr
+static size_t sub_lower_bound(const model_cache_t *m, uint16_t addr)
+{
+    size_t lo = 0;
+    size_t hi = m->sub_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (m->subs[mid] < addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static bool sub_contains(const model_cache_t *m, uint16_t addr)
+{
+    size_t pos = sub_lower_bound(m, addr);
+    return pos < m->sub_count && m->subs[pos] == addr;
+}
+
+// Grow the set to hold count addresses
+static esp_err_t sub_reserve(model_cache_t *m, size_t count)
+{
+    if (count <= m->sub_cap) {
+        return ESP_OK;
+    }
+    if (count > MESH_STORAGE_SUB_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t cap = sub_chunk_count(count) * MESH_STORAGE_SUB_CHUNK;
+    uint16_t *subs = realloc(m->subs, cap * sizeof(uint16_t));
+    if (subs == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    m->subs = subs;
+    m->sub_cap = cap;
+    return ESP_OK;
+}
+
+static void sub_mark_dirty(model_cache_t *m, size_t pos)
+{
+    if (m->sub_dirty_from == SUB_CLEAN || pos < m->sub_dirty_from) {
+        m->sub_dirty_from = pos;
+    }
+}
+
+// Sort and drop duplicates in place; true if anything changed
+static bool sub_normalize(uint16_t *addrs, size_t *count)
+{
+    bool changed = false;
+
+    // Insertion sort: chunks are read back in order, so this is one pass
+    for (size_t i = 1; i < *count; i++) {
+        uint16_t addr = addrs[i];
+        size_t j = i;
+        while (j > 0 && addrs[j - 1] > addr) {
+            addrs[j] = addrs[j - 1];
+            j--;
+            changed = true;
+        }
+        addrs[j] = addr;
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < *count; i++) {
+        if (out == 0 || addrs[out - 1] != addrs[i]) {
+            addrs[out++] = addrs[i];
+        }
+    }
+    changed |= (out != *count);
+    *count = out;
+    return changed;
+}
+
+/*
+ * Read the chunks of a model's set. A set written with another chunk size,
+ * left unsorted by an interrupted commit or larger than
+ * MESH_STORAGE_SUB_MAX is repaired and marked for a full rewrite.
+ */
+static esp_err_t sub_load(nvs_handle_t nvs_handle, model_cache_t *m)
+{
+    bool rewrite = false;
+    size_t stored = 0;
+
+    for (size_t chunk = 0; chunk < SUB_MAX_CHUNKS; chunk++) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        sub_key(chunk, m->model_id, key);
+
+        size_t len = 0;
+        esp_err_t err = nvs_get_blob(nvs_handle, key, NULL, &len);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            break;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        size_t n = len / sizeof(uint16_t);
+        m->sub_chunks = chunk + 1;
+        stored += n;
+        if ((stored - n) % MESH_STORAGE_SUB_CHUNK != 0 || n > MESH_STORAGE_SUB_CHUNK) {
+            rewrite = true;
+        }
+        if (m->sub_count + n > MESH_STORAGE_SUB_MAX) {
+            // Synchronous: m can be a caller's stack copy, gone by the time the drain task formats it
+            ESP_LOGW(TAG, "⚠️  Subscriptions of %s above %d dropped", m->model_id, MESH_STORAGE_SUB_MAX);
+            rewrite = true;
+            continue;
+        }
+
+        err = sub_reserve(m, m->sub_count + n);
+        if (err == ESP_OK) {
+            len = n * sizeof(uint16_t);
+            err = nvs_get_blob(nvs_handle, key, m->subs + m->sub_count, &len);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        m->sub_count += n;
+    }
+
+    size_t count = m->sub_count;
+    if (sub_normalize(m->subs, &count)) {
+        rewrite = true;
+    }
+    m->sub_count = count;
+    m->sub_stored = stored;
+    if (rewrite) {
+        m->sub_dirty_from = 0;
+    }
+    return ESP_OK;
+}
+
+/*
+ * Write the chunks from the first changed position on and erase the ones
+ * past the end. A grown set is written from the last chunk back, a shrunk
+ * one from the first chunk on, and stale chunks are erased from the end.
+ * If a single add or remove is cut short, every address is still in some
+ * chunk, at worst twice, and sub_load() reads back the old or the new set.
+ */
+static esp_err_t sub_commit(nvs_handle_t nvs_handle, model_cache_t *m)
+{
+    size_t first = m->sub_dirty_from / MESH_STORAGE_SUB_CHUNK;
+    size_t chunks = sub_chunk_count(m->sub_count);
+    bool grown = m->sub_count > m->sub_stored;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    esp_err_t err = ESP_OK;
+
+    for (size_t i = first; i < chunks && err == ESP_OK; i++) {
+        size_t chunk = grown ? chunks - 1 - (i - first) : i;
+        size_t start = chunk * MESH_STORAGE_SUB_CHUNK;
+        size_t n = m->sub_count - start;
+        if (n > MESH_STORAGE_SUB_CHUNK) {
+            n = MESH_STORAGE_SUB_CHUNK;
+        }
+        sub_key(chunk, m->model_id, key);
+        err = nvs_set_blob(nvs_handle, key, m->subs + start, n * sizeof(uint16_t));
+    }
+
+    for (size_t chunk = m->sub_chunks; chunk > chunks && err == ESP_OK; chunk--) {
+        sub_key(chunk - 1, m->model_id, key);
+        err = nvs_erase_key(nvs_handle, key);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    return err;
+}
+
+// The chunks written by sub_commit() are on flash
+static void sub_committed(model_cache_t *m)
+{
+    m->sub_stored = m->sub_count;
+    m->sub_chunks = sub_chunk_count(m->sub_count);
+    m->sub_dirty_from = SUB_CLEAN;
+}
+
+#else // CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+static bool sub_dirty(const model_cache_t *m) { return false; }
+static void sub_release(model_cache_t *m) { }
+static esp_err_t sub_load(nvs_handle_t nvs_handle, model_cache_t *m) { return ESP_OK; }
+static esp_err_t sub_commit(nvs_handle_t nvs_handle, model_cache_t *m) { return ESP_OK; }
+static void sub_committed(model_cache_t *m) { }
+
+#endif // CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+/* Model records */
+
+static bool model_dirty(const model_cache_t *m)
+{
+    return m->rec_dirty || sub_dirty(m);
+}
+
+static esp_err_t model_blob_check(const model_blob_t *blob, size_t len)
+{
+    if (len != sizeof(model_blob_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (blob->crc != esp_rom_crc32_le(0, (const uint8_t *)blob, offsetof(model_blob_t, crc))) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    if (blob->version != MODEL_BLOB_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t commit_locked(void)
+{
+    size_t pending = s_prov_dirty ? 1 : 0;
+    for (size_t i = 0; i < s_model_count; i++) {
+        pending += (s_models[i].rec_dirty ? 1 : 0) + (sub_dirty(&s_models[i]) ? 1 : 0);
+    }
+    if (pending == 0) {
+        return ESP_OK;
+    }
+
+    TRACE_SCOPE("nvs_commit_pending");
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(MESH_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    if (s_prov_dirty) {
+        prov_blob_t blob;
+        prov_blob_encode(&s_prov, 0, &blob);
+        err = nvs_set_blob(nvs_handle, NVS_KEY_PROV_BLOB, &blob, sizeof(blob));
+        if (err != ESP_OK) goto cleanup;
+    }
+
+    for (size_t i = 0; i < s_model_count; i++) {
+        model_cache_t *m = &s_models[i];
+
+        if (m->rec_dirty) {
+            char key[NVS_KEY_NAME_MAX_SIZE];
+            model_key(m->model_id, key);
+            m->rec.crc = esp_rom_crc32_le(0, (const uint8_t *)&m->rec, offsetof(model_blob_t, crc));
+            err = nvs_set_blob(nvs_handle, key, &m->rec, sizeof(m->rec));
+            if (err != ESP_OK) goto cleanup;
+        }
+
+        if (sub_dirty(m)) {
+            err = sub_commit(nvs_handle, m);
+            if (err != ESP_OK) goto cleanup;
+        }
+    }
+
+    err = nvs_commit(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to commit NVS: %s", esp_err_to_name(err));
+        goto cleanup;
+    }
+
+    // Everything is on flash; a failure above leaves it all dirty for the next attempt
+    s_prov_dirty = false;
+    for (size_t i = 0; i < s_model_count; i++) {
+        model_cache_t *m = &s_models[i];
+        m->rec_dirty = false;
+        if (sub_dirty(m)) {
+            sub_committed(m);
+        }
+    }
+    DLOG_I(TAG, "💾 Committed %d pending record(s)", pending);
+
+cleanup:
+    nvs_close(nvs_handle);
+    if (err != ESP_OK) {
+        DLOG_E(TAG, "❌ Commit of %d pending record(s) failed: 0x%x", pending, err);
+    }
+    return err;
+}
+
+static void commit_task(void *arg)
+{
+    while (ulTaskNotifyTake(pdTRUE, portMAX_DELAY) > 0) {
+        mesh_storage_flush();
+    }
+    vTaskDelete(NULL);
+}
+
+// Runs in the esp_timer task: only wake the commit task
+static void commit_timer_cb(void *arg)
+{
+    xTaskNotifyGive(s_commit_task);
+}
+
+// Restart the quiet period after a save; without a timer (delay 0), write through
+static esp_err_t schedule_commit_locked(void)
+{
+    if (s_commit_timer == NULL) {
+        return commit_locked();
+    }
+    esp_timer_stop(s_commit_timer);
+    return esp_timer_start_once(s_commit_timer, MESH_STORAGE_COMMIT_DELAY_MS * 1000ULL);
+}
+
+esp_err_t mesh_storage_init(void)
+{
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGW(TAG, "NVS partition was truncated, erasing...");
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+        if (s_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    if (s_commit_task == NULL && MESH_STORAGE_COMMIT_DELAY_MS > 0 &&
+        xTaskCreate(commit_task, "mesh_commit", 3072, NULL, tskIDLE_PRIORITY + 2, &s_commit_task) != pdPASS) {
+        ESP_LOGW(TAG, "No commit task, saves are written through");
+        s_commit_task = NULL;
+    }
+
+    if (s_commit_timer == NULL && s_commit_task != NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = commit_timer_cb,
+            .name = "mesh_commit",
+        };
+        err = esp_timer_create(&timer_args, &s_commit_timer);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "No commit timer (%s), saves are written through", esp_err_to_name(err));
+            s_commit_timer = NULL;
+        }
+    }
+
+    ESP_LOGI(TAG, "Mesh storage initialized");
+    return ESP_OK;
+}
+
+esp_err_t mesh_storage_flush(void)
+{
+    TRACE_SCOPE("nvs_flush");
+
+    cache_lock();
+    if (s_commit_timer) {
+        esp_timer_stop(s_commit_timer);
+    }
+    esp_err_t err = commit_locked();
+    cache_unlock();
+    return err;
+}
+
+esp_err_t mesh_storage_save_prov_data(const mesh_prov_data_t *prov_data)
+{
+    TRACE_SCOPE("nvs_save_prov_data");
+
+    if (prov_data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    cache_lock();
+    s_prov = *prov_data;
+    s_prov_cached = true;
+    s_prov_dirty = true;
+    esp_err_t err = schedule_commit_locked();
+    cache_unlock();
+
+    // Keys are never logged
+    DLOG_I(TAG, "📝 Provisioning data saved: addr=0x%04X net_idx=0x%04X app_idx=0x%04X iv=0x%08lX",
+           prov_data->node_addr, prov_data->net_idx, prov_data->app_idx, prov_data->iv_index);
+    return err;
+}
+
+#if CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+
+// Read the legacy per-field layout
+static esp_err_t load_legacy_prov_data(nvs_handle_t nvs_handle, mesh_prov_data_t *prov_data)
+{
+    // Load provisioned flag
+    uint8_t provisioned = 0;
+    esp_err_t err = nvs_get_u8(nvs_handle, NVS_KEY_PROVISIONED, &provisioned);
+    if (err != ESP_OK || provisioned == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    prov_data->provisioned = true;
+
+    // Load node address
+    err = nvs_get_u16(nvs_handle, NVS_KEY_NODE_ADDR, &prov_data->node_addr);
+    if (err != ESP_OK) return err;
+
+    // Load network index
+    err = nvs_get_u16(nvs_handle, NVS_KEY_NET_IDX, &prov_data->net_idx);
+    if (err != ESP_OK) return err;
+
+    // Load app index
+    err = nvs_get_u16(nvs_handle, NVS_KEY_APP_IDX, &prov_data->app_idx);
+    if (err != ESP_OK) return err;
+
+    // Load network key
+    size_t key_len = 16;
+    err = nvs_get_blob(nvs_handle, NVS_KEY_NET_KEY, prov_data->net_key, &key_len);
+    if (err != ESP_OK) return err;
+
+    // Load app key
+    key_len = 16;
+    err = nvs_get_blob(nvs_handle, NVS_KEY_APP_KEY, prov_data->app_key, &key_len);
+    if (err != ESP_OK) return err;
+
+    // Load device key
+    key_len = 16;
+    err = nvs_get_blob(nvs_handle, NVS_KEY_DEV_KEY, prov_data->dev_key, &key_len);
+    if (err != ESP_OK) return err;
+
+    // Load IV index
+    return nvs_get_u32(nvs_handle, NVS_KEY_IV_INDEX, &prov_data->iv_index);
+}
+
+// Drop the legacy keys, then clear the flag that says they may exist
+static esp_err_t erase_legacy_prov_keys(nvs_handle_t nvs_handle, const mesh_prov_data_t *prov_data)
+{
+    for (size_t i = 0; i < sizeof(s_legacy_prov_keys) / sizeof(s_legacy_prov_keys[0]); i++) {
+        esp_err_t err = nvs_erase_key(nvs_handle, s_legacy_prov_keys[i]);
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+            return err;
+        }
+    }
+
+    prov_blob_t blob;
+    prov_blob_encode(prov_data, 0, &blob);
+    esp_err_t err = nvs_set_blob(nvs_handle, NVS_KEY_PROV_BLOB, &blob, sizeof(blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    return err;
+}
+
+/*
+ * Rewrite legacy data as a blob, then drop the legacy keys. The blob is
+ * committed first with PROV_FLAG_LEGACY_KEYS set, so a reset at any point
+ * leaves a readable copy and the next load finishes the cleanup.
+ */
+static esp_err_t migrate_legacy_prov_data(const mesh_prov_data_t *prov_data)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(MESH_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    prov_blob_t blob;
+    prov_blob_encode(prov_data, PROV_FLAG_LEGACY_KEYS, &blob);
+
+    err = nvs_set_blob(nvs_handle, NVS_KEY_PROV_BLOB, &blob, sizeof(blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    if (err == ESP_OK) {
+        err = erase_legacy_prov_keys(nvs_handle, prov_data);
+    }
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+#endif // CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+
+// Fill s_prov from NVS; "nothing stored" is cached as not provisioned
+static esp_err_t read_prov_locked(void)
+{
+    mesh_prov_data_t prov_data;
+    memset(&prov_data, 0, sizeof(prov_data));
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(MESH_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        // Namespace never written
+        s_prov = prov_data;
+        s_prov_cached = true;
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        DLOG_W(TAG, "⚠️  Failed to open NVS namespace: 0x%x", err);
+        return err;
+    }
+
+    prov_blob_t blob;
+    size_t blob_len = sizeof(blob);
+    err = nvs_get_blob(nvs_handle, NVS_KEY_PROV_BLOB, &blob, &blob_len);
+    if (err == ESP_OK) {
+        nvs_close(nvs_handle);
+
+        err = prov_blob_decode(&blob, blob_len, &prov_data);
+        if (err != ESP_OK) {
+            DLOG_E(TAG, "❌ Provisioning data rejected: 0x%x", err);
+            return err;
+        }
+
+#if CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+        // A migration was interrupted before the legacy keys were erased
+        if (blob.flags & PROV_FLAG_LEGACY_KEYS) {
+            err = nvs_open(MESH_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+            if (err == ESP_OK) {
+                err = erase_legacy_prov_keys(nvs_handle, &prov_data);
+                nvs_close(nvs_handle);
+            }
+            if (err != ESP_OK) {
+                DLOG_W(TAG, "⚠️  Legacy provisioning keys not erased: 0x%x", err);
+            }
+        }
+#endif
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+#if CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+        // No blob yet: fall back to the legacy layout and migrate it
+        err = load_legacy_prov_data(nvs_handle, &prov_data);
+        nvs_close(nvs_handle);
+        if (err == ESP_ERR_NOT_FOUND) {
+            memset(&prov_data, 0, sizeof(prov_data));
+        } else if (err != ESP_OK) {
+            return err;
+        } else {
+            err = migrate_legacy_prov_data(&prov_data);
+            if (err == ESP_OK) {
+                DLOG_I(TAG, "Provisioning data migrated to blob layout");
+            } else {
+                DLOG_W(TAG, "⚠️  Provisioning data migration failed: 0x%x", err);
+            }
+        }
+#else
+        nvs_close(nvs_handle);
+#endif
+    } else {
+        nvs_close(nvs_handle);
+        return err;
+    }
+
+    s_prov = prov_data;
+    s_prov_cached = true;
+    return ESP_OK;
+}
+
+esp_err_t mesh_storage_load_prov_data(mesh_prov_data_t *prov_data)
+{
+    TRACE_SCOPE("nvs_load_prov_data");
+
+    if (prov_data == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(prov_data, 0, sizeof(mesh_prov_data_t));
+
+    cache_lock();
+    esp_err_t err = s_prov_cached ? ESP_OK : read_prov_locked();
+    if (err == ESP_OK) {
+        *prov_data = s_prov;
+    }
+    cache_unlock();
+
+    if (err != ESP_OK) {
+        memset(prov_data, 0, sizeof(mesh_prov_data_t));
+        return err;
+    }
+    if (!prov_data->provisioned) {
+        DLOG_I(TAG, "ℹ️  Not provisioned");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    DLOG_I(TAG, "📂 Provisioning data loaded: addr=0x%04X net_idx=0x%04X app_idx=0x%04X iv=0x%08lX",
+           prov_data->node_addr, prov_data->net_idx, prov_data->app_idx, prov_data->iv_index);
+    return ESP_OK;
+}
+
+/*
+ * Find the cached record of a model, reading it from NVS on first use.
+ * A model with nothing stored gets an empty record.
+ */
+static esp_err_t get_model_locked(const char *model_id, model_cache_t **out)
+{
+    if (model_id == NULL || strlen(model_id) > MODEL_ID_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; i < s_model_count; i++) {
+        if (strcmp(s_models[i].model_id, model_id) == 0) {
+            *out = &s_models[i];
+            return ESP_OK;
+        }
+    }
+
+    model_cache_t loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    strcpy(loaded.model_id, model_id);
+    loaded.rec.version = MODEL_BLOB_VERSION;
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+    loaded.sub_dirty_from = SUB_CLEAN;
+#endif
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(MESH_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;   // Namespace never written: empty record
+    } else if (err == ESP_OK) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        model_key(model_id, key);
+        size_t len = sizeof(loaded.rec);
+        err = nvs_get_blob(nvs_handle, key, &loaded.rec, &len);
+        if (err == ESP_OK) {
+            err = model_blob_check(&loaded.rec, len);
+            if (err != ESP_OK) {
+                DLOG_E(TAG, "❌ Model record %s rejected: 0x%x", DLOG_STR(model_id), err);
+            }
+        } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+
+        if (err == ESP_OK) {
+            err = sub_load(nvs_handle, &loaded);
+        }
+        nvs_close(nvs_handle);
+    }
+    if (err != ESP_OK) {
+        sub_release(&loaded);
+        return err;
+    }
+
+    // Make room by dropping a clean record, committing first if all are dirty
+    if (s_model_count == MESH_STORAGE_CACHED_MODELS) {
+        size_t victim = 0;
+        while (victim < s_model_count && model_dirty(&s_models[victim])) {
+            victim++;
+        }
+        if (victim == s_model_count) {
+            err = commit_locked();
+            if (err != ESP_OK) {
+                sub_release(&loaded);
+                return err;
+            }
+            victim = 0;
+        }
+        sub_release(&s_models[victim]);
+        s_models[victim] = s_models[--s_model_count];
+    }
+
+    model_cache_t *m = &s_models[s_model_count++];
+    *m = loaded;
+    *out = m;
+    return ESP_OK;
+}
+
+esp_err_t mesh_storage_save_model_binding(const char *model_id, const mesh_model_binding_t *binding)
+{
+    TRACE_SCOPE("nvs_save_model_binding");
+
+    if (model_id == NULL || binding == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    cache_lock();
+    model_cache_t *m;
+    esp_err_t err = get_model_locked(model_id, &m);
+    if (err == ESP_OK) {
+        m->rec.flags = binding->bound ? (m->rec.flags | MODEL_FLAG_BOUND) : (m->rec.flags & ~MODEL_FLAG_BOUND);
+        m->rec.app_idx = binding->app_idx;
+        m->rec_dirty = true;
+        err = schedule_commit_locked();
+    }
+    cache_unlock();
+
+    if (err == ESP_OK) {
+        DLOG_I(TAG, "📝 Model binding saved: %s bound=%d app_idx=0x%04X",
+               DLOG_STR(model_id), binding->bound, binding->app_idx);
+    }
+    return err;
+}
+
+esp_err_t mesh_storage_load_model_binding(const char *model_id, mesh_model_binding_t *binding)
+{
+    TRACE_SCOPE("nvs_load_model_binding");
+
+    if (model_id == NULL || binding == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(binding, 0, sizeof(mesh_model_binding_t));
+
+    cache_lock();
+    model_cache_t *m;
+    esp_err_t err = get_model_locked(model_id, &m);
+    if (err == ESP_OK) {
+        if (m->rec.flags & MODEL_FLAG_BOUND) {
+            binding->bound = true;
+            binding->app_idx = m->rec.app_idx;
+        } else {
+            err = ESP_ERR_NOT_FOUND;
+        }
+    }
+    cache_unlock();
+
+    if (err == ESP_OK) {
+        DLOG_I(TAG, "📂 Model binding loaded: %s bound=%d app_idx=0x%04X",
+               DLOG_STR(model_id), binding->bound, binding->app_idx);
+    }
+    return err;
+}
+
+esp_err_t mesh_storage_save_pub_settings(const char *model_id, const mesh_pub_settings_t *pub_settings)
+{
+    TRACE_SCOPE("nvs_save_pub_settings");
+
+    if (model_id == NULL || pub_settings == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    cache_lock();
+    model_cache_t *m;
+    esp_err_t err = get_model_locked(model_id, &m);
+    if (err == ESP_OK) {
+        m->rec.flags |= MODEL_FLAG_PUB;
+        m->rec.pub_addr = pub_settings->publish_addr;
+        m->rec.pub_app_idx = pub_settings->app_idx;
+        m->rec.pub_ttl = pub_settings->ttl;
+        m->rec.pub_period = pub_settings->period;
+        m->rec_dirty = true;
+        err = schedule_commit_locked();
+    }
+    cache_unlock();
+
+    if (err == ESP_OK) {
+        DLOG_I(TAG, "📝 Publication settings saved: %s addr=0x%04X app_idx=0x%04X ttl=%d period=%d",
+               DLOG_STR(model_id), pub_settings->publish_addr, pub_settings->app_idx,
+               pub_settings->ttl, pub_settings->period);
+    }
+    return err;
+}
+
+esp_err_t mesh_storage_load_pub_settings(const char *model_id, mesh_pub_settings_t *pub_settings)
+{
+    TRACE_SCOPE("nvs_load_pub_settings");
+
+    if (model_id == NULL || pub_settings == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(pub_settings, 0, sizeof(mesh_pub_settings_t));
+
+    cache_lock();
+    model_cache_t *m;
+    esp_err_t err = get_model_locked(model_id, &m);
+    if (err == ESP_OK) {
+        if (m->rec.flags & MODEL_FLAG_PUB) {
+            pub_settings->publish_addr = m->rec.pub_addr;
+            pub_settings->app_idx = m->rec.pub_app_idx;
+            pub_settings->ttl = m->rec.pub_ttl;
+            pub_settings->period = m->rec.pub_period;
+        } else {
+            err = ESP_ERR_NOT_FOUND;
+        }
+    }
+    cache_unlock();
+
+    if (err == ESP_OK) {
+        DLOG_I(TAG, "📂 Publication settings loaded: %s addr=0x%04X app_idx=0x%04X ttl=%d period=%d",
+               DLOG_STR(model_id), pub_settings->publish_addr, pub_settings->app_idx,
+               pub_settings->ttl, pub_settings->period);
+    }
+    return err;
+}
+
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+esp_err_t mesh_storage_save_subscriptions(const char *model_id, const uint16_t *addrs, size_t count)
+{
+    TRACE_SCOPE("nvs_save_subscriptions");
+
+    if (model_id == NULL || (addrs == NULL && count > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint16_t *sorted = NULL;
+    if (count > 0) {
+        sorted = malloc(count * sizeof(uint16_t));
+        if (sorted == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(sorted, addrs, count * sizeof(uint16_t));
+        sub_normalize(sorted, &count);
+    }
+    if (count > MESH_STORAGE_SUB_MAX) {
+        free(sorted);
+        return ESP_ERR_NO_MEM;
+    }
+
+    cache_lock();
+    model_cache_t *m;
+    esp_err_t err = get_model_locked(model_id, &m);
+    if (err == ESP_OK) {
+        err = sub_reserve(m, count);
+    }
+    if (err == ESP_OK) {
+        // Only the chunks from the first difference on are rewritten
+        size_t same = 0;
+        while (same < count && same < m->sub_count && m->subs[same] == sorted[same]) {
+            same++;
+        }
+        if (same < count || count != m->sub_count) {
+            if (count > 0) {
+                memcpy(m->subs, sorted, count * sizeof(uint16_t));
+            }
+            m->sub_count = count;
+            sub_mark_dirty(m, same);
+            err = schedule_commit_locked();
+        }
+    }
+    cache_unlock();
+    free(sorted);
+
+    if (err == ESP_OK) {
+        DLOG_I(TAG, "📝 Subscriptions saved: %s count=%d", DLOG_STR(model_id), count);
+    }
+    return err;
+}
+
+esp_err_t mesh_storage_load_subscriptions(const char *model_id, uint16_t *addrs, size_t max_addrs, size_t *count)
+{
+    TRACE_SCOPE("nvs_load_subscriptions");
+
+    if (model_id == NULL || count == NULL || (addrs == NULL && max_addrs > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *count = 0;
+
+    cache_lock();
+    model_cache_t *m;
+    esp_err_t err = get_model_locked(model_id, &m);
+    if (err == ESP_OK) {
+        if (m->sub_count > 0) {
+            size_t n = m->sub_count < max_addrs ? m->sub_count : max_addrs;
+            if (n > 0) {
+                memcpy(addrs, m->subs, n * sizeof(uint16_t));
+            }
+            *count = m->sub_count;
+        } else {
+            err = ESP_ERR_NOT_FOUND;
+        }
+    }
+    cache_unlock();
+
+    if (err == ESP_OK) {
+        DLOG_I(TAG, "📂 Subscriptions loaded: %s count=%d", DLOG_STR(model_id), *count);
+    }
+    return err;
+}
+
+bool mesh_storage_has_subscription(const char *model_id, uint16_t sub_addr)
+{
+    cache_lock();
+    model_cache_t *m;
+    bool found = get_model_locked(model_id, &m) == ESP_OK && sub_contains(m, sub_addr);
+    cache_unlock();
+    return found;
+}
+
+esp_err_t mesh_storage_add_subscription(const char *model_id, uint16_t sub_addr)
+{
+    if (model_id == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    cache_lock();
+    model_cache_t *m;
+    esp_err_t err = get_model_locked(model_id, &m);
+    if (err != ESP_OK) {
+        goto done;
+    }
+
+    size_t pos = sub_lower_bound(m, sub_addr);
+    if (pos < m->sub_count && m->subs[pos] == sub_addr) {
+        DLOG_W(TAG, "Already subscribed to 0x%04X", sub_addr);
+        goto done;
+    }
+
+    err = sub_reserve(m, m->sub_count + 1);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot add subscription 0x%04X to %s (%d stored, max %d)",
+                 sub_addr, model_id, m->sub_count, MESH_STORAGE_SUB_MAX);
+        goto done;
+    }
+
+    memmove(&m->subs[pos + 1], &m->subs[pos], (m->sub_count - pos) * sizeof(uint16_t));
+    m->subs[pos] = sub_addr;
+    m->sub_count++;
+    sub_mark_dirty(m, pos);
+    err = schedule_commit_locked();
+    DLOG_I(TAG, "📝 Subscription added: %s 0x%04X count=%d",
+           DLOG_STR(model_id), sub_addr, m->sub_count);
+
+done:
+    cache_unlock();
+    return err;
+}
+
+esp_err_t mesh_storage_remove_subscription(const char *model_id, uint16_t sub_addr)
+{
+    if (model_id == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    cache_lock();
+    model_cache_t *m;
+    esp_err_t err = get_model_locked(model_id, &m);
+    if (err != ESP_OK) {
+        goto done;
+    }
+
+    size_t pos = sub_lower_bound(m, sub_addr);
+    if (pos == m->sub_count || m->subs[pos] != sub_addr) {
+        DLOG_W(TAG, "Subscription 0x%04X not found", sub_addr);
+        err = ESP_ERR_NOT_FOUND;
+        goto done;
+    }
+
+    memmove(&m->subs[pos], &m->subs[pos + 1], (m->sub_count - pos - 1) * sizeof(uint16_t));
+    m->sub_count--;
+    sub_mark_dirty(m, pos);
+    err = schedule_commit_locked();
+    DLOG_I(TAG, "📝 Subscription removed: %s 0x%04X count=%d",
+           DLOG_STR(model_id), sub_addr, m->sub_count);
+
+done:
+    cache_unlock();
+    return err;
+}
+
+#else // CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+esp_err_t mesh_storage_save_subscriptions(const char *model_id, const uint16_t *addrs, size_t count)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mesh_storage_load_subscriptions(const char *model_id, uint16_t *addrs, size_t max_addrs, size_t *count)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+bool mesh_storage_has_subscription(const char *model_id, uint16_t sub_addr)
+{
+    return false;
+}
+
+esp_err_t mesh_storage_add_subscription(const char *model_id, uint16_t sub_addr)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mesh_storage_remove_subscription(const char *model_id, uint16_t sub_addr)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif // CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+esp_err_t mesh_storage_clear(void)
+{
+    TRACE_SCOPE("nvs_clear");
+
+    cache_lock();
+
+    // Pending saves are dropped with everything else
+    if (s_commit_timer) {
+        esp_timer_stop(s_commit_timer);
+    }
+    memset(&s_prov, 0, sizeof(s_prov));
+    s_prov_cached = false;
+    s_prov_dirty = false;
+    for (size_t i = 0; i < s_model_count; i++) {
+        sub_release(&s_models[i]);
+    }
+    s_model_count = 0;
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(MESH_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        cache_unlock();
+        return err;
+    }
+
+    err = nvs_erase_all(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to erase NVS: %s", esp_err_to_name(err));
+        nvs_close(nvs_handle);
+        cache_unlock();
+        return err;
+    }
+
+    err = nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+    cache_unlock();
+
+    ESP_LOGI(TAG, "Mesh storage cleared");
+    return err;
+}
+
+bool mesh_storage_is_provisioned(void)
+{
+    TRACE_SCOPE("nvs_is_provisioned");
+
+    cache_lock();
+    esp_err_t err = s_prov_cached ? ESP_OK : read_prov_locked();
+    bool provisioned = (err == ESP_OK && s_prov.provisioned);
+    cache_unlock();
+
+    return provisioned;
+}
@@ -0,0 +1,186 @@
+#ifndef MESH_VENDOR_H
+#define MESH_VENDOR_H
+
+#include <stdint.h>
+#include "esp_ble_mesh_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Smart Storage vendor model, shared by the gateway (client) and the
+ * endpoints (server). All multi-byte fields are little-endian.
+ */
+
+#define MESH_VND_CID                    0x02E5  // Espressif company ID
+#define MESH_VND_MODEL_ID_CLIENT        0x0000
+#define MESH_VND_MODEL_ID_SERVER        0x0001
+
+// Endpoint -> Gateway: task profiler report (segmented)
+#define MESH_VND_OP_PROFILE_STATUS      ESP_BLE_MESH_MODEL_OP_3(0x01, MESH_VND_CID)
+
+/*
+ * PROFILE_STATUS payload:
+ *   [0]     window length in seconds (saturated at 255)
+ *   [1]     number of entries that follow
+ *   [2..]   entries of MESH_VND_PROFILE_ENTRY_LEN bytes:
+ *             name[4]        task name prefix, not NUL-terminated
+ *             cpu_half_pct   CPU share in units of 0.5 %
+ *             stack_hwm[2]   minimum free stack in bytes
+ */
+#define MESH_VND_PROFILE_NAME_LEN       4
+#define MESH_VND_PROFILE_ENTRY_LEN      (MESH_VND_PROFILE_NAME_LEN + 3)
+#define MESH_VND_PROFILE_MAX_ENTRIES    12
+#define MESH_VND_PROFILE_MAX_LEN        (2 + MESH_VND_PROFILE_MAX_ENTRIES * MESH_VND_PROFILE_ENTRY_LEN)
+
+// Gateway -> Endpoint: install an LED pattern (unacknowledged)
+#define MESH_VND_OP_LED_PATTERN_SET     ESP_BLE_MESH_MODEL_OP_3(0x02, MESH_VND_CID)
+
+// Gateway -> Endpoint: start or stop an installed LED pattern (unacknowledged)
+#define MESH_VND_OP_LED_PATTERN_TRIGGER ESP_BLE_MESH_MODEL_OP_3(0x03, MESH_VND_CID)
+
+/*
+ * LED_PATTERN_SET payload, 8 bytes so it fits one unsegmented PDU:
+ *   [0]     pattern ID, below MESH_VND_LED_PATTERN_MAX
+ *   [1..3]  red, green, blue
+ *   [4]     on time in MESH_VND_LED_TIME_UNIT_MS units, 0 clears the pattern
+ *   [5]     off time in the same units, 0 for solid
+ *   [6]     repeat count: on/off cycles before the pattern stops, 0 = until stopped
+ *   [7]     priority: the active pattern with the highest one is shown
+ *
+ * LED_PATTERN_TRIGGER payload:
+ *   [0]     pattern ID
+ *   [1]     1 = start (restarts the repeat count), 0 = stop
+ *
+ * IDs below MESH_VND_LED_PATTERN_USER are the endpoint's own indications,
+ * started and stopped by its state or by INDICATE; installing one of them
+ * restyles it.
+ */
+#define MESH_VND_LED_PATTERN_SET_LEN        8
+#define MESH_VND_LED_PATTERN_TRIGGER_LEN    2
+#define MESH_VND_LED_TIME_UNIT_MS           50
+#define MESH_VND_LED_PATTERN_MAX            16
+
+#define MESH_VND_LED_PATTERN_LOCATION       0   // Green solid - storage location
+#define MESH_VND_LED_PATTERN_BATTERY_LOW    1   // Red blinking - battery low
+#define MESH_VND_LED_PATTERN_NO_GATEWAY     2   // Blue blinking - no gateway connection
+#define MESH_VND_LED_PATTERN_IDLE           3   // Yellow blip - heartbeat, triggered by the gateway
+#define MESH_VND_LED_PATTERN_INDICATE       4   // Set by INDICATE
+#define MESH_VND_LED_PATTERN_QUANTITY       5   // Quantity blinks ahead of an INDICATE
+#define MESH_VND_LED_PATTERN_USER           6   // First ID free for installed patterns
+
+/*
+ * All messages below fit one unsegmented access PDU: 3 opcode bytes plus
+ * at most MESH_VND_UNSEG_MAX_LEN bytes of payload.
+ */
+#define MESH_VND_UNSEG_MAX_LEN          8
+
+// Gateway -> Endpoint: light the bin for a pick (unacknowledged)
+#define MESH_VND_OP_INDICATE            ESP_BLE_MESH_MODEL_OP_3(0x04, MESH_VND_CID)
+
+/*
+ * INDICATE payload:
+ *   [0..2]  red, green, blue; all 0 ends the current indication
+ *   [3]     pattern, MESH_VND_INDICATE_*
+ *   [4..5]  duration in seconds, 0 = until the button is pressed
+ *   [6]     quantity to pick, shown as that many blinks first, 0 = none
+ */
+#define MESH_VND_INDICATE_LEN           7
+#define MESH_VND_INDICATE_SOLID         0
+#define MESH_VND_INDICATE_BLINK         1   // 500 ms on/off
+#define MESH_VND_INDICATE_FAST_BLINK    2   // 150 ms on/off
+#define MESH_VND_INDICATE_QUANTITY_MAX  20
+
+// Endpoint -> Gateway: button press (unacknowledged)
+#define MESH_VND_OP_PRESS_REPORT        ESP_BLE_MESH_MODEL_OP_3(0x05, MESH_VND_CID)
+
+/*
+ * PRESS_REPORT payload:
+ *   [0]     sequence, incremented per press, so repeats can be dropped
+ *   [1]     press type, MESH_VND_PRESS_*
+ *   [2]     battery level in percent
+ *   [3..4]  age in seconds: how long the press waited in the endpoint's queue
+ *           for a Friend, 0 when sent right away (saturated at
+ *           MESH_VND_PRESS_AGE_MAX, MESH_VND_PRESS_AGE_UNKNOWN after a power loss)
+ *
+ * Endpoints from before the press queue send only the first 3 bytes.
+ */
+#define MESH_VND_PRESS_REPORT_LEN       5
+#define MESH_VND_PRESS_REPORT_MIN_LEN   3
+#define MESH_VND_PRESS_AGE_MAX          0xFFFE
+#define MESH_VND_PRESS_AGE_UNKNOWN      0xFFFF
+#define MESH_VND_PRESS_TAP              0
+#define MESH_VND_PRESS_LONG             1   // Released after a long press, before the reset hold
+
+// Gateway -> Endpoint: factory reset (unacknowledged)
+#define MESH_VND_OP_RESET               ESP_BLE_MESH_MODEL_OP_3(0x06, MESH_VND_CID)
+
+/*
+ * RESET payload:
+ *   [0..1]  unicast address of the target; an endpoint ignores a reset
+ *           naming another node, so a group address cannot reset a zone
+ */
+#define MESH_VND_RESET_LEN              2
+
+// Gateway -> Endpoint: set the Low Power Node poll policy (unacknowledged)
+#define MESH_VND_OP_LPN_POLL_SET        ESP_BLE_MESH_MODEL_OP_3(0x07, MESH_VND_CID)
+
+/*
+ * LPN_POLL_SET payload:
+ *   [0..1]  fast poll interval in ms, used after a press or indication
+ *   [2..3]  active window in seconds: fast polling lasts this long after
+ *           the last press or indication, then the interval doubles per poll
+ *   [4..5]  idle poll interval in seconds the backoff stops at, 0 = the
+ *           stack's own poll interval (CONFIG_BLE_MESH_LPN_POLL_TIMEOUT)
+ *
+ * The endpoint answers with an LPN_STATUS.
+ */
+#define MESH_VND_LPN_POLL_SET_LEN       6
+
+// Endpoint -> Gateway: periodic status, poll statistics since the last one (unacknowledged)
+#define MESH_VND_OP_LPN_STATUS          ESP_BLE_MESH_MODEL_OP_3(0x08, MESH_VND_CID)
+
+/*
+ * LPN_STATUS payload:
+ *   [0]     minutes covered by the report (saturated at 255)
+ *   [1..2]  polls sent by the poll policy, the stack's own polls excluded
+ *   [3..4]  seconds spent in the active window
+ *   [5]     indications received (saturated at 255)
+ *   [6]     mean poll interval when they arrived, the worst-case wait at
+ *           the Friend, in MESH_VND_LPN_LATENCY_UNIT_MS units (saturated)
+ *   [7]     battery level in percent
+ */
+#define MESH_VND_LPN_STATUS_LEN         8
+#define MESH_VND_LPN_LATENCY_UNIT_MS    250
+
+// Endpoint -> Gateway: energy model estimate since the last report (unacknowledged)
+#define MESH_VND_OP_ENERGY_STATUS       ESP_BLE_MESH_MODEL_OP_3(0x09, MESH_VND_CID)
+
+/*
+ * ENERGY_STATUS payload:
+ *   [0]     minutes covered by the report (saturated at 255)
+ *   [1..2]  average current in uA (saturated)
+ *   [3]     time in light sleep, percent
+ *   [4..7]  share of the charge, percent: awake CPU, radio, LEDs, light sleep
+ */
+#define MESH_VND_ENERGY_STATUS_LEN      8
+
+// Gateway -> Endpoint: set the NeoPixel brightness (unacknowledged)
+#define MESH_VND_OP_LED_BRIGHTNESS_SET  ESP_BLE_MESH_MODEL_OP_3(0x0A, MESH_VND_CID)
+
+/*
+ * LED_BRIGHTNESS_SET payload:
+ *   [0]     scale applied to every pattern's color, percent, from
+ *           MESH_VND_LED_BRIGHTNESS_MIN to 100; the endpoint keeps it
+ *           across restarts
+ */
+#define MESH_VND_LED_BRIGHTNESS_SET_LEN 1
+#define MESH_VND_LED_BRIGHTNESS_MIN     1
+#define MESH_VND_LED_BRIGHTNESS_MAX     100
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MESH_VENDOR_H
@@ -0,0 +1,66 @@
+#ifndef NVS_WEAR_H
+#define NVS_WEAR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Write counts of one namespace/key pair since boot
+typedef struct {
+    char namespace_name[16];
+    char key[16];               // "*" for nvs_erase_all() on the namespace
+    uint32_t writes;            // Successful nvs_set_*() calls
+    uint32_t entries;           // 32 byte NVS entries those writes take
+    uint32_t erases;            // nvs_erase_key()/nvs_erase_all() calls
+} nvs_wear_key_stats_t;
+
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t writes;
+    uint32_t entries;
+    uint32_t erases;
+    uint32_t commits;
+    uint32_t untracked_writes;  // Writes to pairs that did not fit the table
+    uint32_t key_count;
+    // From nvs_get_stats() on the default partition
+    uint32_t used_entries;
+    uint32_t free_entries;
+    uint32_t total_entries;
+    uint32_t namespace_count;
+    // Projection from the write rate since boot
+    uint32_t entries_per_hour;
+    uint32_t amplification_pct; // Entries moved by page reclaim, 100 = none
+    uint32_t lifetime_days;     // Until sectors reach the rated cycles, UINT32_MAX if no writes
+} nvs_wear_report_t;
+
+/**
+ * @brief Build a report from the write counts and the partition state
+ *
+ * Entries are counted as NVS lays them out (one per integer, two plus one
+ * per 32 bytes for a blob). NVS skips writes of an unchanged value, so the
+ * counts and the projection are an upper bound.
+ *
+ * @param report Output report
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if the profiler is disabled
+ */
+esp_err_t nvs_wear_get_report(nvs_wear_report_t *report);
+
+/**
+ * @brief Copy the tracked namespace/key pairs, most entries written first
+ *
+ * @param keys Output array
+ * @param max_keys Size of keys
+ * @return Number of pairs copied, 0 if the profiler is disabled
+ */
+size_t nvs_wear_get_keys(nvs_wear_key_stats_t *keys, size_t max_keys);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NVS_WEAR_H
@@ -0,0 +1,319 @@
+#include "nvs_wear.h"
+
+#if CONFIG_NVS_WEAR_ENABLE
+
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdlib.h>
+
+/*
+ * The build links every caller of the NVS write functions against the
+ * __wrap_ versions below (see CMakeLists.txt); each forwards to __real_ and
+ * counts the call against the namespace its handle was opened on.
+ */
+
+#define MAX_KEYS            CONFIG_NVS_WEAR_MAX_KEYS
+#define MAX_HANDLES         16
+#define ENTRY_SIZE          32
+#define ENTRIES_PER_PAGE    126
+#define NAME_LEN            16      // NVS key and namespace names, with terminator
+
+typedef struct {
+    nvs_handle_t handle;
+    char namespace_name[NAME_LEN];
+} open_handle_t;
+
+static nvs_wear_key_stats_t s_keys[MAX_KEYS];
+static size_t s_key_count = 0;
+static open_handle_t s_handles[MAX_HANDLES];
+static uint32_t s_commits = 0;
+static uint32_t s_untracked = 0;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *namespace_of(nvs_handle_t handle)
+{
+    for (size_t i = 0; i < MAX_HANDLES; i++) {
+        if (s_handles[i].handle == handle && s_handles[i].namespace_name[0] != '\0') {
+            return s_handles[i].namespace_name;
+        }
+    }
+    return "?";
+}
+
+static nvs_wear_key_stats_t *find_key(const char *namespace_name, const char *key)
+{
+    for (size_t i = 0; i < s_key_count; i++) {
+        if (strncmp(s_keys[i].namespace_name, namespace_name, NAME_LEN) == 0 &&
+            strncmp(s_keys[i].key, key, NAME_LEN) == 0) {
+            return &s_keys[i];
+        }
+    }
+    if (s_key_count == MAX_KEYS) {
+        return NULL;
+    }
+
+    nvs_wear_key_stats_t *k = &s_keys[s_key_count++];
+    memset(k, 0, sizeof(*k));
+    strlcpy(k->namespace_name, namespace_name, NAME_LEN);
+    strlcpy(k->key, key, NAME_LEN);
+    return k;
+}
+
+static void record(nvs_handle_t handle, const char *key, uint32_t entries, bool erase)
+{
+    if (key == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_mux);
+    nvs_wear_key_stats_t *k = find_key(namespace_of(handle), key);
+    if (k == NULL) {
+        s_untracked++;
+    } else if (erase) {
+        k->erases++;
+    } else {
+        k->writes++;
+        k->entries += entries;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+// Entries a value takes: a header, plus data entries for strings and blobs
+static uint32_t data_entries(size_t len)
+{
+    return (len + ENTRY_SIZE - 1) / ENTRY_SIZE;
+}
+
+/* Handle tracking */
+
+esp_err_t __real_nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle);
+esp_err_t __real_nvs_open_from_partition(const char *part_name, const char *namespace_name,
+                                         nvs_open_mode_t open_mode, nvs_handle_t *out_handle);
+void __real_nvs_close(nvs_handle_t handle);
+
+static void track_handle(esp_err_t err, const char *namespace_name, nvs_handle_t *out_handle)
+{
+    if (err != ESP_OK || namespace_name == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_mux);
+    for (size_t i = 0; i < MAX_HANDLES; i++) {
+        if (s_handles[i].namespace_name[0] == '\0') {
+            s_handles[i].handle = *out_handle;
+            strlcpy(s_handles[i].namespace_name, namespace_name, NAME_LEN);
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+esp_err_t __wrap_nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    esp_err_t err = __real_nvs_open(namespace_name, open_mode, out_handle);
+    track_handle(err, namespace_name, out_handle);
+    return err;
+}
+
+esp_err_t __wrap_nvs_open_from_partition(const char *part_name, const char *namespace_name,
+                                         nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    esp_err_t err = __real_nvs_open_from_partition(part_name, namespace_name, open_mode, out_handle);
+    track_handle(err, namespace_name, out_handle);
+    return err;
+}
+
+void __wrap_nvs_close(nvs_handle_t handle)
+{
+    portENTER_CRITICAL(&s_mux);
+    for (size_t i = 0; i < MAX_HANDLES; i++) {
+        if (s_handles[i].handle == handle && s_handles[i].namespace_name[0] != '\0') {
+            s_handles[i].namespace_name[0] = '\0';
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_mux);
+
+    __real_nvs_close(handle);
+}
+
+/* Writes */
+
+#define WRAP_SET_INT(suffix, type) \
+    esp_err_t __real_nvs_set_##suffix(nvs_handle_t handle, const char *key, type value); \
+    esp_err_t __wrap_nvs_set_##suffix(nvs_handle_t handle, const char *key, type value) \
+    { \
+        esp_err_t err = __real_nvs_set_##suffix(handle, key, value); \
+        if (err == ESP_OK) { \
+            record(handle, key, 1, false); \
+        } \
+        return err; \
+    }
+
+WRAP_SET_INT(i8, int8_t)
+WRAP_SET_INT(u8, uint8_t)
+WRAP_SET_INT(i16, int16_t)
+WRAP_SET_INT(u16, uint16_t)
+WRAP_SET_INT(i32, int32_t)
+WRAP_SET_INT(u32, uint32_t)
+WRAP_SET_INT(i64, int64_t)
+WRAP_SET_INT(u64, uint64_t)
+
+esp_err_t __real_nvs_set_str(nvs_handle_t handle, const char *key, const char *value);
+esp_err_t __real_nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t __real_nvs_erase_key(nvs_handle_t handle, const char *key);
+esp_err_t __real_nvs_erase_all(nvs_handle_t handle);
+esp_err_t __real_nvs_commit(nvs_handle_t handle);
+
+esp_err_t __wrap_nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    esp_err_t err = __real_nvs_set_str(handle, key, value);
+    if (err == ESP_OK) {
+        record(handle, key, 1 + data_entries(strlen(value) + 1), false);
+    }
+    return err;
+}
+
+esp_err_t __wrap_nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    esp_err_t err = __real_nvs_set_blob(handle, key, value, length);
+    if (err == ESP_OK) {
+        // Blob index entry, then a chunk header and the data
+        record(handle, key, 2 + data_entries(length), false);
+    }
+    return err;
+}
+
+esp_err_t __wrap_nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    esp_err_t err = __real_nvs_erase_key(handle, key);
+    if (err == ESP_OK) {
+        record(handle, key, 0, true);
+    }
+    return err;
+}
+
+esp_err_t __wrap_nvs_erase_all(nvs_handle_t handle)
+{
+    esp_err_t err = __real_nvs_erase_all(handle);
+    if (err == ESP_OK) {
+        record(handle, "*", 0, true);
+    }
+    return err;
+}
+
+esp_err_t __wrap_nvs_commit(nvs_handle_t handle)
+{
+    esp_err_t err = __real_nvs_commit(handle);
+    if (err == ESP_OK) {
+        portENTER_CRITICAL(&s_mux);
+        s_commits++;
+        portEXIT_CRITICAL(&s_mux);
+    }
+    return err;
+}
+
+/* Report */
+
+esp_err_t nvs_wear_get_report(nvs_wear_report_t *report)
+{
+    if (report == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+
+    portENTER_CRITICAL(&s_mux);
+    for (size_t i = 0; i < s_key_count; i++) {
+        report->writes += s_keys[i].writes;
+        report->entries += s_keys[i].entries;
+        report->erases += s_keys[i].erases;
+    }
+    report->commits = s_commits;
+    report->untracked_writes = s_untracked;
+    report->key_count = s_key_count;
+    portEXIT_CRITICAL(&s_mux);
+
+    nvs_stats_t stats;
+    esp_err_t err = nvs_get_stats(NULL, &stats);
+    if (err != ESP_OK) {
+        return err;
+    }
+    report->used_entries = stats.used_entries;
+    report->free_entries = stats.free_entries;
+    report->total_entries = stats.total_entries;
+    report->namespace_count = stats.namespace_count;
+
+    /*
+     * NVS writes pages in a ring and reclaims the page with the fewest live
+     * entries, copying those first; one page is kept free for that. So each
+     * erase cycle of the partition yields total - used - one page of new
+     * entries, and the live share sets the copy overhead.
+     */
+    uint64_t usable = stats.total_entries > ENTRIES_PER_PAGE ? stats.total_entries - ENTRIES_PER_PAGE : 0;
+    uint64_t reclaimable = usable > stats.used_entries ? usable - stats.used_entries : 0;
+    report->amplification_pct = reclaimable ? (uint32_t)(usable * 100 / reclaimable) : 0;
+
+    uint32_t uptime_s = report->uptime_s ? report->uptime_s : 1;
+    report->entries_per_hour = (uint32_t)((uint64_t)report->entries * 3600 / uptime_s);
+
+    if (report->entries == 0) {
+        report->lifetime_days = UINT32_MAX;
+    } else {
+        uint64_t days = (uint64_t)CONFIG_NVS_WEAR_ERASE_CYCLES * reclaimable * uptime_s /
+                        ((uint64_t)report->entries * 86400);
+        report->lifetime_days = days > UINT32_MAX ? UINT32_MAX : (uint32_t)days;
+    }
+    return ESP_OK;
+}
+
+static int compare_entries_desc(const void *a, const void *b)
+{
+    const nvs_wear_key_stats_t *ka = a;
+    const nvs_wear_key_stats_t *kb = b;
+    return (ka->entries < kb->entries) - (ka->entries > kb->entries);
+}
+
+size_t nvs_wear_get_keys(nvs_wear_key_stats_t *keys, size_t max_keys)
+{
+    if (keys == NULL || max_keys == 0) {
+        return 0;
+    }
+
+    // Sort a snapshot so the table keeps its order for lookups
+    nvs_wear_key_stats_t *snapshot = malloc(sizeof(s_keys));
+    if (snapshot == NULL) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&s_mux);
+    size_t count = s_key_count;
+    memcpy(snapshot, s_keys, count * sizeof(nvs_wear_key_stats_t));
+    portEXIT_CRITICAL(&s_mux);
+
+    qsort(snapshot, count, sizeof(nvs_wear_key_stats_t), compare_entries_desc);
+    if (count > max_keys) {
+        count = max_keys;
+    }
+    memcpy(keys, snapshot, count * sizeof(nvs_wear_key_stats_t));
+    free(snapshot);
+    return count;
+}
+
+#else // CONFIG_NVS_WEAR_ENABLE
+
+esp_err_t nvs_wear_get_report(nvs_wear_report_t *report)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+size_t nvs_wear_get_keys(nvs_wear_key_stats_t *keys, size_t max_keys)
+{
+    return 0;
+}
+
+#endif // CONFIG_NVS_WEAR_ENABLE
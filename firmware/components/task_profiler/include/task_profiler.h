@@ -0,0 +1,64 @@
+#ifndef TASK_PROFILER_H
+#define TASK_PROFILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TASK_PROFILER_NAME_LEN 16
+
+#ifndef CONFIG_TASK_PROFILER_MAX_TASKS
+#define CONFIG_TASK_PROFILER_MAX_TASKS 24
+#endif
+
+// Per-task result of one sampling window
+typedef struct {
+    char name[TASK_PROFILER_NAME_LEN];
+    uint8_t priority;
+    uint16_t cpu_permille;       // Share of the window spent in this task (0-1000)
+    uint32_t stack_hwm_bytes;    // Minimum free stack ever seen (bytes)
+} task_profiler_entry_t;
+
+// Result of the most recent sampling window, sorted by CPU usage
+typedef struct {
+    uint32_t window_ms;
+    uint32_t sample_count;
+    size_t task_count;
+    task_profiler_entry_t tasks[CONFIG_TASK_PROFILER_MAX_TASKS];
+} task_profiler_snapshot_t;
+
+/**
+ * @brief Called from the profiler task after every completed window
+ *
+ * @param snapshot Fresh snapshot (only valid during the call)
+ * @param arg User argument given to task_profiler_start()
+ */
+typedef void (*task_profiler_report_cb_t)(const task_profiler_snapshot_t *snapshot, void *arg);
+
+/**
+ * @brief Start the profiler task
+ *
+ * @param report_cb Optional callback invoked after each window (may be NULL)
+ * @param arg User argument passed to report_cb
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already running
+ */
+esp_err_t task_profiler_start(task_profiler_report_cb_t report_cb, void *arg);
+
+/**
+ * @brief Copy the most recent snapshot
+ *
+ * @param snapshot Buffer to store the snapshot
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no window has completed yet
+ */
+esp_err_t task_profiler_get_snapshot(task_profiler_snapshot_t *snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TASK_PROFILER_H
@@ -0,0 +1,189 @@
+#include "task_profiler.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdlib.h>
+
+#if CONFIG_TASK_PROFILER_ENABLE
+
+static const char *TAG = "TASK_PROFILER";
+
+#define MAX_TASKS CONFIG_TASK_PROFILER_MAX_TASKS
+
+// Run time counter of every task at the start of the current window
+typedef struct {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE runtime;
+} prev_sample_t;
+
+static TaskStatus_t s_status[MAX_TASKS];
+static prev_sample_t s_prev[MAX_TASKS];
+static size_t s_prev_count = 0;
+static configRUN_TIME_COUNTER_TYPE s_prev_total = 0;
+static int64_t s_prev_time_us = 0;
+
+static task_profiler_snapshot_t s_work;
+static task_profiler_snapshot_t s_latest;
+static bool s_latest_valid = false;
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_task = NULL;
+static task_profiler_report_cb_t s_report_cb = NULL;
+static void *s_report_arg = NULL;
+
+static int compare_cpu_desc(const void *a, const void *b)
+{
+    const task_profiler_entry_t *ea = a;
+    const task_profiler_entry_t *eb = b;
+    return (int)eb->cpu_permille - (int)ea->cpu_permille;
+}
+
+static configRUN_TIME_COUNTER_TYPE prev_runtime(TaskHandle_t handle, bool *found)
+{
+    for (size_t i = 0; i < s_prev_count; i++) {
+        if (s_prev[i].handle == handle) {
+            *found = true;
+            return s_prev[i].runtime;
+        }
+    }
+    *found = false;
+    return 0;
+}
+
+// Take one sample; returns true when a full window has been computed into s_work
+static bool take_sample(void)
+{
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = uxTaskGetSystemState(s_status, MAX_TASKS, &total);
+    int64_t now_us = esp_timer_get_time();
+
+    if (count == 0) {
+        ESP_LOGW(TAG, "More than %d tasks running, increase CONFIG_TASK_PROFILER_MAX_TASKS", MAX_TASKS);
+        return false;
+    }
+
+    bool have_window = (s_prev_count > 0);
+    if (have_window) {
+        // Unsigned subtraction keeps deltas correct across one counter wrap
+        configRUN_TIME_COUNTER_TYPE window_total = total - s_prev_total;
+
+        s_work.window_ms = (uint32_t)((now_us - s_prev_time_us) / 1000);
+        s_work.task_count = count;
+        for (UBaseType_t i = 0; i < count; i++) {
+            task_profiler_entry_t *entry = &s_work.tasks[i];
+            bool found = false;
+            configRUN_TIME_COUNTER_TYPE start = prev_runtime(s_status[i].xHandle, &found);
+            configRUN_TIME_COUNTER_TYPE delta = s_status[i].ulRunTimeCounter - start;
+
+            strncpy(entry->name, s_status[i].pcTaskName, sizeof(entry->name) - 1);
+            entry->name[sizeof(entry->name) - 1] = '\0';
+            entry->priority = (uint8_t)s_status[i].uxCurrentPriority;
+            entry->stack_hwm_bytes = s_status[i].usStackHighWaterMark;
+            entry->cpu_permille = window_total ?
+                                  (uint16_t)(((uint64_t)delta * 1000) / window_total) : 0;
+            if (entry->cpu_permille > 1000) {
+                entry->cpu_permille = 1000;
+            }
+        }
+        qsort(s_work.tasks, count, sizeof(s_work.tasks[0]), compare_cpu_desc);
+    }
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        s_prev[i].handle = s_status[i].xHandle;
+        s_prev[i].runtime = s_status[i].ulRunTimeCounter;
+    }
+    s_prev_count = count;
+    s_prev_total = total;
+    s_prev_time_us = now_us;
+
+    return have_window;
+}
+
+static void profiler_task(void *pvParameters)
+{
+    take_sample();  // Establish the baseline for the first window
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_TASK_PROFILER_PERIOD_MS));
+
+        if (!take_sample()) {
+            continue;
+        }
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_work.sample_count = s_latest.sample_count + 1;
+        memcpy(&s_latest, &s_work, sizeof(s_latest));
+        s_latest_valid = true;
+        xSemaphoreGive(s_lock);
+
+        ESP_LOGD(TAG, "Window %lu ms, %u tasks, top: %s %u.%u%%",
+                 (unsigned long)s_work.window_ms, (unsigned)s_work.task_count,
+                 s_work.tasks[0].name, s_work.tasks[0].cpu_permille / 10,
+                 s_work.tasks[0].cpu_permille % 10);
+
+        if (s_report_cb) {
+            s_report_cb(&s_work, s_report_arg);
+        }
+    }
+}
+
+esp_err_t task_profiler_start(task_profiler_report_cb_t report_cb, void *arg)
+{
+    if (s_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_report_cb = report_cb;
+    s_report_arg = arg;
+
+    // Lowest non-idle priority so the profiler never perturbs what it measures
+    if (xTaskCreate(profiler_task, "task_prof", CONFIG_TASK_PROFILER_TASK_STACK_SIZE,
+                    NULL, tskIDLE_PRIORITY + 1, &s_task) != pdPASS) {
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Task profiler started (window %d ms)", CONFIG_TASK_PROFILER_PERIOD_MS);
+    return ESP_OK;
+}
+
+esp_err_t task_profiler_get_snapshot(task_profiler_snapshot_t *snapshot)
+{
+    if (snapshot == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_lock == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_latest_valid) {
+        memcpy(snapshot, &s_latest, sizeof(*snapshot));
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+#else // CONFIG_TASK_PROFILER_ENABLE
+
+esp_err_t task_profiler_start(task_profiler_report_cb_t report_cb, void *arg)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t task_profiler_get_snapshot(task_profiler_snapshot_t *snapshot)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif // CONFIG_TASK_PROFILER_ENABLE
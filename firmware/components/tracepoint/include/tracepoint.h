@@ -0,0 +1,84 @@
+#ifndef TRACEPOINT_H
+#define TRACEPOINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    TRACE_PHASE_BEGIN = 'B',
+    TRACE_PHASE_END = 'E',
+    TRACE_PHASE_INSTANT = 'i',
+} trace_phase_t;
+
+/**
+ * @brief Output callback used by the exporter
+ *
+ * @param ctx User context given to tracepoint_export_chrome()
+ * @param data Chunk of JSON text
+ * @param len Length of the chunk
+ * @return ESP_OK to continue, anything else aborts the export
+ */
+typedef esp_err_t (*trace_write_fn_t)(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief Write the trace buffer as Chrome trace JSON
+ *
+ * Recording is paused while the buffer is exported; events from that
+ * window are not recorded. Returns ESP_ERR_NOT_SUPPORTED when
+ * trace points are disabled.
+ *
+ * @param write Output callback, called with chunks of the document
+ * @param ctx User context for write
+ * @return ESP_OK on success or the first error returned by write
+ */
+esp_err_t tracepoint_export_chrome(trace_write_fn_t write, void *ctx);
+
+#if CONFIG_TRACEPOINT_ENABLE
+
+/**
+ * @brief Record one event (use the TRACE_x macros instead)
+ *
+ * @param phase Event phase
+ * @param name Event name, must have static storage
+ */
+void tracepoint_record(trace_phase_t phase, const char *name);
+
+/**
+ * @brief Drop all recorded events
+ */
+void tracepoint_clear(void);
+
+static inline void tracepoint_scope_end(const char **name)
+{
+    tracepoint_record(TRACE_PHASE_END, *name);
+}
+
+#define TRACE_BEGIN(name)   tracepoint_record(TRACE_PHASE_BEGIN, "" name "")
+#define TRACE_END(name)     tracepoint_record(TRACE_PHASE_END, "" name "")
+#define TRACE_INSTANT(name) tracepoint_record(TRACE_PHASE_INSTANT, "" name "")
+
+// Begin an event that ends automatically when the enclosing scope is left
+#define TRACE_SCOPE(name)                                                           \
+    const char *__trace_scope __attribute__((cleanup(tracepoint_scope_end), unused)) = \
+        (tracepoint_record(TRACE_PHASE_BEGIN, "" name ""), "" name "")
+
+#else // CONFIG_TRACEPOINT_ENABLE
+
+#define TRACE_BEGIN(name)   do { } while (0)
+#define TRACE_END(name)     do { } while (0)
+#define TRACE_INSTANT(name) do { } while (0)
+#define TRACE_SCOPE(name)   do { } while (0)
+
+#endif // CONFIG_TRACEPOINT_ENABLE
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACEPOINT_H
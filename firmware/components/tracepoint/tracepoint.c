@@ -0,0 +1,198 @@
+#include "tracepoint.h"
+
+#if CONFIG_TRACEPOINT_ENABLE
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_EVENTS   CONFIG_TRACEPOINT_BUFFER_EVENTS
+#define BUFFER_MASK     (BUFFER_EVENTS - 1)
+#define MAX_THREADS     32
+#define CHUNK_SIZE      512
+
+_Static_assert((BUFFER_EVENTS & BUFFER_MASK) == 0, "CONFIG_TRACEPOINT_BUFFER_EVENTS must be a power of two");
+
+typedef struct {
+    uint32_t timestamp_us;       // Low 32 bits of esp_timer_get_time(), unwrapped on export
+    const char *name;
+    TaskHandle_t task;
+    uint8_t phase;
+} trace_event_t;
+
+static trace_event_t s_events[BUFFER_EVENTS];
+static atomic_uint_least32_t s_head = 0;
+static atomic_bool s_recording = true;
+
+void tracepoint_record(trace_phase_t phase, const char *name)
+{
+    if (!atomic_load_explicit(&s_recording, memory_order_relaxed)) {
+        return;
+    }
+
+    uint32_t idx = atomic_fetch_add_explicit(&s_head, 1, memory_order_relaxed);
+    trace_event_t *ev = &s_events[idx & BUFFER_MASK];
+
+    ev->timestamp_us = (uint32_t)esp_timer_get_time();
+    ev->name = name;
+    ev->task = xTaskGetCurrentTaskHandle();
+    ev->phase = (uint8_t)phase;
+}
+
+void tracepoint_clear(void)
+{
+    atomic_store(&s_recording, false);
+    vTaskDelay(1);  // Let writers that already passed the check finish
+    atomic_store(&s_head, 0);
+    atomic_store(&s_recording, true);
+}
+
+/* Export */
+
+typedef struct {
+    trace_write_fn_t write;
+    void *ctx;
+    char buf[CHUNK_SIZE];
+    size_t len;
+    esp_err_t err;
+} chunk_writer_t;
+
+static void writer_flush(chunk_writer_t *w)
+{
+    if (w->err == ESP_OK && w->len > 0) {
+        w->err = w->write(w->ctx, w->buf, w->len);
+    }
+    w->len = 0;
+}
+
+static void writer_printf(chunk_writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void writer_printf(chunk_writer_t *w, const char *fmt, ...)
+{
+    va_list args;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_start(args, fmt);
+        int n = vsnprintf(w->buf + w->len, sizeof(w->buf) - w->len, fmt, args);
+        va_end(args);
+
+        if (n >= 0 && (size_t)n < sizeof(w->buf) - w->len) {
+            w->len += n;
+            return;
+        }
+        // Did not fit: flush what we have and retry once in an empty buffer
+        writer_flush(w);
+    }
+}
+
+static int thread_index(TaskHandle_t *threads, size_t *thread_count, TaskHandle_t task)
+{
+    for (size_t i = 0; i < *thread_count; i++) {
+        if (threads[i] == task) {
+            return i;
+        }
+    }
+    if (*thread_count < MAX_THREADS) {
+        threads[*thread_count] = task;
+        return (*thread_count)++;
+    }
+    return MAX_THREADS;  // Shared "other" lane
+}
+
+static const char *thread_name(const TaskStatus_t *status, UBaseType_t status_count, TaskHandle_t task)
+{
+    for (UBaseType_t i = 0; i < status_count; i++) {
+        if (status[i].xHandle == task) {
+            return status[i].pcTaskName;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t tracepoint_export_chrome(trace_write_fn_t write, void *ctx)
+{
+    if (write == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    chunk_writer_t *w = calloc(1, sizeof(chunk_writer_t));
+    UBaseType_t status_cap = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *status = malloc(status_cap * sizeof(TaskStatus_t));
+    if (w == NULL || status == NULL) {
+        free(w);
+        free(status);
+        return ESP_ERR_NO_MEM;
+    }
+    w->write = write;
+    w->ctx = ctx;
+
+    atomic_store(&s_recording, false);
+    vTaskDelay(1);  // Let writers that already passed the check finish
+
+    UBaseType_t status_count = uxTaskGetSystemState(status, status_cap, NULL);
+    TaskHandle_t threads[MAX_THREADS];
+    size_t thread_count = 0;
+
+    uint32_t head = atomic_load(&s_head);
+    uint32_t start = head > BUFFER_EVENTS ? head - BUFFER_EVENTS : 0;
+
+    writer_printf(w, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    uint64_t epoch = 0;
+    uint32_t prev_ts = 0;
+    bool first = true;
+    for (uint32_t idx = start; idx != head && w->err == ESP_OK; idx++) {
+        const trace_event_t *ev = &s_events[idx & BUFFER_MASK];
+
+        // 32-bit microseconds wrap every ~71 minutes; small reorderings are not wraps
+        if (!first && ev->timestamp_us < prev_ts && prev_ts - ev->timestamp_us > UINT32_MAX / 2) {
+            epoch += (uint64_t)UINT32_MAX + 1;
+        }
+        prev_ts = ev->timestamp_us;
+
+        writer_printf(w, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":%d%s}",
+                      first ? "" : ",", ev->name, ev->phase,
+                      (unsigned long long)(epoch + ev->timestamp_us),
+                      thread_index(threads, &thread_count, ev->task),
+                      ev->phase == TRACE_PHASE_INSTANT ? ",\"s\":\"t\"" : "");
+        first = false;
+    }
+
+    // Thread name metadata so lanes show task names instead of numbers
+    for (size_t i = 0; i < thread_count && w->err == ESP_OK; i++) {
+        const char *name = thread_name(status, status_count, threads[i]);
+        if (name) {
+            writer_printf(w, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                          first ? "" : ",", (int)i, name);
+        } else {
+            writer_printf(w, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"task-%d\"}}",
+                          first ? "" : ",", (int)i, (int)i);
+        }
+        first = false;
+    }
+
+    writer_printf(w, "]}");
+    writer_flush(w);
+
+    atomic_store(&s_recording, true);
+
+    esp_err_t err = w->err;
+    free(status);
+    free(w);
+    return err;
+}
+
+#else // CONFIG_TRACEPOINT_ENABLE
+
+esp_err_t tracepoint_export_chrome(trace_write_fn_t write, void *ctx)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif // CONFIG_TRACEPOINT_ENABLE
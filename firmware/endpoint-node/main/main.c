@@ -1,7 +1,10 @@
 #include <stdio.h>
 #include <string.h>
+#include <sys/param.h>
+#include <time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/event_groups.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
@@ -14,14 +17,25 @@
 #include "esp_ble_mesh_provisioning_api.h"
 #include "esp_ble_mesh_config_model_api.h"
 #include "esp_ble_mesh_generic_model_api.h"
+#include "esp_ble_mesh_low_power_api.h"
 #include "driver/gpio.h"
 #include "driver/rtc_io.h"
 #include "esp_sleep.h"
+#include "esp_attr.h"
+#include "soc/soc_caps.h"
 #include "esp_pm.h" // Added for Light Sleep Power Management
 #include "esp_timer.h"
+#include "esp_rom_sys.h"
 #include "led_strip.h"
 #include "nvs.h"
 #include "mesh_storage.h"
+#include "button.h"
+#include "battery.h"
+#include "energy_model.h"
+#include "boot_profile.h"
+#include "mesh_vendor.h"
+#include "deferred_log.h"
+#include "task_profiler.h"
 
 static const char *TAG = "ENDPOINT_NODE";
 
@@ -29,27 +43,93 @@ static const char *TAG = "ENDPOINT_NODE";
 #define LED_GPIO            GPIO_NUM_15  // Red LED onboard
 #define NEOPIXEL_GPIO       GPIO_NUM_9   // NeoPixel LED
 #define NEOPIXEL_POWER_GPIO GPIO_NUM_20  // NeoPixel power control
-#define BUTTON_GPIO         GPIO_NUM_5   // Factory reset button on GPIO5
+#define BUTTON_GPIO         GPIO_NUM_5   // Bin 0 button on GPIO5, also the factory reset button
 #define BUTTON_ACTIVE_LEVEL 0
 
-/* NeoPixel Configuration */
-#define NEOPIXEL_COUNT      1
+/* Bin Configuration */
+// Each bin has a button, a NeoPixel and a mesh element of its own; element i is bin i
+#define BIN_COUNT           1
+#define BIN_BUTTON_GPIOS    { BUTTON_GPIO }     // BIN_COUNT entries, bin 0 first
+
+_Static_assert(BIN_COUNT >= 1 && BIN_COUNT <= CONFIG_BUTTON_MAX_COUNT, "Each bin needs a button slot");
 
-/* Factory Reset Configuration */
-#define FACTORY_RESET_HOLD_TIME_MS 10000  // 10 seconds
-#define FACTORY_RESET_WARNING_1_MS 3000   // First warning at 3 seconds
-#define FACTORY_RESET_WARNING_2_MS 7000   // Second warning at 7 seconds
+/* NeoPixel Configuration */
+#define NEOPIXEL_COUNT      BIN_COUNT   // Chained on NEOPIXEL_GPIO, pixel i is bin i
 
 /* Battery Configuration */
 #define BATTERY_LOW_THRESHOLD 10  // 10% battery
-
-/* LED State */
+#define BATTERY_SAMPLE_PERIOD_MS    60000
+#define BATTERY_RADIO_QUIET_MS      200     // After our last TX or poll
+#define BATTERY_DEFER_MS            1000    // Retry while the radio or the NeoPixel is busy
+#define BATTERY_DEFER_MAX           10      // Then skip this period
+
+/* Energy Model Configuration (estimates, see components/energy_model) */
+#define ENERGY_REPORT_PERIOD_S      3600
+#define RADIO_MSG_TX_US             4000    // One PDU: 3 advertising channels, network transmit repeats
+#define RADIO_SEG_PAYLOAD           12      // Access payload per segment
+#define RADIO_POLL_RX_US            20000   // Receive window until the Friend's reply
+
+/* LED Configuration */
+#define LED_BLINK_MS            500     // Blink half period (default patterns)
+#define LED_BRIGHTNESS_DEFAULT_PCT  40  // Global NeoPixel scale until LED_BRIGHTNESS_SET changes it
+#define LED_CHANNEL_UA          12000   // WS2812 channel at full value
+#define LED_BUDGET_UA           3000    // Average the NeoPixel may draw over LED_BUDGET_WINDOW_S
+#define LED_BUDGET_WINDOW_S     600
+#define LED_BUDGET_DIM_PCT      25      // Further scale once the budget is spent
+#define NEOPIXEL_POWER_UP_US    200     // WS2812 settles after its rail comes up
+#define STATUS_LED_FLASH_MS     20      // Red LED flash, every LED_BLINK_MS while there is no gateway
+#define LED_NVS_NAMESPACE       "led_pattern"
+#define LED_NVS_KEY             "table"
+#define LED_BRIGHTNESS_NVS_KEY  "bright"
+
+/* LPN Poll Policy Configuration */
+#define LPN_NVS_NAMESPACE       "lpn_policy"
+#define LPN_NVS_KEY             "cfg"
+#define LPN_FAST_POLL_MS        1000    // Default poll interval after a press or indication
+#define LPN_ACTIVE_S            30      // Default fast polling time after the last one
+#define LPN_FAST_POLL_MIN_MS    250     // Leaves room for the receive delay and window
+#define LPN_REPORT_PERIOD_S     900     // LPN_STATUS period
+// The stack polls on its own just under the poll timeout; the policy only adds faster polls
+#define LPN_STACK_POLL_MS       (CONFIG_BLE_MESH_LPN_POLL_TIMEOUT * 100)
+
+/* Press Queue Configuration */
+#define PRESS_NVS_NAMESPACE     "press_queue"
+#define PRESS_NVS_KEY           "q"
+#define PRESS_SEQ_NVS_KEY       "seq"
+#define PRESS_SEQ_BLOCK         16      // Sequence numbers reserved per NVS write
+#define PRESS_QUEUE_LEN         8       // Oldest press dropped when full
+
+/* Application Events (handled by app_task) */
 typedef enum {
-    LED_STATE_LOCATION_INDICATOR,  // Green solid - showing storage location
-    LED_STATE_BATTERY_LOW,          // Red blinking - battery < 10%
-    LED_STATE_NO_GATEWAY,           // Blue blinking - no gateway connection
-    LED_STATE_OTHER                 // Yellow blinking - other states
-} led_state_t;
+    APP_EVT_BUTTON,         // Button event from the button component
+    APP_EVT_LED_UPDATE,     // Inputs of the LED state changed
+    APP_EVT_LED_TICK,       // NeoPixel pattern timer expired
+    APP_EVT_LED_BUDGET,     // NeoPixel budget ran out or refilled
+    APP_EVT_LED_PATTERN_SET,        // LED_PATTERN_SET vendor message
+    APP_EVT_LED_PATTERN_TRIGGER,    // LED_PATTERN_TRIGGER vendor message
+    APP_EVT_LED_BRIGHTNESS_SET,     // LED_BRIGHTNESS_SET vendor message
+    APP_EVT_INDICATE,       // INDICATE vendor message
+    APP_EVT_INDICATE_END,   // Indication duration elapsed
+    APP_EVT_RESET,          // RESET vendor message
+    APP_EVT_LPN_FRIENDSHIP, // Friendship established or terminated
+    APP_EVT_LPN_POLL,       // Poll policy timer expired
+    APP_EVT_LPN_POLL_SET,   // LPN_POLL_SET vendor message
+    APP_EVT_LPN_REPORT,     // LPN_STATUS report due
+    APP_EVT_BATTERY,        // Battery sample due
+    APP_EVT_ENERGY_REPORT,  // ENERGY_STATUS report due
+    APP_EVT_DEEP_SLEEP,     // Idle long enough for deep sleep
+} app_evt_type_t;
+
+typedef struct {
+    app_evt_type_t type;
+    uint8_t bin;            // Bin the event is for: button, LED tick, vendor command
+    union {
+        button_evt_t button;
+        uint32_t led_gen;   // Pattern generation the tick was armed for
+        bool friendship;    // APP_EVT_LPN_FRIENDSHIP: established
+        uint8_t vnd_msg[MESH_VND_UNSEG_MAX_LEN];   // Vendor message payload
+    };
+} app_evt_t;
 
 /* Bluetooth Mesh Configuration */
 #define CID_ESP             0x02E5
@@ -59,13 +139,8 @@ typedef enum {
 #define NODE_ADDRESS        0x0000  // Will be set during provisioning
 
 /* Deep Sleep Configuration */
-#define DEEP_SLEEP_TIMEOUT_MS   300000  // 5 minutes after last activity (for testing/configuration)
-#define BUTTON_WAKEUP_LEVEL     0       // Wake on button press (LOW)
-
-/* Factory Reset Configuration */
-#define FACTORY_RESET_HOLD_TIME_MS  10000  // Hold button for 10 seconds to factory reset
-#define FACTORY_RESET_WARNING_TIME_MS 3000  // Warning at 3 seconds
-#define FACTORY_RESET_CRITICAL_TIME_MS 7000 // Critical warning at 7 seconds
+#define DEEP_SLEEP_IDLE_S       (8 * 3600)  // No press, indication or location request this long
+#define DEEP_SLEEP_CLEAR_MS     200         // Friend Clear on air before the radio goes down
 
 // Device UUID - "ESP BLE Mesh Endpoint" in ASCII
 static uint8_t dev_uuid[16] = {
@@ -88,7 +163,8 @@ static esp_ble_mesh_gen_onoff_srv_t onoff_server = {
 // Publication context for Generic OnOff Server
 ESP_BLE_MESH_MODEL_PUB_DEFINE(onoff_pub, 2 + 3, ROLE_NODE);
 
-// Generic OnOff Client for sending button press messages
+// Generic OnOff Client: presses now go out as vendor PRESS_REPORT, the model
+// stays so the composition of provisioned nodes does not change
 static esp_ble_mesh_client_t onoff_client;
 
 static esp_ble_mesh_model_t root_models[] = {
@@ -97,10 +173,30 @@ static esp_ble_mesh_model_t root_models[] = {
     ESP_BLE_MESH_MODEL_GEN_ONOFF_CLI(NULL, &onoff_client),
 };
 
-static esp_ble_mesh_elem_t elements[] = {
-    ESP_BLE_MESH_ELEMENT(0, root_models, ESP_BLE_MESH_MODEL_NONE),
+// Vendor server: receives indications, LED patterns and brightness, resets and the poll policy, sends press, poll and diagnostic reports
+static esp_ble_mesh_model_op_t vnd_op[] = {
+    ESP_BLE_MESH_MODEL_OP(MESH_VND_OP_LED_PATTERN_SET, MESH_VND_LED_PATTERN_SET_LEN),
+    ESP_BLE_MESH_MODEL_OP(MESH_VND_OP_LED_PATTERN_TRIGGER, MESH_VND_LED_PATTERN_TRIGGER_LEN),
+    ESP_BLE_MESH_MODEL_OP(MESH_VND_OP_LED_BRIGHTNESS_SET, MESH_VND_LED_BRIGHTNESS_SET_LEN),
+    ESP_BLE_MESH_MODEL_OP(MESH_VND_OP_INDICATE, MESH_VND_INDICATE_LEN),
+    ESP_BLE_MESH_MODEL_OP(MESH_VND_OP_RESET, MESH_VND_RESET_LEN),
+    ESP_BLE_MESH_MODEL_OP(MESH_VND_OP_LPN_POLL_SET, MESH_VND_LPN_POLL_SET_LEN),
+    ESP_BLE_MESH_MODEL_OP_END,
 };
 
+// Publication context for the vendor server: its address is where reports go
+ESP_BLE_MESH_MODEL_PUB_DEFINE(vnd_pub, 3 + MESH_VND_UNSEG_MAX_LEN, ROLE_NODE);
+
+/*
+ * One element per bin, each with a vendor server; the SIG models live on the
+ * primary element only. The gateway addresses bin i at the node's unicast
+ * address + i, and a press report's source tells it which bin was pressed,
+ * so the vendor protocol itself knows nothing about bins. Filled in by
+ * composition_init() before the stack starts.
+ */
+static esp_ble_mesh_model_t vnd_models[BIN_COUNT];
+static esp_ble_mesh_elem_t elements[BIN_COUNT];
+
 static esp_ble_mesh_comp_t composition = {
     .cid = CID_ESP,
     .elements = elements,
@@ -116,25 +212,126 @@ static esp_ble_mesh_prov_t provision = {
     .input_actions = 0,
 };
 
-static esp_timer_handle_t sleep_timer;
+static esp_timer_handle_t sleep_timer = NULL;
 static uint16_t node_addr = 0;
+static mesh_pub_settings_t report_pub;  // Vendor server publication, reports go here
+static uint16_t gateway_addr = ESP_BLE_MESH_ADDR_UNASSIGNED;   // Source of the last vendor command
 static led_strip_handle_t led_strip;
-static led_state_t current_led_state = LED_STATE_OTHER;
 static bool provisioned = false;
+static bool rtc_resumed = false;        // Woken from deep sleep, state restored from RTC memory
 static bool gateway_connected = false;
 static uint8_t battery_percent = 100;
+static bool battery_adc = false;        // Measured, otherwise a mock drain
+static int64_t radio_quiet_at_us = 0;   // No TX or poll of ours in flight after this
+static uint8_t neopixel_rgb[NEOPIXEL_COUNT][3];    // Colors written, after scaling
+static uint8_t led_brightness_pct = LED_BRIGHTNESS_DEFAULT_PCT;
+static uint32_t neopixel_lit = 0;       // Bit per pixel showing a color
+static bool neopixel_powered = false;
+static uint32_t neopixel_ua = 0;        // Channel current being drawn by the strip
+static int64_t led_budget_uams = 0;     // Budget left, uA*ms
+static int64_t led_budget_at_us = 0;    // Accounted up to
+static bool led_budget_dimmed = false;
+static esp_timer_handle_t led_budget_timer = NULL;
 static bool location_indicator_active = false;
+static QueueHandle_t app_queue = NULL;
+static esp_timer_handle_t status_led_timer = NULL;
+static esp_timer_handle_t battery_timer = NULL;
+
+/* LPN Poll Policy State (app_task only) */
+typedef struct {
+    uint16_t fast_ms;       // Poll interval after a press or indication
+    uint16_t active_s;      // Fast polling time after the last one
+    uint16_t idle_s;        // Interval the backoff stops at, 0 = the stack's own
+} lpn_policy_t;
+
+_Static_assert(sizeof(lpn_policy_t) == MESH_VND_LPN_POLL_SET_LEN, "LPN_POLL_SET payload is an lpn_policy_t");
+
+#define LPN_POLICY_DEFAULT  { .fast_ms = LPN_FAST_POLL_MS, .active_s = LPN_ACTIVE_S, .idle_s = 0 }
+
+static lpn_policy_t lpn_policy = LPN_POLICY_DEFAULT;
+
+static esp_timer_handle_t lpn_poll_timer = NULL;
+static esp_timer_handle_t lpn_report_timer = NULL;
+static bool lpn_friend = false;
+static uint32_t lpn_interval_ms = 0;    // Policy poll interval, 0 while the stack polls alone
+static int64_t lpn_active_until_us = 0;
+static int64_t lpn_stack_since_us = 0;  // Stack polling alone since, 0 if not
+
+// Statistics since the last LPN_STATUS
+static struct {
+    int64_t since_us;
+    int64_t active_us;      // Active windows, counted in full when they start
+    uint32_t polls;
+    uint32_t indications;
+    uint64_t wait_ms;       // Sum of the poll interval at each indication
+} lpn_stats;
 
 /* Forward Declarations */
 static void reset_sleep_timer(void);
+static void report_ctx(esp_ble_mesh_msg_ctx_t *ctx);
+static void press_queue_flush(void);
 
 /* NeoPixel Control Functions */
+/*
+ * One pixel per bin, chained on NEOPIXEL_GPIO. The rail is only powered
+ * while a pixel shows a color: a dark WS2812 still draws about 1 mA. Every
+ * color is scaled by led_brightness_pct, set by LED_BRIGHTNESS_SET and kept
+ * with the installed patterns in NVS, and the channel current of the
+ * strip is charged against a budget of LED_BUDGET_UA per pixel averaged
+ * over LED_BUDGET_WINDOW_S. Once it is spent, indications dim to
+ * LED_BUDGET_DIM_PCT until half of it has come back: a bin left lit for
+ * hours stays visible without draining the cell.
+ */
+#define LED_BUDGET_TOTAL_UA ((int64_t)LED_BUDGET_UA * NEOPIXEL_COUNT)
+#define LED_BUDGET_UAMS     (LED_BUDGET_TOTAL_UA * LED_BUDGET_WINDOW_S * 1000)
+
+static void led_budget_timer_cb(void *arg)
+{
+    app_evt_t evt = {
+        .type = APP_EVT_LED_BUDGET,
+    };
+    xQueueSend(app_queue, &evt, 0);
+}
+
+// Charge the current drawn since the last call; the budget refills at LED_BUDGET_TOTAL_UA
+static void led_budget_account(void)
+{
+    int64_t elapsed_ms = (esp_timer_get_time() - led_budget_at_us) / 1000;
+    led_budget_at_us += elapsed_ms * 1000;
+    led_budget_uams += elapsed_ms * (LED_BUDGET_TOTAL_UA - neopixel_ua);
+    led_budget_uams = MAX(0, MIN(led_budget_uams, LED_BUDGET_UAMS));
+
+    if (!led_budget_dimmed && led_budget_uams == 0) {
+        led_budget_dimmed = true;
+        ESP_LOGW(TAG, "LED budget spent, dimming to %d%%", LED_BUDGET_DIM_PCT);
+    } else if (led_budget_dimmed && led_budget_uams >= LED_BUDGET_UAMS / 2) {
+        led_budget_dimmed = false;
+        ESP_LOGI(TAG, "LED budget restored");
+    }
+}
+
+// Wake app_task when the colors being shown would change the dimming
+static void led_budget_arm(void)
+{
+    esp_timer_stop(led_budget_timer);
+
+    int64_t ms = 0;
+    if (!led_budget_dimmed && neopixel_ua > LED_BUDGET_TOTAL_UA) {
+        ms = led_budget_uams / (neopixel_ua - LED_BUDGET_TOTAL_UA);
+    } else if (led_budget_dimmed && neopixel_ua < LED_BUDGET_TOTAL_UA) {
+        ms = (LED_BUDGET_UAMS / 2 - led_budget_uams) / (LED_BUDGET_TOTAL_UA - neopixel_ua);
+    } else {
+        return;
+    }
+    esp_timer_start_once(led_budget_timer, (ms + 1) * 1000);
+}
+
 static void neopixel_init(void)
 {
-    // Enable NeoPixel power
+    // Rail off until there is something to show
     gpio_reset_pin(NEOPIXEL_POWER_GPIO);
     gpio_set_direction(NEOPIXEL_POWER_GPIO, GPIO_MODE_OUTPUT);
-    gpio_set_level(NEOPIXEL_POWER_GPIO, 1);
+    gpio_set_level(NEOPIXEL_POWER_GPIO, 0);
 
     // Configure NeoPixel LED strip
     led_strip_config_t strip_config = {
@@ -145,179 +342,1503 @@ static void neopixel_init(void)
         .flags.invert_out = false,
     };
 
-    led_strip_rmt_config_t rmt_config = {
-        .clk_src = RMT_CLK_SRC_DEFAULT,
-        .resolution_hz = 10 * 1000 * 1000, // 10MHz
-        .flags.with_dma = false,
+    led_strip_rmt_config_t rmt_config = {
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = 10 * 1000 * 1000, // 10MHz
+        .flags.with_dma = false,
+    };
+
+    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip));
+
+    const esp_timer_create_args_t budget_args = {
+        .callback = led_budget_timer_cb,
+        .name = "led_budget",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&budget_args, &led_budget_timer));
+    led_budget_uams = LED_BUDGET_UAMS;
+    led_budget_at_us = esp_timer_get_time();
+}
+
+// Write every pixel; the rail goes down with the last lit one
+static void neopixel_show(void)
+{
+    uint32_t channel_sum = 0;
+    for (int i = 0; i < NEOPIXEL_COUNT; i++) {
+        channel_sum += neopixel_rgb[i][0] + neopixel_rgb[i][1] + neopixel_rgb[i][2];
+    }
+    neopixel_ua = channel_sum * LED_CHANNEL_UA / 255;
+
+    if (neopixel_lit == 0) {
+        esp_timer_stop(led_budget_timer);
+        if (neopixel_powered) {
+            led_strip_clear(led_strip);
+            gpio_set_level(NEOPIXEL_POWER_GPIO, 0);
+            neopixel_powered = false;
+        }
+        energy_model_set_load(ENERGY_LOAD_RGB_LED, false);
+        return;
+    }
+
+    if (!neopixel_powered) {
+        gpio_set_level(NEOPIXEL_POWER_GPIO, 1);
+        esp_rom_delay_us(NEOPIXEL_POWER_UP_US);
+        neopixel_powered = true;
+    }
+    for (int i = 0; i < NEOPIXEL_COUNT; i++) {
+        led_strip_set_pixel(led_strip, i, neopixel_rgb[i][0], neopixel_rgb[i][1], neopixel_rgb[i][2]);
+    }
+    led_strip_refresh(led_strip);
+    energy_model_set_strip(NEOPIXEL_COUNT, channel_sum);
+    led_budget_arm();
+}
+
+static void neopixel_off(int pixel)
+{
+    led_budget_account();
+    neopixel_rgb[pixel][0] = neopixel_rgb[pixel][1] = neopixel_rgb[pixel][2] = 0;
+    neopixel_lit &= ~(1U << pixel);
+    neopixel_show();
+}
+
+static void neopixel_set_color(int pixel, uint8_t red, uint8_t green, uint8_t blue)
+{
+    led_budget_account();
+    uint32_t scale = led_brightness_pct * (led_budget_dimmed ? LED_BUDGET_DIM_PCT : 100);
+    neopixel_rgb[pixel][0] = red * scale / 10000;
+    neopixel_rgb[pixel][1] = green * scale / 10000;
+    neopixel_rgb[pixel][2] = blue * scale / 10000;
+    if (neopixel_rgb[pixel][0] || neopixel_rgb[pixel][1] || neopixel_rgb[pixel][2]) {
+        neopixel_lit |= 1U << pixel;
+    } else {
+        neopixel_lit &= ~(1U << pixel);
+    }
+    neopixel_show();
+}
+
+/* Battery Monitoring */
+/*
+ * The battery component measures through the ADC. Boards without the
+ * divider keep the mock drain of 1 % per sample. The level is not sent on
+ * its own: it rides on PRESS_REPORT and LPN_STATUS.
+ */
+static void led_request_update(void);
+
+static void battery_timer_cb(void *arg)
+{
+    app_evt_t evt = {
+        .type = APP_EVT_BATTERY,
+    };
+    xQueueSend(app_queue, &evt, 0);
+}
+
+// Call after each mesh send or poll, with its estimated radio time
+static void radio_used(uint32_t tx_us, uint32_t rx_us)
+{
+    radio_quiet_at_us = esp_timer_get_time() + BATTERY_RADIO_QUIET_MS * 1000;
+    energy_model_add(ENERGY_STATE_RADIO_TX, tx_us);
+    energy_model_add(ENERGY_STATE_RADIO_RX, rx_us);
+}
+
+static void battery_measure(void)
+{
+    static int deferred = 0;
+
+    // TX current and the NeoPixel pull the cell voltage down while they run
+    if (esp_timer_get_time() < radio_quiet_at_us || neopixel_lit) {
+        if (++deferred <= BATTERY_DEFER_MAX) {
+            esp_timer_start_once(battery_timer, BATTERY_DEFER_MS * 1000ULL);
+            return;
+        }
+        deferred = 0;
+        esp_timer_start_once(battery_timer, BATTERY_SAMPLE_PERIOD_MS * 1000ULL);
+        return;
+    }
+    deferred = 0;
+    esp_timer_start_once(battery_timer, BATTERY_SAMPLE_PERIOD_MS * 1000ULL);
+
+    uint8_t percent = battery_percent;
+    if (battery_adc) {
+        esp_err_t err = battery_sample(&percent);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Battery sample failed: %s", esp_err_to_name(err));
+            return;
+        }
+    } else if (percent > 0) {
+        percent--;
+    }
+
+    if (percent != battery_percent) {
+        battery_percent = percent;
+        ESP_LOGI(TAG, "Battery: %d%% (%d mV)", battery_percent, battery_voltage_mv());
+        led_request_update();
+    }
+}
+
+static void battery_monitor_init(void)
+{
+    esp_err_t err = battery_init();
+    battery_adc = err == ESP_OK;
+    if (!battery_adc) {
+        ESP_LOGW(TAG, "Battery ADC unavailable (%s), using the mock level", esp_err_to_name(err));
+    }
+
+    const esp_timer_create_args_t battery_args = {
+        .callback = battery_timer_cb,
+        .name = "battery",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&battery_args, &battery_timer));
+    esp_timer_start_once(battery_timer, BATTERY_DEFER_MS * 1000ULL);
+}
+
+/* Red LED Control Functions */
+static void led_init(void)
+{
+    gpio_reset_pin(LED_GPIO);
+    gpio_set_direction(LED_GPIO, GPIO_MODE_OUTPUT);
+    gpio_set_level(LED_GPIO, 0);
+}
+
+static void led_on(void)
+{
+    gpio_set_level(LED_GPIO, 1);
+    energy_model_set_load(ENERGY_LOAD_STATUS_LED, true);
+}
+
+static void led_off(void)
+{
+    gpio_set_level(LED_GPIO, 0);
+    energy_model_set_load(ENERGY_LOAD_STATUS_LED, false);
+}
+
+
+/* LED Engine */
+/*
+ * Everything below except the timer callbacks runs in app_task. Each bin
+ * runs its own engine on its own pixel: per pattern ID, a pattern is either
+ * active or not, and the active pattern with the highest priority (lowest
+ * ID on a tie) is shown. The endpoint starts and stops its built-in
+ * patterns from its state, on bin 0 only since that state is the node's;
+ * the gateway installs patterns node-wide and triggers them per bin with
+ * vendor messages.
+ *
+ * A pixel is only written when its shown pattern changes phase: a solid
+ * pattern arms no timer, a blinking one arms a one-shot per phase. A tick
+ * already queued when the pattern changes carries an old generation and is
+ * dropped. A connected node with nothing to show runs no LED timer at all.
+ */
+
+// Same layout as LED_PATTERN_SET bytes 1..7, stored as is in NVS
+typedef struct {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint8_t on_units;       // MESH_VND_LED_TIME_UNIT_MS units, 0 = no pattern
+    uint8_t off_units;      // 0 = solid
+    uint8_t repeat;         // On/off cycles, 0 = until stopped
+    uint8_t priority;
+} led_pattern_t;
+
+_Static_assert(sizeof(led_pattern_t) == MESH_VND_LED_PATTERN_SET_LEN - 1, "led_pattern_t must match the message");
+_Static_assert(MESH_VND_LED_PATTERN_QUANTITY == MESH_VND_LED_PATTERN_INDICATE + 1, "Indication patterns must be adjacent");
+
+#define LED_UNITS(ms)       ((ms) / MESH_VND_LED_TIME_UNIT_MS)
+#define LED_BIT(id)         (1U << (id))
+
+static led_pattern_t led_patterns[MESH_VND_LED_PATTERN_MAX] = {
+    [MESH_VND_LED_PATTERN_LOCATION]    = { 0, 255, 0, 1, 0, 0, 3 },
+    [MESH_VND_LED_PATTERN_BATTERY_LOW] = { 255, 0, 0, LED_UNITS(LED_BLINK_MS), LED_UNITS(LED_BLINK_MS), 0, 2 },
+    [MESH_VND_LED_PATTERN_NO_GATEWAY]  = { 0, 0, 255, LED_UNITS(LED_BLINK_MS), LED_UNITS(LED_BLINK_MS), 0, 1 },
+    // A heartbeat blip, only when the gateway triggers it
+    [MESH_VND_LED_PATTERN_IDLE]        = { 255, 255, 0, 1, LED_UNITS(3000), 0, 0 },
+    // Color and timing set by each INDICATE
+    [MESH_VND_LED_PATTERN_INDICATE]    = { 255, 255, 255, 1, 0, 0, 4 },
+    [MESH_VND_LED_PATTERN_QUANTITY]    = { 255, 255, 255, LED_UNITS(200), LED_UNITS(200), 0, 5 },
+};
+
+// Engine state of one bin (app_task only)
+typedef struct {
+    esp_timer_handle_t led_timer;
+    esp_timer_handle_t indicate_timer;
+    uint32_t led_gen;
+    bool led_phase_on;
+    int led_current;            // Pattern shown, -1 for none
+    uint16_t led_active;        // Bit per pattern ID
+    uint16_t led_conditions;    // Built-in patterns whose condition holds
+    uint8_t led_cycles_left[MESH_VND_LED_PATTERN_MAX];
+    led_pattern_t indication[2];    // INDICATE and QUANTITY as the last INDICATE to this bin set them
+} bin_t;
+
+static bin_t bins[BIN_COUNT];
+
+// The bin's own copy for the indication patterns, the shared table otherwise
+static const led_pattern_t *led_pattern(const bin_t *b, int id)
+{
+    if (id == MESH_VND_LED_PATTERN_INDICATE || id == MESH_VND_LED_PATTERN_QUANTITY) {
+        return &b->indication[id - MESH_VND_LED_PATTERN_INDICATE];
+    }
+    return &led_patterns[id];
+}
+
+static void led_timer_cb(void *arg)
+{
+    uint8_t bin = (uint8_t)(intptr_t)arg;
+    app_evt_t evt = {
+        .type = APP_EVT_LED_TICK,
+        .bin = bin,
+        .led_gen = bins[bin].led_gen,
+    };
+    xQueueSend(app_queue, &evt, 0);
+}
+
+// Red LED: a short flash per LED_BLINK_MS while there is no gateway, straight from the timer task
+static void status_led_timer_cb(void *arg)
+{
+    static bool lit = false;
+
+    lit = !lit && !gateway_connected;
+    if (lit) {
+        led_on();
+        esp_timer_start_once(status_led_timer, STATUS_LED_FLASH_MS * 1000);
+    } else {
+        led_off();
+        if (!gateway_connected) {
+            esp_timer_start_once(status_led_timer, (LED_BLINK_MS - STATUS_LED_FLASH_MS) * 1000);
+        }
+    }
+}
+
+// Ask app_task to re-evaluate the LED state; callable from any task
+static void led_request_update(void)
+{
+    app_evt_t evt = {
+        .type = APP_EVT_LED_UPDATE,
+    };
+    xQueueSend(app_queue, &evt, 0);
+}
+
+static void led_arm_timer(uint8_t bin)
+{
+    bin_t *b = &bins[bin];
+    const led_pattern_t *pattern = led_pattern(b, b->led_current);
+
+    if (pattern->off_units == 0 && pattern->repeat == 0) {
+        return;     // Solid until stopped: nothing to time
+    }
+    uint8_t units = b->led_phase_on ? pattern->on_units : pattern->off_units;
+    esp_timer_start_once(b->led_timer, (uint64_t)units * MESH_VND_LED_TIME_UNIT_MS * 1000);
+}
+
+static void led_write_phase(uint8_t bin)
+{
+    bin_t *b = &bins[bin];
+    const led_pattern_t *pattern = led_pattern(b, b->led_current);
+
+    if (b->led_phase_on) {
+        neopixel_set_color(bin, pattern->red, pattern->green, pattern->blue);
+    } else {
+        neopixel_off(bin);
+    }
+}
+
+static void led_set_active(uint8_t bin, uint8_t id, bool active)
+{
+    bin_t *b = &bins[bin];
+    if (active) {
+        b->led_active |= LED_BIT(id);
+        b->led_cycles_left[id] = led_pattern(b, id)->repeat;
+    } else {
+        b->led_active &= ~LED_BIT(id);
+    }
+}
+
+// Show the bin's winning pattern; restart also restarts it if it is already shown
+static void led_select(uint8_t bin, bool restart)
+{
+    bin_t *b = &bins[bin];
+    int best = -1;
+    for (int id = 0; id < MESH_VND_LED_PATTERN_MAX; id++) {
+        if (!(b->led_active & LED_BIT(id)) || led_pattern(b, id)->on_units == 0) {
+            continue;
+        }
+        if (best < 0 || led_pattern(b, id)->priority > led_pattern(b, best)->priority) {
+            best = id;
+        }
+    }
+
+    if (best == b->led_current && !restart) {
+        return;
+    }
+    b->led_current = best;
+
+    esp_timer_stop(b->led_timer);
+    b->led_gen++;
+    if (best < 0) {
+        neopixel_off(bin);
+        return;
+    }
+    b->led_phase_on = true;
+    led_write_phase(bin);
+    led_arm_timer(bin);
+}
+
+static void led_update(void)
+{
+    // Red LED flashes while there is no gateway, and stops by itself once there is one
+    if (!gateway_connected && !esp_timer_is_active(status_led_timer)) {
+        esp_timer_start_once(status_led_timer, 0);
+    }
+
+    // Built-in patterns start when their condition becomes true; they are the node's, shown on bin 0
+    uint16_t conditions = 0;
+    if (location_indicator_active) {
+        conditions |= LED_BIT(MESH_VND_LED_PATTERN_LOCATION);
+    }
+    if (battery_percent < BATTERY_LOW_THRESHOLD) {
+        conditions |= LED_BIT(MESH_VND_LED_PATTERN_BATTERY_LOW);
+    }
+    if (!gateway_connected) {
+        conditions |= LED_BIT(MESH_VND_LED_PATTERN_NO_GATEWAY);
+    }
+
+    bin_t *b = &bins[0];
+    uint16_t changed = conditions ^ b->led_conditions;
+    b->led_conditions = conditions;
+    for (uint8_t id = 0; id < MESH_VND_LED_PATTERN_USER; id++) {
+        if (changed & LED_BIT(id)) {
+            led_set_active(0, id, conditions & LED_BIT(id));
+        }
+    }
+
+    led_select(0, false);
+}
+
+static void led_tick(uint8_t bin, uint32_t gen)
+{
+    bin_t *b = &bins[bin];
+    if (gen != b->led_gen || b->led_current < 0) {
+        return;
+    }
+
+    const led_pattern_t *pattern = led_pattern(b, b->led_current);
+    bool solid = pattern->off_units == 0;
+
+    // A cycle ends with the off phase, or with each on period when solid
+    if ((solid || !b->led_phase_on) && pattern->repeat > 0 && --b->led_cycles_left[b->led_current] == 0) {
+        led_set_active(bin, b->led_current, false);
+        led_select(bin, false);
+        return;
+    }
+
+    if (!solid) {
+        b->led_phase_on = !b->led_phase_on;
+        led_write_phase(bin);
+    }
+    led_arm_timer(bin);
+}
+
+static void led_patterns_load(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(LED_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;     // Nothing installed yet
+    }
+
+    led_pattern_t stored[MESH_VND_LED_PATTERN_MAX];
+    size_t len = sizeof(stored);
+    if (nvs_get_blob(handle, LED_NVS_KEY, stored, &len) == ESP_OK && len == sizeof(stored)) {
+        memcpy(led_patterns, stored, sizeof(led_patterns));
+        ESP_LOGI(TAG, "LED patterns loaded from NVS");
+    }
+    uint8_t pct;
+    if (nvs_get_u8(handle, LED_BRIGHTNESS_NVS_KEY, &pct) == ESP_OK &&
+        pct >= MESH_VND_LED_BRIGHTNESS_MIN && pct <= MESH_VND_LED_BRIGHTNESS_MAX) {
+        led_brightness_pct = pct;
+    }
+    nvs_close(handle);
+}
+
+static void led_patterns_save(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(LED_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, LED_NVS_KEY, led_patterns, sizeof(led_patterns));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save LED patterns: %s", esp_err_to_name(err));
+    }
+}
+
+// Node-wide like the patterns; what is lit is redrawn at the new level, nothing restarts
+static void led_brightness_set(uint8_t pct)
+{
+    if (pct < MESH_VND_LED_BRIGHTNESS_MIN || pct > MESH_VND_LED_BRIGHTNESS_MAX) {
+        ESP_LOGW(TAG, "LED brightness %d%% out of range", pct);
+        return;
+    }
+
+    led_brightness_pct = pct;
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(LED_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_u8(handle, LED_BRIGHTNESS_NVS_KEY, pct);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save LED brightness: %s", esp_err_to_name(err));
+    }
+    ESP_LOGI(TAG, "LED brightness %d%%", pct);
+
+    for (uint8_t bin = 0; bin < BIN_COUNT; bin++) {
+        if (bins[bin].led_current >= 0 && bins[bin].led_phase_on) {
+            led_write_phase(bin);
+        }
+    }
+}
+
+// The built-in table and brightness come back at the next boot
+static void led_patterns_erase(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(LED_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_erase_all(handle);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to erase LED patterns: %s", esp_err_to_name(err));
+    }
+}
+
+// Patterns are node-wide, whichever element the message came to; indications pick up a restyle at the next INDICATE
+static void led_pattern_install(const uint8_t *msg)
+{
+    uint8_t id = msg[0];
+    if (id >= MESH_VND_LED_PATTERN_MAX) {
+        ESP_LOGW(TAG, "LED pattern %d out of range", id);
+        return;
+    }
+
+    led_pattern_t *pattern = &led_patterns[id];
+    memcpy(pattern, &msg[1], sizeof(*pattern));
+    led_patterns_save();
+
+    ESP_LOGI(TAG, "LED pattern %d installed: #%02x%02x%02x on %d ms off %d ms repeat %d priority %d",
+             id, pattern->red, pattern->green, pattern->blue,
+             pattern->on_units * MESH_VND_LED_TIME_UNIT_MS, pattern->off_units * MESH_VND_LED_TIME_UNIT_MS,
+             pattern->repeat, pattern->priority);
+
+    // Redraw where it is the one shown, or where it now wins or loses
+    for (uint8_t bin = 0; bin < BIN_COUNT; bin++) {
+        bins[bin].led_cycles_left[id] = led_pattern(&bins[bin], id)->repeat;
+        led_select(bin, id == bins[bin].led_current);
+    }
+}
+
+static void led_pattern_trigger(uint8_t bin, uint8_t id, bool start)
+{
+    if (id >= MESH_VND_LED_PATTERN_MAX) {
+        ESP_LOGW(TAG, "LED pattern %d out of range", id);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Bin %d LED pattern %d %s", bin, id, start ? "started" : "stopped");
+    led_set_active(bin, id, start);
+    led_select(bin, start && id == bins[bin].led_current);
+}
+
+static void indicate_timer_cb(void *arg)
+{
+    app_evt_t evt = {
+        .type = APP_EVT_INDICATE_END,
+        .bin = (uint8_t)(intptr_t)arg,
+    };
+    xQueueSend(app_queue, &evt, 0);
+}
+
+static bool indication_active(uint8_t bin)
+{
+    return bins[bin].led_active & (LED_BIT(MESH_VND_LED_PATTERN_INDICATE) | LED_BIT(MESH_VND_LED_PATTERN_QUANTITY));
+}
+
+static void indicate_end(uint8_t bin)
+{
+    esp_timer_stop(bins[bin].indicate_timer);
+    led_set_active(bin, MESH_VND_LED_PATTERN_INDICATE, false);
+    led_set_active(bin, MESH_VND_LED_PATTERN_QUANTITY, false);
+    led_select(bin, false);
+}
+
+static void indicate(uint8_t bin, const uint8_t *msg)
+{
+    bin_t *b = &bins[bin];
+    uint16_t duration_s = msg[4] | (msg[5] << 8);
+    uint8_t quantity = msg[6] > MESH_VND_INDICATE_QUANTITY_MAX ? MESH_VND_INDICATE_QUANTITY_MAX : msg[6];
+
+    if (msg[0] == 0 && msg[1] == 0 && msg[2] == 0) {
+        ESP_LOGI(TAG, "Bin %d indication cleared", bin);
+        indicate_end(bin);
+        return;
+    }
+
+    // Priority and quantity timing come from the shared table, the rest from the message
+    led_pattern_t *pattern = &b->indication[0];
+    *pattern = led_patterns[MESH_VND_LED_PATTERN_INDICATE];
+    memcpy(pattern, msg, 3);
+    switch (msg[3]) {
+    case MESH_VND_INDICATE_BLINK:
+        pattern->on_units = pattern->off_units = LED_UNITS(LED_BLINK_MS);
+        break;
+    case MESH_VND_INDICATE_FAST_BLINK:
+        pattern->on_units = pattern->off_units = LED_UNITS(150);
+        break;
+    default:
+        pattern->on_units = 1;
+        pattern->off_units = 0;
+        break;
+    }
+    pattern->repeat = 0;
+
+    // Quantity blinks in the same color, then the indication itself
+    led_pattern_t *count = &b->indication[1];
+    *count = led_patterns[MESH_VND_LED_PATTERN_QUANTITY];
+    memcpy(count, msg, 3);
+    count->repeat = quantity;
+
+    ESP_LOGI(TAG, "Bin %d indicate #%02x%02x%02x pattern %d for %d s, quantity %d",
+             bin, msg[0], msg[1], msg[2], msg[3], duration_s, quantity);
+
+    esp_timer_stop(b->indicate_timer);
+    if (duration_s > 0) {
+        esp_timer_start_once(b->indicate_timer, (uint64_t)duration_s * 1000000);
+    }
+    led_set_active(bin, MESH_VND_LED_PATTERN_INDICATE, true);
+    led_set_active(bin, MESH_VND_LED_PATTERN_QUANTITY, quantity > 0);
+    led_select(bin, true);
+}
+
+static void led_engine_init(void)
+{
+    if (!rtc_resumed) {
+        led_patterns_load();
+    }
+
+    for (uint8_t bin = 0; bin < BIN_COUNT; bin++) {
+        bin_t *b = &bins[bin];
+        b->led_current = -1;
+        memcpy(b->indication, &led_patterns[MESH_VND_LED_PATTERN_INDICATE], sizeof(b->indication));
+
+        const esp_timer_create_args_t led_args = {
+            .callback = led_timer_cb,
+            .arg = (void *)(intptr_t)bin,
+            .name = "led",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&led_args, &b->led_timer));
+
+        const esp_timer_create_args_t indicate_args = {
+            .callback = indicate_timer_cb,
+            .arg = (void *)(intptr_t)bin,
+            .name = "indicate",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&indicate_args, &b->indicate_timer));
+    }
+
+    const esp_timer_create_args_t status_args = {
+        .callback = status_led_timer_cb,
+        .name = "status_led",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&status_args, &status_led_timer));
+}
+
+/* LPN Poll Policy */
+/*
+ * The Friend holds messages for the endpoint until it polls. The stack
+ * polls on its own at LPN_STACK_POLL_MS, which is what an idle bin needs;
+ * a press or an indication usually means more of a pick wave is coming, so
+ * the policy then polls every fast_ms for active_s seconds and backs off by
+ * doubling the interval until it reaches the idle interval.
+ */
+static uint32_t lpn_idle_ms(void)
+{
+    uint32_t idle_ms = lpn_policy.idle_s * 1000;
+    return idle_ms == 0 || idle_ms > LPN_STACK_POLL_MS ? LPN_STACK_POLL_MS : idle_ms;
+}
+
+static void lpn_poll_timer_cb(void *arg)
+{
+    app_evt_t evt = {
+        .type = APP_EVT_LPN_POLL,
+    };
+    xQueueSend(app_queue, &evt, 0);
+}
+
+static void lpn_report_timer_cb(void *arg)
+{
+    app_evt_t evt = {
+        .type = APP_EVT_LPN_REPORT,
+    };
+    xQueueSend(app_queue, &evt, 0);
+}
+
+// The stack's own polls raise no event: count them from the time it polled alone
+static void lpn_account_stack_polls(void)
+{
+    if (lpn_stack_since_us == 0) {
+        return;
+    }
+
+    uint32_t polls = (esp_timer_get_time() - lpn_stack_since_us) / (LPN_STACK_POLL_MS * 1000LL);
+    if (polls == 0) {
+        return;
+    }
+    lpn_stack_since_us += polls * (LPN_STACK_POLL_MS * 1000LL);
+    radio_used(polls * RADIO_MSG_TX_US, polls * RADIO_POLL_RX_US);
+}
+
+static void lpn_schedule(uint32_t interval_ms)
+{
+    esp_timer_stop(lpn_poll_timer);
+    lpn_account_stack_polls();
+    if (!lpn_friend || interval_ms >= LPN_STACK_POLL_MS) {
+        lpn_interval_ms = 0;    // The stack's own polls are often enough
+        if (!lpn_friend) {
+            lpn_stack_since_us = 0;
+        } else if (lpn_stack_since_us == 0) {
+            lpn_stack_since_us = esp_timer_get_time();
+        }
+        return;
+    }
+
+    lpn_stack_since_us = 0;
+    lpn_interval_ms = interval_ms;
+    esp_timer_start_once(lpn_poll_timer, (uint64_t)interval_ms * 1000);
+}
+
+static void lpn_reschedule(void)
+{
+    lpn_schedule(esp_timer_get_time() < lpn_active_until_us ? lpn_policy.fast_ms : lpn_idle_ms());
+}
+
+static void lpn_poll(void)
+{
+    if (lpn_interval_ms == 0) {
+        return;     // Stopped since the timer fired
+    }
+
+    esp_err_t err = esp_ble_mesh_lpn_poll();
+    radio_used(RADIO_MSG_TX_US, RADIO_POLL_RX_US);
+    if (err == ESP_OK) {
+        lpn_stats.polls++;
+    } else {
+        ESP_LOGW(TAG, "LPN poll failed: %s", esp_err_to_name(err));
+    }
+
+    uint32_t next = lpn_interval_ms * 2;
+    if (esp_timer_get_time() < lpn_active_until_us) {
+        next = lpn_policy.fast_ms;
+    } else if (next > lpn_idle_ms()) {
+        next = lpn_idle_ms();
+    }
+    lpn_schedule(next);
+}
+
+// A press or an indication: poll fast for the next active_s seconds
+static void lpn_activity(void)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t until = now + lpn_policy.active_s * 1000000LL;
+    int64_t counted = lpn_active_until_us > now ? lpn_active_until_us : now;
+
+    if (until > counted) {
+        lpn_stats.active_us += until - counted;
+        lpn_active_until_us = until;
+    }
+
+    if (lpn_interval_ms != lpn_policy.fast_ms) {
+        lpn_schedule(lpn_policy.fast_ms);
+    }
+}
+
+// Call before lpn_activity(): the interval it arrived with bounds its wait at the Friend
+static void lpn_indication_received(void)
+{
+    lpn_stats.indications++;
+    lpn_stats.wait_ms += lpn_interval_ms ? lpn_interval_ms : LPN_STACK_POLL_MS;
+}
+
+static void lpn_friendship_changed(bool established)
+{
+    lpn_friend = established;
+    // Without a Friend the node scans like any other
+    energy_model_set_load(ENERGY_LOAD_SCAN, !established);
+    lpn_reschedule();
+    if (established) {
+        press_queue_flush();
+    }
+}
+
+// From the mesh callbacks: the policy state belongs to app_task
+static void lpn_request_friendship(bool established)
+{
+    app_evt_t evt = {
+        .type = APP_EVT_LPN_FRIENDSHIP,
+        .friendship = established,
+    };
+    xQueueSend(app_queue, &evt, 0);
+}
+
+static void lpn_send_report(void)
+{
+    int64_t now = esp_timer_get_time();
+    // The rest of a running active window belongs to the next report
+    int64_t ahead_us = lpn_active_until_us > now ? lpn_active_until_us - now : 0;
+    uint32_t period_min = (now - lpn_stats.since_us) / 60000000;
+    uint32_t active_s = (lpn_stats.active_us - ahead_us) / 1000000;
+    uint32_t wait_units = lpn_stats.indications ?
+                          lpn_stats.wait_ms / lpn_stats.indications / MESH_VND_LPN_LATENCY_UNIT_MS : 0;
+
+    if (provisioned) {
+        uint8_t msg[MESH_VND_LPN_STATUS_LEN] = {
+            MIN(period_min, UINT8_MAX),
+            MIN(lpn_stats.polls, UINT16_MAX) & 0xFF, MIN(lpn_stats.polls, UINT16_MAX) >> 8,
+            MIN(active_s, UINT16_MAX) & 0xFF, MIN(active_s, UINT16_MAX) >> 8,
+            MIN(lpn_stats.indications, UINT8_MAX),
+            MIN(wait_units, UINT8_MAX),
+            battery_percent,
+        };
+
+        esp_ble_mesh_msg_ctx_t ctx;
+        report_ctx(&ctx);
+
+        esp_err_t err = esp_ble_mesh_server_model_send_msg(&vnd_models[0], &ctx, MESH_VND_OP_LPN_STATUS,
+                                                           sizeof(msg), msg);
+        radio_used(RADIO_MSG_TX_US, 0);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to send LPN report: %d", err);
+        }
+    }
+
+    ESP_LOGI(TAG, "LPN: %lu polls in %lu min, %lu s active, %lu indications",
+             (unsigned long)lpn_stats.polls, (unsigned long)period_min, (unsigned long)active_s,
+             (unsigned long)lpn_stats.indications);
+
+    memset(&lpn_stats, 0, sizeof(lpn_stats));
+    lpn_stats.since_us = now;
+    lpn_stats.active_us = ahead_us;
+}
+
+static void lpn_policy_load(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(LPN_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;     // Defaults
+    }
+
+    lpn_policy_t stored;
+    size_t len = sizeof(stored);
+    if (nvs_get_blob(handle, LPN_NVS_KEY, &stored, &len) == ESP_OK && len == sizeof(stored)) {
+        lpn_policy = stored;
+        ESP_LOGI(TAG, "LPN poll policy loaded from NVS");
+    }
+    nvs_close(handle);
+}
+
+static void lpn_policy_save(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(LPN_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, LPN_NVS_KEY, &lpn_policy, sizeof(lpn_policy));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save LPN poll policy: %s", esp_err_to_name(err));
+    }
+}
+
+// Back to the defaults, in RAM and in NVS
+static void lpn_policy_erase(void)
+{
+    lpn_policy = (lpn_policy_t)LPN_POLICY_DEFAULT;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(LPN_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_erase_all(handle);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to erase LPN poll policy: %s", esp_err_to_name(err));
+    }
+}
+
+static void lpn_policy_set(const uint8_t *msg)
+{
+    lpn_policy_t policy = {
+        .fast_ms = msg[0] | (msg[1] << 8),
+        .active_s = msg[2] | (msg[3] << 8),
+        .idle_s = msg[4] | (msg[5] << 8),
+    };
+
+    if (policy.fast_ms < LPN_FAST_POLL_MIN_MS ||
+        (policy.idle_s != 0 && policy.idle_s * 1000 < policy.fast_ms)) {
+        ESP_LOGW(TAG, "LPN poll policy rejected: fast %d ms, idle %d s", policy.fast_ms, policy.idle_s);
+        return;
+    }
+
+    lpn_policy = policy;
+    lpn_policy_save();
+    ESP_LOGI(TAG, "LPN poll policy: fast %d ms for %d s, idle %lu ms",
+             policy.fast_ms, policy.active_s, (unsigned long)lpn_idle_ms());
+
+    lpn_reschedule();
+    lpn_send_report();
+}
+
+static void lpn_start(void)
+{
+    esp_err_t err = esp_ble_mesh_lpn_enable();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable LPN: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "LPN enabled, stack poll interval %d ms", LPN_STACK_POLL_MS);
+    }
+}
+
+static void lpn_policy_init(void)
+{
+    if (!rtc_resumed) {
+        lpn_policy_load();
+    }
+
+    const esp_timer_create_args_t poll_args = {
+        .callback = lpn_poll_timer_cb,
+        .name = "lpn_poll",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&poll_args, &lpn_poll_timer));
+
+    const esp_timer_create_args_t report_args = {
+        .callback = lpn_report_timer_cb,
+        .name = "lpn_report",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&report_args, &lpn_report_timer));
+    esp_timer_start_periodic(lpn_report_timer, LPN_REPORT_PERIOD_S * 1000000ULL);
+
+    lpn_stats.since_us = esp_timer_get_time();
+}
+
+/* Energy Accounting */
+static void energy_report_timer_cb(void *arg)
+{
+    app_evt_t evt = {
+        .type = APP_EVT_ENERGY_REPORT,
+    };
+    xQueueSend(app_queue, &evt, 0);
+}
+
+static uint8_t charge_pct(const energy_model_report_t *report, uint32_t charge_uah)
+{
+    return report->charge_uah ? (uint64_t)charge_uah * 100 / report->charge_uah : 0;
+}
+
+static void energy_send_report(void)
+{
+    lpn_account_stack_polls();
+
+    energy_model_report_t report;
+    if (energy_model_get_report(&report, true) != ESP_OK || report.window_s == 0) {
+        return;
+    }
+
+    uint32_t window_min = report.window_s / 60;
+    uint32_t sleep_pct = (uint64_t)report.states[ENERGY_STATE_SLEEP].time_ms / 10 / report.window_s;
+    uint32_t radio_uah = report.states[ENERGY_STATE_RADIO_RX].charge_uah +
+                         report.states[ENERGY_STATE_RADIO_TX].charge_uah;
+
+    ESP_LOGI(TAG, "Energy: %lu uA average, %lu.%lu mAh/day, %lu%% asleep",
+             (unsigned long)report.average_ua, (unsigned long)report.mah_per_day_x10 / 10,
+             (unsigned long)report.mah_per_day_x10 % 10, (unsigned long)sleep_pct);
+    for (int i = 0; i < ENERGY_STATE_MAX; i++) {
+        ESP_LOGI(TAG, "  %-5s %8lu ms %6lu uAh", energy_model_state_name(i),
+                 (unsigned long)report.states[i].time_ms, (unsigned long)report.states[i].charge_uah);
+    }
+
+    if (!provisioned) {
+        return;
+    }
+
+    uint8_t msg[MESH_VND_ENERGY_STATUS_LEN] = {
+        MIN(window_min, UINT8_MAX),
+        MIN(report.average_ua, UINT16_MAX) & 0xFF, MIN(report.average_ua, UINT16_MAX) >> 8,
+        MIN(sleep_pct, 100),
+        charge_pct(&report, report.states[ENERGY_STATE_CPU].charge_uah),
+        charge_pct(&report, radio_uah),
+        charge_pct(&report, report.states[ENERGY_STATE_LED].charge_uah),
+        charge_pct(&report, report.states[ENERGY_STATE_SLEEP].charge_uah),
+    };
+
+    esp_ble_mesh_msg_ctx_t ctx;
+    report_ctx(&ctx);
+
+    esp_err_t err = esp_ble_mesh_server_model_send_msg(&vnd_models[0], &ctx, MESH_VND_OP_ENERGY_STATUS,
+                                                       sizeof(msg), msg);
+    radio_used(RADIO_MSG_TX_US, 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to send energy report: %d", err);
+    }
+}
+
+static void energy_accounting_init(void)
+{
+    esp_err_t err = energy_model_start();
+    if (err != ESP_OK) {
+        if (err != ESP_ERR_NOT_SUPPORTED) {
+            ESP_LOGW(TAG, "Energy model not started: %s", esp_err_to_name(err));
+        }
+        return;
+    }
+
+    // Scanning until a Friend is found
+    energy_model_set_load(ENERGY_LOAD_SCAN, true);
+
+    esp_timer_handle_t report_timer;
+    const esp_timer_create_args_t report_args = {
+        .callback = energy_report_timer_cb,
+        .name = "energy_report",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&report_args, &report_timer));
+    esp_timer_start_periodic(report_timer, ENERGY_REPORT_PERIOD_S * 1000000ULL);
+}
+
+/* Button Control Functions */
+static const gpio_num_t bin_button_gpios[BIN_COUNT] = BIN_BUTTON_GPIOS;
+
+// Runs in the esp_timer task: hand the event to app_task, arg is the bin
+static void button_event_cb(const button_evt_t *evt, void *arg)
+{
+    app_evt_t app_evt = {
+        .type = APP_EVT_BUTTON,
+        .bin = (uint8_t)(intptr_t)arg,
+        .button = *evt,
+    };
+    xQueueSend(app_queue, &app_evt, 0);
+}
+
+static void button_setup(void)
+{
+    for (int bin = 0; bin < BIN_COUNT; bin++) {
+        const button_config_t button_conf = {
+            .gpio = bin_button_gpios[bin],
+            .active_level = BUTTON_ACTIVE_LEVEL,
+            .callback = button_event_cb,
+            .arg = (void *)(intptr_t)bin,
+        };
+        ESP_ERROR_CHECK(button_init(&button_conf));
+        ESP_LOGI(TAG, "Bin %d button initialized on GPIO%d", bin, bin_button_gpios[bin]);
+    }
+
+    ESP_LOGI(TAG, "Hold button for %d seconds to factory reset", CONFIG_BUTTON_RESET_HOLD_MS / 1000);
+}
+
+/* Press Queue
+ *
+ * Without a Friend a press cannot reach the gateway, so instead of one
+ * unacknowledged message into the void it waits in NVS with the time it
+ * happened. time() runs from the RTC: it survives deep sleep and resets, but
+ * restarts at 0 after a power loss, and a press from before then is sent
+ * with an unknown age. The queue is sent as soon as a friendship is
+ * established, with each press's age, so the gateway can date it.
+ */
+typedef struct {
+    uint8_t seq;
+    uint8_t type;
+    uint8_t battery;
+    uint8_t bin;            // Element the report is sent from, padding in older queues
+    uint32_t at_s;          // time() of the press
+} queued_press_t;
+
+typedef struct {
+    uint8_t count;
+    queued_press_t entries[PRESS_QUEUE_LEN];
+} press_queue_t;
+
+static press_queue_t press_queue;
+
+/*
+ * The gateway drops a press whose sequence repeats the last one it saw from
+ * the element, so the sequence must not restart after a reset. Like the mesh
+ * stack's own sequence number it is stored ahead, a block at a time: NVS
+ * holds the last number reserved, a boot continues from there, and a write
+ * is only needed every PRESS_SEQ_BLOCK presses.
+ */
+static uint8_t press_seq = 0;
+static uint8_t press_seq_reserved = 0;
+
+static void press_seq_reserve(void)
+{
+    press_seq_reserved = press_seq + PRESS_SEQ_BLOCK;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(PRESS_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_u8(handle, PRESS_SEQ_NVS_KEY, press_seq_reserved);
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save press sequence: %s", esp_err_to_name(err));
+    }
+}
+
+static uint8_t press_seq_next(void)
+{
+    if (++press_seq == press_seq_reserved) {
+        press_seq_reserve();
+    }
+    return press_seq;
+}
+
+static void press_queue_save(void)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(PRESS_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, PRESS_NVS_KEY, &press_queue, sizeof(press_queue));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save press queue: %s", esp_err_to_name(err));
+    }
+}
+
+static void press_queue_load(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(PRESS_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        press_seq_reserve();    // Nothing queued or reserved yet
+        return;
+    }
+
+    // Past every number the last run may have used
+    bool reserved = nvs_get_u8(handle, PRESS_SEQ_NVS_KEY, &press_seq) == ESP_OK;
+
+    size_t len = sizeof(press_queue);
+    if (nvs_get_blob(handle, PRESS_NVS_KEY, &press_queue, &len) != ESP_OK || len != sizeof(press_queue) ||
+        press_queue.count > PRESS_QUEUE_LEN) {
+        memset(&press_queue, 0, sizeof(press_queue));
+    }
+    nvs_close(handle);
+
+    // A bin that no longer exists reports from the primary element
+    for (uint8_t i = 0; i < press_queue.count; i++) {
+        if (press_queue.entries[i].bin >= BIN_COUNT) {
+            press_queue.entries[i].bin = 0;
+        }
+    }
+
+    if (press_queue.count > 0) {
+        if (!reserved) {
+            // Queue from before the sequence was stored: carry on from its last press
+            press_seq = press_queue.entries[press_queue.count - 1].seq;
+        }
+        ESP_LOGI(TAG, "%d queued presses loaded from NVS", press_queue.count);
+    }
+    press_seq_reserve();
+}
+
+static void press_queue_push(uint8_t bin, uint8_t seq, uint8_t type)
+{
+    if (press_queue.count == PRESS_QUEUE_LEN) {
+        ESP_LOGW(TAG, "Press queue full, dropping press %d", press_queue.entries[0].seq);
+        memmove(&press_queue.entries[0], &press_queue.entries[1],
+                (PRESS_QUEUE_LEN - 1) * sizeof(queued_press_t));
+        press_queue.count--;
+    }
+
+    press_queue.entries[press_queue.count++] = (queued_press_t) {
+        .seq = seq,
+        .type = type,
+        .battery = battery_percent,
+        .bin = bin,
+        .at_s = (uint32_t)time(NULL),
     };
+    press_queue_save();
+    ESP_LOGI(TAG, "No Friend, bin %d press %d queued (%d waiting)", bin, seq, press_queue.count);
+}
 
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip));
-
-    // Clear LED (turn off)
-    led_strip_clear(led_strip);
+/* Deep Sleep
+ *
+ * A Low Power Node in light sleep still wakes for every poll. After
+ * DEEP_SLEEP_IDLE_S without a press, an indication or a location request,
+ * and with nothing lit for a pick, the endpoint clears its friendship and
+ * goes to deep sleep until a bin's button is pressed: only the RTC runs.
+ * Messages sent to it meanwhile are lost, so this is for long closures,
+ * not for the gaps between picks.
+ *
+ * The state app_main would otherwise read back from NVS is kept in RTC
+ * memory, which survives deep sleep but not a reset or a power loss. A
+ * deep sleep wake with a valid copy skips those reads; the mesh stack
+ * still restores its keys and sequence number in esp_ble_mesh_init(). The
+ * press that woke the node may be over before its button is watched
+ * again, so it is taken from the wakeup status and queued until the
+ * friendship is back, like any other press. Each phase from start-up to
+ * that report going out is timed and logged.
+ */
+#define RTC_STATE_MAGIC     0x52544333  // "RTC3": bump when rtc_state_t changes
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sleeps;            // Deep sleeps since the last reset
+    uint16_t node_addr;
+    uint16_t gateway_addr;
+    mesh_pub_settings_t report_pub;
+    lpn_policy_t lpn_policy;
+    led_pattern_t led_patterns[MESH_VND_LED_PATTERN_MAX];
+    uint8_t led_brightness_pct;
+    press_queue_t press_queue;
+    uint8_t press_seq;
+    uint8_t press_seq_reserved;
+    uint8_t battery_percent;
+} rtc_state_t;
+
+static RTC_DATA_ATTR rtc_state_t rtc_state;
+
+// Phases of a deep sleep wake, esp_timer time since start-up
+static struct {
+    bool pending;           // Press report not sent yet
+    int64_t app_us;         // app_main entered
+    int64_t init_us;        // Application state restored, peripherals up
+    int64_t mesh_us;        // Mesh stack up
+    int64_t friend_us;      // Friendship established
+} wake_timing;
+
+static void wake_timing_mark(int64_t *phase)
+{
+    if (wake_timing.pending && *phase == 0) {
+        *phase = esp_timer_get_time();
+    }
 }
 
-static void neopixel_set_color(uint8_t red, uint8_t green, uint8_t blue)
+static void sleep_timer_callback(void *arg)
 {
-    led_strip_set_pixel(led_strip, 0, red, green, blue);
-    led_strip_refresh(led_strip);
+    app_evt_t evt = {
+        .type = APP_EVT_DEEP_SLEEP,
+    };
+    xQueueSend(app_queue, &evt, 0);
 }
 
-static void neopixel_off(void)
+static void reset_sleep_timer(void)
 {
-    led_strip_clear(led_strip);
+    if (sleep_timer != NULL) {
+        esp_timer_stop(sleep_timer);
+        esp_timer_start_once(sleep_timer, DEEP_SLEEP_IDLE_S * 1000000ULL);
+    }
 }
 
-/* Battery Monitoring (Mock for now - can be replaced with real battery reading) */
-static void update_battery_status(void)
+static void sleep_timer_init(void)
 {
-    // TODO: Replace with actual battery reading from MAX17048 or ADC
-    // For now, use mock value
-    // battery_percent = read_battery_percentage();
+    const esp_timer_create_args_t timer_args = {
+        .callback = sleep_timer_callback,
+        .name = "sleep_timer",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &sleep_timer));
+    reset_sleep_timer();
+}
 
-    // Mock: Simulate battery drain over time (for testing)
-    static uint32_t last_update = 0;
-    uint32_t now = esp_timer_get_time() / 1000000;  // seconds
+// Any bin's button ends the deep sleep; the RTC pulls hold the pins while the digital ones are off
+static esp_err_t deep_sleep_wakeup_init(void)
+{
+    uint64_t mask = 0;
+    for (int bin = 0; bin < BIN_COUNT; bin++) {
+        if (!rtc_gpio_is_valid_gpio(bin_button_gpios[bin])) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        mask |= 1ULL << bin_button_gpios[bin];
+    }
 
-    if (now - last_update > 60) {  // Update every 60 seconds
-        if (battery_percent > 0) {
-            battery_percent--;  // Decrease 1% per minute (for testing)
+    for (int bin = 0; bin < BIN_COUNT; bin++) {
+        if (BUTTON_ACTIVE_LEVEL) {
+            rtc_gpio_pullup_dis(bin_button_gpios[bin]);
+            rtc_gpio_pulldown_en(bin_button_gpios[bin]);
+        } else {
+            rtc_gpio_pulldown_dis(bin_button_gpios[bin]);
+            rtc_gpio_pullup_en(bin_button_gpios[bin]);
         }
-        last_update = now;
-        ESP_LOGI(TAG, "Battery: %d%%", battery_percent);
     }
+#if SOC_PM_SUPPORT_RTC_PERIPH_PD
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+#endif
+    // The light sleep GPIO wakeup does not apply to deep sleep
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+    return esp_sleep_enable_ext1_wakeup_io(mask, BUTTON_ACTIVE_LEVEL ? ESP_EXT1_WAKEUP_ANY_HIGH
+                                                                     : ESP_EXT1_WAKEUP_ANY_LOW);
 }
 
-/* Update LED state based on system status */
-static void update_led_state(void)
+static void deep_sleep_enter(void)
 {
-    update_battery_status();
+    bool lit = location_indicator_active;
+    for (uint8_t bin = 0; bin < BIN_COUNT; bin++) {
+        lit |= indication_active(bin);
+    }
+    if (!provisioned || lit) {
+        reset_sleep_timer();    // Needed: try again after another idle period
+        return;
+    }
 
-    // Priority order: Location > Battery Low > No Gateway > Other
-    if (location_indicator_active) {
-        current_led_state = LED_STATE_LOCATION_INDICATOR;
-    } else if (battery_percent < BATTERY_LOW_THRESHOLD) {
-        current_led_state = LED_STATE_BATTERY_LOW;
-    } else if (!gateway_connected) {
-        current_led_state = LED_STATE_NO_GATEWAY;
-    } else {
-        current_led_state = LED_STATE_OTHER;
+    esp_err_t err = deep_sleep_wakeup_init();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No deep sleep, button wakeup failed: %s", esp_err_to_name(err));
+        return;                 // Stays a Low Power Node in light sleep
     }
-}
 
-/* Red LED Control Functions */
-static void led_init(void)
-{
-    gpio_reset_pin(LED_GPIO);
-    gpio_set_direction(LED_GPIO, GPIO_MODE_OUTPUT);
-    gpio_set_level(LED_GPIO, 0);
+    ESP_LOGI(TAG, "Idle for %d s, deep sleep until a press", DEEP_SLEEP_IDLE_S);
+
+    // Free this node's slot at the Friend, and give the Friend Clear time to go out
+    esp_ble_mesh_lpn_disable(false);
+    vTaskDelay(pdMS_TO_TICKS(DEEP_SLEEP_CLEAR_MS));
+
+    esp_timer_stop(status_led_timer);
+    led_off();
+    for (uint8_t bin = 0; bin < BIN_COUNT; bin++) {
+        neopixel_off(bin);
+    }
+    mesh_storage_flush();
+
+    uint32_t sleeps = rtc_state.magic == RTC_STATE_MAGIC ? rtc_state.sleeps + 1 : 1;
+    rtc_state = (rtc_state_t) {
+        .magic = RTC_STATE_MAGIC,
+        .sleeps = sleeps,
+        .node_addr = node_addr,
+        .gateway_addr = gateway_addr,
+        .report_pub = report_pub,
+        .lpn_policy = lpn_policy,
+        .led_brightness_pct = led_brightness_pct,
+        .press_queue = press_queue,
+        .press_seq = press_seq,
+        .press_seq_reserved = press_seq_reserved,
+        .battery_percent = battery_percent,
+    };
+    memcpy(rtc_state.led_patterns, led_patterns, sizeof(led_patterns));
+
+    esp_deep_sleep_start();
 }
 
-static void led_on(void)
+// In app_main, before anything reads NVS: true if the state came back from RTC memory
+static bool deep_sleep_resume(void)
 {
-    gpio_set_level(LED_GPIO, 1);
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_EXT1 || rtc_state.magic != RTC_STATE_MAGIC) {
+        return false;
+    }
+
+    provisioned = true;
+    node_addr = rtc_state.node_addr;
+    gateway_addr = rtc_state.gateway_addr;
+    report_pub = rtc_state.report_pub;
+    lpn_policy = rtc_state.lpn_policy;
+    memcpy(led_patterns, rtc_state.led_patterns, sizeof(led_patterns));
+    led_brightness_pct = rtc_state.led_brightness_pct;
+    press_queue = rtc_state.press_queue;
+    press_seq = rtc_state.press_seq;
+    press_seq_reserved = rtc_state.press_seq_reserved;
+    battery_percent = rtc_state.battery_percent;
+    rtc_resumed = true;
+    wake_timing.pending = true;
+    ESP_LOGI(TAG, "Woken from deep sleep %lu, state restored from RTC memory (Node: 0x%04X)",
+             (unsigned long)rtc_state.sleeps, node_addr);
+    return true;
 }
 
-static void led_off(void)
+// Report the press that woke the node if its button is already released; a held one raises its own events
+static void deep_sleep_wake_press(void)
 {
-    gpio_set_level(LED_GPIO, 0);
+    if (!rtc_resumed) {
+        return;
+    }
+
+    uint64_t woken_by = esp_sleep_get_ext1_wakeup_status();
+    for (uint8_t bin = 0; bin < BIN_COUNT; bin++) {
+        if (!(woken_by & (1ULL << bin_button_gpios[bin])) ||
+            gpio_get_level(bin_button_gpios[bin]) == BUTTON_ACTIVE_LEVEL) {
+            continue;
+        }
+        app_evt_t evt = {
+            .type = APP_EVT_BUTTON,
+            .bin = bin,
+            .button = {
+                .event = BUTTON_EVENT_TAP,
+            },
+        };
+        xQueueSend(app_queue, &evt, 0);
+    }
 }
 
-static void led_toggle(void)
+// The first press report after a deep sleep wake has gone out
+static void wake_first_packet(void)
 {
-    static bool led_state = false;
-    led_state = !led_state;
-    gpio_set_level(LED_GPIO, led_state);
+    if (!wake_timing.pending) {
+        return;
+    }
+    wake_timing.pending = false;
+
+    int64_t now = esp_timer_get_time();
+    ESP_LOGI(TAG, "Wake to first packet %lld ms: app_main %lld, init %lld, mesh %lld, Friend %lld ms",
+             now / 1000, wake_timing.app_us / 1000, wake_timing.init_us / 1000,
+             wake_timing.mesh_us / 1000, wake_timing.friend_us / 1000);
 }
 
-/* Button Control Functions */
-static void button_init(void)
-{
-    // Configure GPIO5 for factory reset button
-    gpio_config_t io_conf = {
-        .intr_type = GPIO_INTR_DISABLE,  // No interrupt - use polling
-        .mode = GPIO_MODE_INPUT,
-        .pin_bit_mask = (1ULL << BUTTON_GPIO),
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+/* Bluetooth Mesh Message Sending */
+// Sent from the bin's own element: its address tells the gateway which bin it was
+static esp_err_t press_send(uint8_t bin, uint8_t seq, uint8_t type, uint8_t battery, uint16_t age_s)
+{
+    uint8_t msg[MESH_VND_PRESS_REPORT_LEN] = {
+        seq,
+        type,
+        battery,
+        age_s & 0xFF,
+        age_s >> 8,
     };
-    gpio_config(&io_conf);
 
-    ESP_LOGI(TAG, "Factory reset button initialized on GPIO%d", BUTTON_GPIO);
-    ESP_LOGI(TAG, "Hold button for 10 seconds to factory reset");
+    esp_ble_mesh_msg_ctx_t ctx;
+    report_ctx(&ctx);
+
+    esp_err_t err = esp_ble_mesh_server_model_send_msg(&vnd_models[bin], &ctx, MESH_VND_OP_PRESS_REPORT,
+                                                       sizeof(msg), msg);
+    radio_used(RADIO_MSG_TX_US, 0);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Bin %d press report %d sent to 0x%04x", bin, seq, ctx.addr);
+        wake_first_packet();
+    } else {
+        ESP_LOGE(TAG, "Failed to send press report: %d", err);
+    }
+    return err;
 }
 
-/* Deep Sleep Functions - DEPRECATED for LPN */
-/*
-static void sleep_timer_callback(void *arg)
+// Called once a friendship is established; presses that fail to send stay queued
+static void press_queue_flush(void)
 {
-    // Disable deep sleep until provisioned
-    if (!provisioned) {
-        ESP_LOGI(TAG, "Not provisioned yet, skipping deep sleep");
-        reset_sleep_timer();
+    if (press_queue.count == 0) {
         return;
     }
 
-    ESP_LOGI(TAG, "Entering deep sleep mode...");
-
-    // Turn off LED before sleep
-    led_off();
-    neopixel_off();
+    uint32_t now = (uint32_t)time(NULL);
+    uint8_t sent = 0;
+    while (sent < press_queue.count) {
+        const queued_press_t *press = &press_queue.entries[sent];
+        uint16_t age_s = press->at_s <= now ? MIN(now - press->at_s, MESH_VND_PRESS_AGE_MAX)
+                                            : MESH_VND_PRESS_AGE_UNKNOWN;
+        if (press_send(press->bin, press->seq, press->type, press->battery, age_s) != ESP_OK) {
+            break;
+        }
+        sent++;
+    }
 
-    // Enter deep sleep (no wakeup source - will require reset to wake)
-    esp_deep_sleep_start();
+    memmove(&press_queue.entries[0], &press_queue.entries[sent],
+            (press_queue.count - sent) * sizeof(queued_press_t));
+    press_queue.count -= sent;
+    press_queue_save();
+    ESP_LOGI(TAG, "Press queue flushed: %d sent, %d left", sent, press_queue.count);
 }
 
-static void reset_sleep_timer(void)
+
+/*
+ * Reports go to the vendor server's publication address when the provisioner
+ * set one, otherwise to the unicast address the gateway's commands come from.
+ * Only before either is known do they fall back to the 0xC000 group, which
+ * every subscribed node processes and every Friend queues for its LPNs.
+ */
+static void report_ctx(esp_ble_mesh_msg_ctx_t *ctx)
 {
-    if (sleep_timer != NULL) {
-        esp_timer_stop(sleep_timer);
-        esp_timer_start_once(sleep_timer, DEEP_SLEEP_TIMEOUT_MS * 1000);
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->net_idx = 0;
+    if (report_pub.publish_addr != ESP_BLE_MESH_ADDR_UNASSIGNED &&
+        !ESP_BLE_MESH_ADDR_IS_VIRTUAL(report_pub.publish_addr)) {
+        ctx->app_idx = report_pub.app_idx;
+        ctx->addr = report_pub.publish_addr;
+        ctx->send_ttl = report_pub.ttl;     // 0xFF is the default TTL either way
+    } else if (gateway_addr != ESP_BLE_MESH_ADDR_UNASSIGNED) {
+        ctx->app_idx = 0;
+        ctx->addr = gateway_addr;
+        ctx->send_ttl = 3;
+    } else {
+        ctx->app_idx = 0;
+        ctx->addr = 0xC000;
+        ctx->send_ttl = 3;
     }
 }
 
-static void sleep_timer_init(void)
+static void send_press_report(uint8_t bin, uint8_t press_type)
 {
-    const esp_timer_create_args_t timer_args = {
-        .callback = &sleep_timer_callback,
-        .name = "sleep_timer"
-    };
-    esp_timer_create(&timer_args, &sleep_timer);
-    reset_sleep_timer();
+    uint8_t seq = press_seq_next();
+
+    if (provisioned && !lpn_friend) {
+        press_queue_push(bin, seq, press_type);
+        return;
+    }
+    press_send(bin, seq, press_type, battery_percent, 0);
 }
-*/
-static void reset_sleep_timer(void) {} // Stub to satisfy any remaining calls
 
-/* Bluetooth Mesh Message Sending */
-static void send_button_press_message(void)
+#if CONFIG_TASK_PROFILER_ENABLE
+/* Send the busiest tasks of the last profiler window to the gateway */
+static void send_profile_report(const task_profiler_snapshot_t *snapshot, void *arg)
 {
-    esp_err_t err;
+    if (!provisioned) {
+        return;
+    }
 
-    // Prepare Generic OnOff Set message
-    esp_ble_mesh_generic_client_set_state_t set_state = {0};
-    set_state.onoff_set.op_en = false;
-    set_state.onoff_set.onoff = 1;  // Button pressed = ON
-    set_state.onoff_set.tid = 0;
-
-    // Prepare common parameters
-    esp_ble_mesh_client_common_param_t common = {0};
-    common.opcode = ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET_UNACK;
-    common.model = &root_models[2];  // Generic OnOff Client (index 2)
-    common.ctx.net_idx = 0;
-    common.ctx.app_idx = 0;
-    common.ctx.addr = 0xC000;  // Group address (All Nodes)
-    common.ctx.send_ttl = 3;
-    common.msg_timeout = 0;
-
-    // Send message
-    err = esp_ble_mesh_generic_client_set_state(&common, &set_state);
+    uint8_t msg[MESH_VND_PROFILE_MAX_LEN];
+    size_t count = snapshot->task_count;
+    if (count > MESH_VND_PROFILE_MAX_ENTRIES) {
+        count = MESH_VND_PROFILE_MAX_ENTRIES;
+    }
 
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Button press message sent to 0x%04x", common.ctx.addr);
-    } else {
-        ESP_LOGE(TAG, "Failed to send button press message: %d", err);
+    uint32_t window_s = snapshot->window_ms / 1000;
+    msg[0] = window_s > UINT8_MAX ? UINT8_MAX : (uint8_t)window_s;
+    msg[1] = (uint8_t)count;
+
+    uint8_t *entry = &msg[2];
+    for (size_t i = 0; i < count; i++) {
+        const task_profiler_entry_t *task = &snapshot->tasks[i];
+        uint32_t stack_hwm = task->stack_hwm_bytes > UINT16_MAX ? UINT16_MAX : task->stack_hwm_bytes;
+
+        strncpy((char *)entry, task->name, MESH_VND_PROFILE_NAME_LEN);
+        entry[4] = (uint8_t)(task->cpu_permille / 5);  // 0.5 % units
+        entry[5] = stack_hwm & 0xFF;
+        entry[6] = stack_hwm >> 8;
+        entry += MESH_VND_PROFILE_ENTRY_LEN;
+    }
+
+    esp_ble_mesh_msg_ctx_t ctx;
+    report_ctx(&ctx);
+
+    esp_err_t err = esp_ble_mesh_server_model_send_msg(&vnd_models[0], &ctx, MESH_VND_OP_PROFILE_STATUS,
+                                                       entry - msg, msg);
+    radio_used(RADIO_MSG_TX_US * ((entry - msg + RADIO_SEG_PAYLOAD - 1) / RADIO_SEG_PAYLOAD), 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to send profile report: %d", err);
     }
 }
+#endif
 
 /* Bluetooth Mesh Callbacks */
 static void provisioning_cb(esp_ble_mesh_prov_cb_event_t event, esp_ble_mesh_prov_cb_param_t *param)
@@ -336,9 +1857,8 @@ static void provisioning_cb(esp_ble_mesh_prov_cb_event_t event, esp_ble_mesh_pro
         ESP_LOGI(TAG, "Provisioning link closed");
         break;
     case ESP_BLE_MESH_NODE_PROV_COMPLETE_EVT:
-        ESP_LOGI(TAG, "========================================");
-        ESP_LOGI(TAG, "🎉 PROVISIONING COMPLETE!");
-        ESP_LOGI(TAG, "========================================");
+        DLOG_I(TAG, "🎉 Provisioning complete: addr=0x%04X net_idx=0x%04X",
+               param->node_prov_complete.addr, param->node_prov_complete.net_idx);
         node_addr = param->node_prov_complete.addr;
         provisioned = true;
         gateway_connected = true;
@@ -358,24 +1878,11 @@ static void provisioning_cb(esp_ble_mesh_prov_cb_event_t event, esp_ble_mesh_pro
         // Save to NVS
         esp_err_t err = mesh_storage_save_prov_data(&prov_data);
         if (err != ESP_OK) {
-            ESP_LOGE(TAG, "❌ Failed to save provisioning data: %s", esp_err_to_name(err));
+            DLOG_E(TAG, "❌ Failed to save provisioning data: 0x%x", err);
         }
 
-        update_led_state();
-
-        // Enable LPN functionality
-        esp_ble_mesh_lpn_t lpn_conf = {
-            .min_queue_size = 2,
-            .poll_timeout_ms = 10000, // 10 seconds poll timeout
-            .msg_recv_window_ms = 100,
-        };
-        
-        err = esp_ble_mesh_lpn_enable(&lpn_conf);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to enable LPN: %d", err);
-        } else {
-            ESP_LOGI(TAG, "LPN Enabled");
-        }
+        led_request_update();
+        lpn_start();
         break;
     case ESP_BLE_MESH_LPN_ENABLE_COMP_EVT:
         ESP_LOGI(TAG, "LPN Enable Complete, err_code %d", param->lpn_enable_comp.err_code);
@@ -383,12 +1890,19 @@ static void provisioning_cb(esp_ble_mesh_prov_cb_event_t event, esp_ble_mesh_pro
     case ESP_BLE_MESH_LPN_FRIENDSHIP_ESTABLISH_EVT:
         ESP_LOGI(TAG, "Friendship established with 0x%04x", param->lpn_friendship_establish.friend_addr);
         gateway_connected = true; // Assuming Friend is the gateway or connected to it
-        update_led_state();
+        led_request_update();
+        lpn_request_friendship(true);
         break;
     case ESP_BLE_MESH_LPN_FRIENDSHIP_TERMINATE_EVT:
         ESP_LOGW(TAG, "Friendship terminated with 0x%04x", param->lpn_friendship_terminate.friend_addr);
         gateway_connected = false;
-        update_led_state();
+        led_request_update();
+        lpn_request_friendship(false);
+        break;
+    case ESP_BLE_MESH_LPN_POLL_COMP_EVT:
+        if (param->lpn_poll_comp.err_code != 0) {
+            ESP_LOGW(TAG, "LPN poll failed, err_code %d", param->lpn_poll_comp.err_code);
+        }
         break;
     case ESP_BLE_MESH_NODE_PROV_RESET_EVT:
         ESP_LOGI(TAG, "Provisioning reset");
@@ -400,19 +1914,15 @@ static void provisioning_cb(esp_ble_mesh_prov_cb_event_t event, esp_ble_mesh_pro
 
 static void config_server_cb(esp_ble_mesh_cfg_server_cb_event_t event, esp_ble_mesh_cfg_server_cb_param_t *param)
 {
-    ESP_LOGI(TAG, "Config server callback, event %d", event);
-
     if (event == ESP_BLE_MESH_CFG_SERVER_STATE_CHANGE_EVT) {
-        ESP_LOGI(TAG, "Config server state changed");
+        DLOG_D(TAG, "Config server state changed, op 0x%04X", param->ctx.recv_op);
 
         // Check if this is a model app bind event
         switch (param->ctx.recv_op) {
         case ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD:
-            ESP_LOGI(TAG, "========================================");
-            ESP_LOGI(TAG, "🔑 AppKey Added!");
-            ESP_LOGI(TAG, "   Net Index: 0x%04X", param->value.state_change.appkey_add.net_idx);
-            ESP_LOGI(TAG, "   App Index: 0x%04X", param->value.state_change.appkey_add.app_idx);
-            ESP_LOGI(TAG, "========================================");
+            DLOG_I(TAG, "🔑 AppKey added: net_idx=0x%04X app_idx=0x%04X",
+                   param->value.state_change.appkey_add.net_idx,
+                   param->value.state_change.appkey_add.app_idx);
 
             // Update provisioning data with AppKey index
             mesh_prov_data_t prov_data;
@@ -425,13 +1935,11 @@ static void config_server_cb(esp_ble_mesh_cfg_server_cb_event_t event, esp_ble_m
             break;
 
         case ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND:
-            ESP_LOGI(TAG, "========================================");
-            ESP_LOGI(TAG, "🔗 Model Bound to AppKey!");
-            ESP_LOGI(TAG, "   Element Addr: 0x%04X", param->value.state_change.mod_app_bind.element_addr);
-            ESP_LOGI(TAG, "   Model ID:     0x%04X", param->value.state_change.mod_app_bind.model_id);
-            ESP_LOGI(TAG, "   Company ID:   0x%04X", param->value.state_change.mod_app_bind.company_id);
-            ESP_LOGI(TAG, "   App Index:    0x%04X", param->value.state_change.mod_app_bind.app_idx);
-            ESP_LOGI(TAG, "========================================");
+            DLOG_I(TAG, "🔗 Model 0x%04X (cid 0x%04X) bound: elem=0x%04X app_idx=0x%04X",
+                   param->value.state_change.mod_app_bind.model_id,
+                   param->value.state_change.mod_app_bind.company_id,
+                   param->value.state_change.mod_app_bind.element_addr,
+                   param->value.state_change.mod_app_bind.app_idx);
 
             // Save model binding
             mesh_model_binding_t binding = {
@@ -454,11 +1962,9 @@ static void config_server_cb(esp_ble_mesh_cfg_server_cb_event_t event, esp_ble_m
             break;
 
         case ESP_BLE_MESH_MODEL_OP_MODEL_PUB_SET:
-            ESP_LOGI(TAG, "========================================");
-            ESP_LOGI(TAG, "📢 Model Publication Set!");
-            ESP_LOGI(TAG, "   Element Addr: 0x%04X", param->value.state_change.mod_pub_set.element_addr);
-            ESP_LOGI(TAG, "   Publish Addr: 0x%04X", param->value.state_change.mod_pub_set.pub_addr);
-            ESP_LOGI(TAG, "========================================");
+            DLOG_I(TAG, "📢 Model publication set: elem=0x%04X pub=0x%04X",
+                   param->value.state_change.mod_pub_set.element_addr,
+                   param->value.state_change.mod_pub_set.pub_addr);
 
             // Save publication settings
             mesh_pub_settings_t pub_settings = {
@@ -474,6 +1980,12 @@ static void config_server_cb(esp_ble_mesh_cfg_server_cb_event_t event, esp_ble_m
                 model_id = "onoff_srv";
             } else if (param->value.state_change.mod_pub_set.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI) {
                 model_id = "onoff_cli";
+            } else if (param->value.state_change.mod_pub_set.company_id == MESH_VND_CID &&
+                       param->value.state_change.mod_pub_set.model_id == MESH_VND_MODEL_ID_SERVER &&
+                       param->value.state_change.mod_pub_set.element_addr == node_addr) {
+                // Every bin reports through the primary element's publication
+                model_id = "vnd_srv";
+                report_pub = pub_settings;
             }
 
             if (model_id) {
@@ -483,10 +1995,41 @@ static void config_server_cb(esp_ble_mesh_cfg_server_cb_event_t event, esp_ble_m
             break;
 
         case ESP_BLE_MESH_MODEL_OP_MODEL_SUB_ADD:
-            ESP_LOGI(TAG, "Model subscription add: elem_addr=0x%04x, sub_addr=0x%04x",
-                     param->value.state_change.mod_sub_add.element_addr,
-                     param->value.state_change.mod_sub_add.sub_addr);
-            // Note: Subscription addresses could be saved here if needed
+            DLOG_I(TAG, "📬 Model 0x%04X subscribed: elem=0x%04X sub=0x%04X",
+                   param->value.state_change.mod_sub_add.model_id,
+                   param->value.state_change.mod_sub_add.element_addr,
+                   param->value.state_change.mod_sub_add.sub_addr);
+
+            // Determine model ID string
+            model_id = NULL;
+            if (param->value.state_change.mod_sub_add.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV) {
+                model_id = "onoff_srv";
+            } else if (param->value.state_change.mod_sub_add.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI) {
+                model_id = "onoff_cli";
+            }
+
+            if (model_id) {
+                mesh_storage_add_subscription(model_id, param->value.state_change.mod_sub_add.sub_addr);
+            }
+            break;
+
+        case ESP_BLE_MESH_MODEL_OP_MODEL_SUB_DELETE:
+            DLOG_I(TAG, "📭 Model 0x%04X unsubscribed: elem=0x%04X sub=0x%04X",
+                   param->value.state_change.mod_sub_delete.model_id,
+                   param->value.state_change.mod_sub_delete.element_addr,
+                   param->value.state_change.mod_sub_delete.sub_addr);
+
+            // Determine model ID string
+            model_id = NULL;
+            if (param->value.state_change.mod_sub_delete.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV) {
+                model_id = "onoff_srv";
+            } else if (param->value.state_change.mod_sub_delete.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI) {
+                model_id = "onoff_cli";
+            }
+
+            if (model_id) {
+                mesh_storage_remove_subscription(model_id, param->value.state_change.mod_sub_delete.sub_addr);
+            }
             break;
 
         default:
@@ -497,184 +2040,212 @@ static void config_server_cb(esp_ble_mesh_cfg_server_cb_event_t event, esp_ble_m
 
 
 
-/* LED Control Task */
-static void led_control_task(void *pvParameters)
+/* Button Event Handler */
+static void factory_reset(void)
 {
-    static bool blink_state = false;
-    static uint8_t last_onoff = 0;
-    uint32_t blink_delay = 500;  // 500ms for blinking
+    ESP_LOGW(TAG, "");
+    ESP_LOGW(TAG, "========================================");
+    ESP_LOGW(TAG, "🔴 FACTORY RESET TRIGGERED!");
+    ESP_LOGW(TAG, "========================================");
+    ESP_LOGW(TAG, "Clearing all provisioning data...");
+
+    // With CONFIG_BLE_MESH_SETTINGS the stack would restore its own provisioning after the restart
+    esp_err_t err = esp_ble_mesh_node_local_reset();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ BLE Mesh stack reset");
+    } else {
+        ESP_LOGE(TAG, "✗ Failed to reset BLE Mesh stack: %s", esp_err_to_name(err));
+    }
 
-    while (1) {
-        // Check if onoff state changed
-        if (onoff_server.state.onoff != last_onoff) {
-            last_onoff = onoff_server.state.onoff;
-
-            if (last_onoff) {
-                location_indicator_active = true;
-                ESP_LOGI(TAG, "Location indicator ON (from BLE Mesh)");
-            } else {
-                location_indicator_active = false;
-                ESP_LOGI(TAG, "Location indicator OFF (from BLE Mesh)");
-            }
-        }
+    // Clear all mesh storage
+    err = mesh_storage_clear();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ Provisioning data cleared");
+    } else {
+        ESP_LOGE(TAG, "✗ Failed to clear provisioning data: %s", esp_err_to_name(err));
+    }
 
-        update_led_state();
+    // Queued presses belong to the old network
+    memset(&press_queue, 0, sizeof(press_queue));
+    press_queue_save();
 
-        switch (current_led_state) {
-            case LED_STATE_LOCATION_INDICATOR:
-                // Green solid - storage location indicator
-                neopixel_set_color(0, 255, 0);  // Green
-                break;
+    // So are the patterns and the poll policy its gateway set
+    led_patterns_erase();
+    lpn_policy_erase();
 
-            case LED_STATE_BATTERY_LOW:
-                // Red blinking - battery < 10%
-                if (blink_state) {
-                    neopixel_set_color(255, 0, 0);  // Red
-                } else {
-                    neopixel_off();
-                }
-                blink_state = !blink_state;
-                break;
-
-            case LED_STATE_NO_GATEWAY:
-                // Blue blinking - no gateway connection
-                if (blink_state) {
-                    neopixel_set_color(0, 0, 255);  // Blue
-                } else {
-                    neopixel_off();
-                }
-                blink_state = !blink_state;
-                break;
-
-            case LED_STATE_OTHER:
-                // Yellow blinking - other states
-                if (blink_state) {
-                    neopixel_set_color(255, 255, 0);  // Yellow
-                } else {
-                    neopixel_off();
-                }
-                blink_state = !blink_state;
-                break;
-        }
+    ESP_LOGW(TAG, "Restarting device in 2 seconds...");
+    vTaskDelay(pdMS_TO_TICKS(2000));
 
-        // Red LED control based on gateway connection
-        if (gateway_connected) {
-            led_toggle();  // Blink when connected
-        } else {
-            led_on();      // Solid when not connected
-        }
+    ESP_LOGW(TAG, "========================================");
+    ESP_LOGW(TAG, "🔄 RESTARTING...");
+    ESP_LOGW(TAG, "========================================");
 
-        vTaskDelay(pdMS_TO_TICKS(blink_delay));
-    }
+    esp_restart();
 }
 
-/* Factory Reset Handler - GPIO0 Button */
-static void check_factory_reset(void)
+// Only bin 0's button resets the node; on the others a hold is just a long press
+static void handle_button_event(uint8_t bin, const button_evt_t *evt)
 {
-    static uint32_t button_hold_start = 0;
-    static bool factory_reset_in_progress = false;
-    static bool warning_shown = false;
-    static bool critical_warning_shown = false;
-
-    // Read button state (active LOW)
-    int button_state = gpio_get_level(BUTTON_GPIO);
-
-    if (button_state == BUTTON_ACTIVE_LEVEL) {
-        // Button is pressed
-        if (button_hold_start == 0) {
-            // Button just pressed
-            button_hold_start = esp_timer_get_time() / 1000; // Convert to ms
-            factory_reset_in_progress = true;
-            warning_shown = false;
-            critical_warning_shown = false;
-            ESP_LOGI(TAG, "Button pressed - hold for 10 seconds to factory reset");
-        } else {
-            // Button is being held
-            uint32_t hold_duration = (esp_timer_get_time() / 1000) - button_hold_start;
-
-            // Warning at 3 seconds
-            if (hold_duration >= FACTORY_RESET_WARNING_1_MS && !warning_shown) {
-                warning_shown = true;
-                ESP_LOGW(TAG, "⚠️  Factory reset in %d seconds...",
-                         (FACTORY_RESET_HOLD_TIME_MS - hold_duration) / 1000);
-            }
-
-            // Critical warning at 7 seconds
-            if (hold_duration >= FACTORY_RESET_WARNING_2_MS && !critical_warning_shown) {
-                critical_warning_shown = true;
-                ESP_LOGW(TAG, "🔴 FACTORY RESET IN %d SECONDS! Release button to cancel!",
-                         (FACTORY_RESET_HOLD_TIME_MS - hold_duration) / 1000);
-            }
+    int remaining_s = (CONFIG_BUTTON_RESET_HOLD_MS - (int)evt->hold_ms) / 1000;
+    bool reset_button = bin == 0;
+
+    switch (evt->event) {
+    case BUTTON_EVENT_PRESS:
+        if (reset_button) {
+            ESP_LOGI(TAG, "Button pressed - hold for %d seconds to factory reset",
+                     CONFIG_BUTTON_RESET_HOLD_MS / 1000);
+        }
+        reset_sleep_timer();
+        break;
 
-            // Factory reset at 10 seconds
-            if (hold_duration >= FACTORY_RESET_HOLD_TIME_MS) {
-                ESP_LOGW(TAG, "");
-                ESP_LOGW(TAG, "========================================");
-                ESP_LOGW(TAG, "🔴 FACTORY RESET TRIGGERED!");
-                ESP_LOGW(TAG, "========================================");
-                ESP_LOGW(TAG, "Clearing all provisioning data...");
-
-                // Clear all mesh storage
-                esp_err_t err = mesh_storage_clear();
-                if (err == ESP_OK) {
-                    ESP_LOGI(TAG, "✓ Provisioning data cleared");
-                } else {
-                    ESP_LOGE(TAG, "✗ Failed to clear provisioning data: %s", esp_err_to_name(err));
-                }
+    case BUTTON_EVENT_TAP:
+        ESP_LOGI(TAG, "Bin %d button pressed!", bin);
 
-                ESP_LOGW(TAG, "Restarting device in 2 seconds...");
-                vTaskDelay(pdMS_TO_TICKS(2000));
+        // Turn off location indicator (the node's, on bin 0) and the bin's indication
+        if (bin == 0 && location_indicator_active) {
+            location_indicator_active = false;
+            ESP_LOGI(TAG, "Location indicator turned off by button");
+        }
+        if (indication_active(bin)) {
+            indicate_end(bin);
+            ESP_LOGI(TAG, "Indication confirmed by button");
+        }
 
-                ESP_LOGW(TAG, "========================================");
-                ESP_LOGW(TAG, "🔄 RESTARTING...");
-                ESP_LOGW(TAG, "========================================");
+        // Report the press via Bluetooth Mesh
+        send_press_report(bin, MESH_VND_PRESS_TAP);
+        lpn_activity();
+        break;
 
-                esp_restart();
-            }
+    case BUTTON_EVENT_RESET_WARNING:
+        if (!reset_button) {
+            break;
         }
-    } else {
-        // Button is released
-        if (factory_reset_in_progress) {
-            uint32_t hold_duration = (esp_timer_get_time() / 1000) - button_hold_start;
-
-            if (hold_duration < FACTORY_RESET_HOLD_TIME_MS) {
-                // Short press (< 10 seconds)
-                if (hold_duration < 1000) {
-                    // Very short press (< 1 second) - treat as button press
-                    ESP_LOGI(TAG, "Button pressed!");
-
-                    // Turn off location indicator when button pressed
-                    if (location_indicator_active) {
-                        location_indicator_active = false;
-                        ESP_LOGI(TAG, "Location indicator turned off by button");
-                    }
-
-                    // Send button press message via Bluetooth Mesh
-                    send_button_press_message();
-
-                    reset_sleep_timer();
+        if (evt->hold_ms < CONFIG_BUTTON_RESET_CRITICAL_MS) {
+            ESP_LOGW(TAG, "⚠️  Factory reset in %d seconds...", remaining_s);
         } else {
-            // Medium press (1-10 seconds) - factory reset cancelled
-            ESP_LOGI(TAG, "Factory reset cancelled (held for %d ms)", hold_duration);
+            ESP_LOGW(TAG, "🔴 FACTORY RESET IN %d SECONDS! Release button to cancel!", remaining_s);
         }
-            }
+        break;
+
+    case BUTTON_EVENT_RELEASE:
+        // Past the first warning the reset button was held for a reset, not a pick
+        if (reset_button && evt->hold_ms >= CONFIG_BUTTON_RESET_WARNING_MS) {
+            ESP_LOGI(TAG, "Factory reset cancelled (held for %lu ms)", (unsigned long)evt->hold_ms);
+            break;
+        }
+        ESP_LOGI(TAG, "Bin %d long press (%lu ms)", bin, (unsigned long)evt->hold_ms);
+        send_press_report(bin, MESH_VND_PRESS_LONG);
+        lpn_activity();
+        break;
 
-            button_hold_start = 0;
-            factory_reset_in_progress = false;
-            warning_shown = false;
-            critical_warning_shown = false;
+    case BUTTON_EVENT_RESET_HOLD:
+        if (reset_button) {
+            factory_reset();
+        } else {
+            // No release follows the last hold stage: report it now
+            send_press_report(bin, MESH_VND_PRESS_LONG);
+            lpn_activity();
         }
+        break;
+
+    default:
+        break;
     }
 }
 
+static void handle_reset(const uint8_t *msg)
+{
+    uint16_t target = msg[0] | (msg[1] << 8);
+
+    // Any of the node's elements names the node
+    if (target < node_addr || target >= node_addr + BIN_COUNT) {
+        ESP_LOGW(TAG, "Ignoring reset for 0x%04x", target);
+        return;
+    }
+
+    ESP_LOGW(TAG, "🔴 Factory reset command received via MQTT!");
+    factory_reset();
+}
+
 /* Main Application Task */
+// Owns the button handling and the LED engine, sleeps until an event arrives
 static void app_task(void *pvParameters)
 {
+    app_evt_t evt;
+
+    led_update();
+
     while (1) {
-        // Check for factory reset (button hold) and handle button press
-        check_factory_reset();
+        if (xQueueReceive(app_queue, &evt, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
 
-        vTaskDelay(pdMS_TO_TICKS(100));
+        switch (evt.type) {
+        case APP_EVT_BUTTON:
+            handle_button_event(evt.bin, &evt.button);
+            led_update();
+            break;
+        case APP_EVT_LED_UPDATE:
+            led_update();
+            break;
+        case APP_EVT_LED_TICK:
+            led_tick(evt.bin, evt.led_gen);
+            break;
+        case APP_EVT_LED_BUDGET:
+            // Rewrite the colors shown: neopixel_set_color() applies the new dimming
+            for (uint8_t bin = 0; bin < BIN_COUNT; bin++) {
+                if (neopixel_lit & (1U << bin)) {
+                    led_write_phase(bin);
+                }
+            }
+            break;
+        case APP_EVT_LED_PATTERN_SET:
+            led_pattern_install(evt.vnd_msg);
+            break;
+        case APP_EVT_LED_PATTERN_TRIGGER:
+            led_pattern_trigger(evt.bin, evt.vnd_msg[0], evt.vnd_msg[1] != 0);
+            break;
+        case APP_EVT_LED_BRIGHTNESS_SET:
+            led_brightness_set(evt.vnd_msg[0]);
+            break;
+        case APP_EVT_INDICATE:
+            lpn_indication_received();
+            lpn_activity();
+            reset_sleep_timer();
+            indicate(evt.bin, evt.vnd_msg);
+            break;
+        case APP_EVT_INDICATE_END:
+            ESP_LOGI(TAG, "Bin %d indication timed out", evt.bin);
+            indicate_end(evt.bin);
+            break;
+        case APP_EVT_RESET:
+            handle_reset(evt.vnd_msg);
+            break;
+        case APP_EVT_LPN_FRIENDSHIP:
+            if (evt.friendship) {
+                wake_timing_mark(&wake_timing.friend_us);
+            }
+            lpn_friendship_changed(evt.friendship);
+            break;
+        case APP_EVT_LPN_POLL:
+            lpn_poll();
+            break;
+        case APP_EVT_LPN_POLL_SET:
+            lpn_policy_set(evt.vnd_msg);
+            break;
+        case APP_EVT_LPN_REPORT:
+            lpn_send_report();
+            break;
+        case APP_EVT_BATTERY:
+            battery_measure();
+            break;
+        case APP_EVT_ENERGY_REPORT:
+            energy_send_report();
+            break;
+        case APP_EVT_DEEP_SLEEP:
+            deep_sleep_enter();
+            break;
+        }
     }
 }
 
@@ -685,26 +2256,10 @@ static void generic_server_cb(esp_ble_mesh_generic_server_cb_event_t event, esp_
     case ESP_BLE_MESH_GENERIC_SERVER_STATE_CHANGE_EVT:
         ESP_LOGI(TAG, "Generic server state changed: onoff=%d", onoff_server.state.onoff);
 
-        // Check for factory reset command (onoff=2 is special value)
-        if (onoff_server.state.onoff == 2) {
-            ESP_LOGW(TAG, "🔴 Factory reset command received via MQTT!");
-            ESP_LOGW(TAG, "Clearing provisioning data and restarting...");
-
-            // Clear all provisioning data
-            mesh_storage_clear();
-
-            // Wait a moment for logs to flush
-            vTaskDelay(pdMS_TO_TICKS(500));
-
-            // Restart device
-            esp_restart();
-        }
-
-        // Update location indicator based on received state (only for normal values 0 or 1)
-        if (onoff_server.state.onoff <= 1) {
-            location_indicator_active = onoff_server.state.onoff;
-            ESP_LOGI(TAG, "Location indicator %s", location_indicator_active ? "ON" : "OFF");
-        }
+        // Update location indicator based on received state
+        location_indicator_active = onoff_server.state.onoff;
+        ESP_LOGI(TAG, "Location indicator %s", location_indicator_active ? "ON" : "OFF");
+        led_request_update();
 
         reset_sleep_timer();
         break;
@@ -714,26 +2269,10 @@ static void generic_server_cb(esp_ble_mesh_generic_server_cb_event_t event, esp_
     case ESP_BLE_MESH_GENERIC_SERVER_RECV_SET_MSG_EVT:
         ESP_LOGI(TAG, "Generic server recv set msg: onoff=%d", onoff_server.state.onoff);
 
-        // Check for factory reset command (onoff=2 is special value)
-        if (onoff_server.state.onoff == 2) {
-            ESP_LOGW(TAG, "🔴 Factory reset command received via MQTT!");
-            ESP_LOGW(TAG, "Clearing provisioning data and restarting...");
-
-            // Clear all provisioning data
-            mesh_storage_clear();
-
-            // Wait a moment for logs to flush
-            vTaskDelay(pdMS_TO_TICKS(500));
-
-            // Restart device
-            esp_restart();
-        }
-
-        // Update location indicator based on received state (only for normal values 0 or 1)
-        if (onoff_server.state.onoff <= 1) {
-            location_indicator_active = onoff_server.state.onoff;
-            ESP_LOGI(TAG, "Location indicator %s", location_indicator_active ? "ON" : "OFF");
-        }
+        // Update location indicator based on received state
+        location_indicator_active = onoff_server.state.onoff;
+        ESP_LOGI(TAG, "Location indicator %s", location_indicator_active ? "ON" : "OFF");
+        led_request_update();
 
         break;
     default:
@@ -756,7 +2295,72 @@ static void generic_client_cb(esp_ble_mesh_generic_client_cb_event_t event, esp_
     }
 }
 
+/* Vendor Model Callback */
+static void custom_model_cb(esp_ble_mesh_model_cb_event_t event, esp_ble_mesh_model_cb_param_t *param)
+{
+    if (event != ESP_BLE_MESH_MODEL_OPERATION_EVT) {
+        return;
+    }
+
+    // Every vendor command comes from the gateway: answer it there
+    if (ESP_BLE_MESH_ADDR_IS_UNICAST(param->model_operation.ctx->addr)) {
+        gateway_addr = param->model_operation.ctx->addr;
+    }
+
+    // Copy the payload and let app_task apply it; the op table checked the length
+    app_evt_t evt = {
+        .bin = param->model_operation.model - vnd_models,   // The element it was sent to
+    };
+    size_t len;
+    switch (param->model_operation.opcode) {
+    case MESH_VND_OP_LED_PATTERN_SET:
+        evt.type = APP_EVT_LED_PATTERN_SET;
+        len = MESH_VND_LED_PATTERN_SET_LEN;
+        break;
+    case MESH_VND_OP_LED_PATTERN_TRIGGER:
+        evt.type = APP_EVT_LED_PATTERN_TRIGGER;
+        len = MESH_VND_LED_PATTERN_TRIGGER_LEN;
+        break;
+    case MESH_VND_OP_LED_BRIGHTNESS_SET:
+        evt.type = APP_EVT_LED_BRIGHTNESS_SET;
+        len = MESH_VND_LED_BRIGHTNESS_SET_LEN;
+        break;
+    case MESH_VND_OP_INDICATE:
+        evt.type = APP_EVT_INDICATE;
+        len = MESH_VND_INDICATE_LEN;
+        break;
+    case MESH_VND_OP_RESET:
+        evt.type = APP_EVT_RESET;
+        len = MESH_VND_RESET_LEN;
+        break;
+    case MESH_VND_OP_LPN_POLL_SET:
+        evt.type = APP_EVT_LPN_POLL_SET;
+        len = MESH_VND_LPN_POLL_SET_LEN;
+        break;
+    default:
+        return;
+    }
+    memcpy(evt.vnd_msg, param->model_operation.msg, len);
+    xQueueSend(app_queue, &evt, 0);
+}
+
 /* Bluetooth Mesh Initialization */
+static void composition_init(void)
+{
+    for (int bin = 0; bin < BIN_COUNT; bin++) {
+        // Reports go to the primary element's publication address, whichever bin sends them
+        vnd_models[bin] = (esp_ble_mesh_model_t)ESP_BLE_MESH_VENDOR_MODEL(
+            MESH_VND_CID, MESH_VND_MODEL_ID_SERVER, vnd_op, bin == 0 ? &vnd_pub : NULL, NULL);
+        elements[bin] = (esp_ble_mesh_elem_t) {
+            .location = BIN_COUNT > 1 ? bin + 1 : 0,   // GATT namespace "first", "second", ...
+            .sig_model_count = bin == 0 ? ARRAY_SIZE(root_models) : 0,
+            .sig_models = bin == 0 ? root_models : NULL,
+            .vnd_model_count = 1,
+            .vnd_models = &vnd_models[bin],
+        };
+    }
+}
+
 static esp_err_t ble_mesh_init(void)
 {
     esp_err_t err;
@@ -765,7 +2369,9 @@ static esp_err_t ble_mesh_init(void)
     esp_ble_mesh_register_config_server_callback(config_server_cb);
     esp_ble_mesh_register_generic_server_callback(generic_server_cb);
     esp_ble_mesh_register_generic_client_callback(generic_client_cb);
+    esp_ble_mesh_register_custom_model_callback(custom_model_cb);
 
+    composition_init();
     err = esp_ble_mesh_init(&provision, &composition);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize BLE Mesh");
@@ -791,6 +2397,12 @@ void app_main(void)
 {
     esp_err_t err;
 
+    wake_timing.app_us = esp_timer_get_time();
+    boot_profile_mark("app_main");
+
+    // Deferred log first so early mesh/storage records are kept
+    dlog_init();
+
     // Set log levels for components (suppress verbose logs)
     esp_log_level_set("BT_GATT", ESP_LOG_WARN);
     esp_log_level_set("BLE_MESH", ESP_LOG_WARN);  // Only show warnings/errors (hide bearer info)
@@ -806,7 +2418,7 @@ void app_main(void)
     // Check wakeup reason
     esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
     switch (wakeup_reason) {
-        case ESP_SLEEP_WAKEUP_EXT0:
+        case ESP_SLEEP_WAKEUP_EXT1:
             ESP_LOGI(TAG, "Wakeup caused by button press");
             break;
         case ESP_SLEEP_WAKEUP_UNDEFINED:
@@ -815,14 +2427,18 @@ void app_main(void)
             break;
     }
     
+    // Account from the start of boot
+    energy_accounting_init();
+
     // Initialize Mesh Storage (NVS)
     err = mesh_storage_init();
     ESP_ERROR_CHECK(err);
 
-    // Check if already provisioned (load from NVS)
+    // Check if already provisioned: RTC memory after a deep sleep, NVS otherwise
     mesh_prov_data_t prov_data;
-    err = mesh_storage_load_prov_data(&prov_data);
-    if (err == ESP_OK) {
+    if (deep_sleep_resume()) {
+        gateway_connected = true;
+    } else if (mesh_storage_load_prov_data(&prov_data) == ESP_OK) {
         provisioned = true;
         node_addr = prov_data.node_addr;
         gateway_connected = true;
@@ -840,14 +2456,32 @@ void app_main(void)
         mesh_pub_settings_t pub_settings;
         mesh_storage_load_pub_settings("onoff_srv", &pub_settings);
         mesh_storage_load_pub_settings("onoff_cli", &pub_settings);
+        if (mesh_storage_load_pub_settings("vnd_srv", &pub_settings) == ESP_OK) {
+            report_pub = pub_settings;
+        }
+
+        // Group subscriptions (count logged by load function)
+        size_t sub_count;
+        mesh_storage_load_subscriptions("onoff_srv", NULL, 0, &sub_count);
     } else {
         ESP_LOGI(TAG, "ℹ️  Device not provisioned yet");
     }
 
     // Initialize GPIO
+    app_queue = xQueueCreate(16, sizeof(app_evt_t));
     led_init();
     neopixel_init();
-    button_init();
+    battery_monitor_init();
+    led_engine_init();
+    lpn_policy_init();
+    if (!rtc_resumed) {
+        press_queue_load();
+    }
+    button_setup();
+    deep_sleep_wake_press();
+    sleep_timer_init();
+    wake_timing_mark(&wake_timing.init_us);
+    boot_profile_mark("peripherals");
     
     // Initialize Bluetooth
     ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
@@ -876,6 +2510,7 @@ void app_main(void)
         ESP_LOGE(TAG, "Bluedroid enable failed");
         return;
     }
+    boot_profile_mark("bluetooth");
     
     // Initialize BLE Mesh
     err = ble_mesh_init();
@@ -883,6 +2518,8 @@ void app_main(void)
         ESP_LOGE(TAG, "BLE Mesh init failed");
         return;
     }
+    wake_timing_mark(&wake_timing.mesh_us);
+    boot_profile_mark("mesh_ready");
     
     // Configure Power Management for Light Sleep
     #if CONFIG_PM_ENABLE
@@ -897,23 +2534,27 @@ void app_main(void)
     } else {
         ESP_LOGI(TAG, "Power Management enabled with Light Sleep");
     }
+
+    // Let a press end a light sleep
+    err = button_enable_wakeup();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Button wakeup failed: %s", esp_err_to_name(err));
+    }
     #endif
 
     // Check if already provisioned and enable LPN if so
     if (provisioned) {
-        esp_ble_mesh_lpn_t lpn_conf = {
-            .min_queue_size = 2,
-            .poll_timeout_ms = 10000,
-            .msg_recv_window_ms = 100,
-        };
-        esp_ble_mesh_lpn_enable(&lpn_conf);
+        lpn_start();
     }
 
-    // Create LED control task
-    xTaskCreate(led_control_task, "led_control", 4096, NULL, 5, NULL);
-
-    // Create application task
+    // Create application task (button handling and LED engine)
     xTaskCreate(app_task, "app_task", 4096, NULL, 5, NULL);
 
+#if CONFIG_TASK_PROFILER_ENABLE
+    task_profiler_start(send_profile_report, NULL);
+#endif
+
+    boot_profile_mark("app_done");
+    boot_profile_report();
     ESP_LOGI(TAG, "Endpoint Node ready");
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "esp_bt.h"
@@ -17,12 +19,24 @@
 #include "esp_netif.h"
 #include "esp_http_server.h"
 #include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "lwip/ip4_addr.h"
 #include "mqtt_client.h"
 #include "cJSON.h"
 #include "led_strip.h"
 #include "driver/gpio.h"
 #include "mesh_storage.h"
+#include "button.h"
+#include "mesh_vendor.h"
+#include "deferred_log.h"
+#include "tracepoint.h"
+#include "heap_monitor.h"
+#include "nvs_wear.h"
+#include "config_snapshot.h"
+#include "task_profiler.h"
+#include "boot_profile.h"
+#include "mesh_scale.h"
 
 #define MACSTR "%02x:%02x:%02x:%02x:%02x:%02x"
 #define MAC2STR(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
@@ -31,7 +45,12 @@ static const char *TAG = "GATEWAY_NODE";
 
 /* Forward declarations */
 static void mqtt_app_start(void);
-static void publish_button_press(uint16_t src_addr);
+static void publish_button_press(uint16_t src_addr, const uint8_t *report, uint16_t len);
+static void publish_lpn_report(uint16_t src_addr, const uint8_t *data);
+static void publish_energy_report(uint16_t src_addr, const uint8_t *data);
+#if CONFIG_TASK_PROFILER_ENABLE
+static void publish_profile_report(uint16_t src_addr, const uint8_t *data, uint16_t len);
+#endif
 
 /* GPIO Configuration - Adafruit ESP32-C6 Feather */
 #define NEOPIXEL_GPIO       GPIO_NUM_9   // NeoPixel LED
@@ -40,10 +59,8 @@ static void publish_button_press(uint16_t src_addr);
 #define BUTTON_GPIO         GPIO_NUM_5   // Factory Reset button (GPIO5)
 #define BUTTON_ACTIVE_LEVEL 0            // Active LOW
 
-/* Factory Reset Configuration */
-#define FACTORY_RESET_HOLD_TIME_MS  10000  // Hold button for 10 seconds to factory reset
-#define FACTORY_RESET_WARNING_TIME_MS 3000  // Warning at 3 seconds
-#define FACTORY_RESET_CRITICAL_TIME_MS 7000 // Critical warning at 7 seconds
+// The LED task creates the RMT device for the NeoPixel before it loops, so it needs more than its loop does
+#define LED_TASK_STACK_SIZE 3072
 
 /* WiFi AP Configuration */
 #define WIFI_AP_SSID "Smart-Storage-Gateway"
@@ -53,6 +70,7 @@ static void publish_button_press(uint16_t src_addr);
 
 /* WiFi STA Configuration */
 #define WIFI_STA_MAX_RETRY 5
+#define AP_SHUTDOWN_DELAY_MS 2000    // AP stays up this long after the STA gets an IP
 #define MAX_SCAN_RESULTS 20
 
 /* NVS Storage Keys for WiFi */
@@ -66,10 +84,26 @@ static void publish_button_press(uint16_t src_addr);
 #define MQTT_TOPIC_STATUS "smart-storage/status"
 #define MQTT_TOPIC_COMMAND "smart-storage/command"
 #define MQTT_TOPIC_BUTTON "smart-storage/button"
+#define MQTT_TOPIC_PROFILE "smart-storage/diag/profile"
+#define MQTT_TOPIC_LPN "smart-storage/diag/lpn"
+#define MQTT_TOPIC_ENERGY "smart-storage/diag/energy"
 
 /* Bluetooth Mesh Configuration */
 #define CID_ESP        0x02E5
 
+/*
+ * Boot targets, in ms since start-up: the mesh relays and serves endpoint
+ * traffic, and the MQTT command topic is subscribed. The MQTT target
+ * assumes saved credentials and an access point and broker that answer
+ * promptly; association and DHCP take most of it.
+ */
+#define BOOT_TARGET_MESH_MS     1000
+#define BOOT_TARGET_MQTT_MS     3000
+
+// The scale profile in sdkconfig.defaults sizes these tables for 500+ endpoints
+_Static_assert(MESH_SCALE_RAM_CONFIG <= MESH_SCALE_RAM_BUDGET,
+               "BLE Mesh replay list, cache, Friend and segmentation settings exceed MESH_SCALE_RAM_BUDGET");
+
 /* WiFi scan result storage */
 typedef struct {
     char ssid[33];
@@ -90,6 +124,12 @@ static int sta_retry_count = 0;
 static wifi_scan_result_t scan_results[MAX_SCAN_RESULTS];
 static uint16_t scan_result_count = 0;
 static bool scan_in_progress = false;
+static QueueHandle_t button_queue = NULL;
+static esp_timer_handle_t ap_shutdown_timer = NULL;
+
+// The command topic is subscribed once both are up, by whichever comes last
+static atomic_bool mesh_up = false;
+static atomic_bool mqtt_up = false;
 
 /* BLE Mesh Variables */
 static bool provisioned = false;
@@ -114,8 +154,25 @@ static esp_ble_mesh_model_t root_models[] = {
     ESP_BLE_MESH_MODEL_GEN_ONOFF_SRV(&onoff_pub, &onoff_server),
 };
 
+// Vendor client: sends indications, LED patterns, resets and poll policies to endpoints, receives their press and diagnostic reports
+static esp_ble_mesh_model_op_t vnd_op[] = {
+    ESP_BLE_MESH_MODEL_OP(MESH_VND_OP_PRESS_REPORT, MESH_VND_PRESS_REPORT_MIN_LEN),
+    ESP_BLE_MESH_MODEL_OP(MESH_VND_OP_LPN_STATUS, MESH_VND_LPN_STATUS_LEN),
+    ESP_BLE_MESH_MODEL_OP(MESH_VND_OP_ENERGY_STATUS, MESH_VND_ENERGY_STATUS_LEN),
+#if CONFIG_TASK_PROFILER_ENABLE
+    ESP_BLE_MESH_MODEL_OP(MESH_VND_OP_PROFILE_STATUS, 2),
+#endif
+    ESP_BLE_MESH_MODEL_OP_END,
+};
+
+static esp_ble_mesh_client_t vendor_client;
+
+static esp_ble_mesh_model_t vnd_models[] = {
+    ESP_BLE_MESH_VENDOR_MODEL(MESH_VND_CID, MESH_VND_MODEL_ID_CLIENT, vnd_op, NULL, &vendor_client),
+};
+
 static esp_ble_mesh_elem_t elements[] = {
-    ESP_BLE_MESH_ELEMENT(0, root_models, ESP_BLE_MESH_MODEL_NONE),
+    ESP_BLE_MESH_ELEMENT(0, root_models, vnd_models),
 };
 
 static esp_ble_mesh_comp_t composition = {
@@ -138,6 +195,7 @@ static esp_ble_mesh_prov_t provision = {
 /* WiFi NVS Storage Functions */
 static esp_err_t wifi_save_credentials(const char *ssid, const char *password)
 {
+    TRACE_SCOPE("nvs_wifi_save");
     nvs_handle_t nvs_handle;
     esp_err_t err;
 
@@ -186,6 +244,7 @@ static esp_err_t wifi_save_credentials(const char *ssid, const char *password)
 
 static esp_err_t wifi_load_credentials(char *ssid, size_t ssid_len, char *password, size_t pass_len)
 {
+    TRACE_SCOPE("nvs_wifi_load");
     nvs_handle_t nvs_handle;
     esp_err_t err;
 
@@ -229,6 +288,7 @@ static esp_err_t wifi_load_credentials(char *ssid, size_t ssid_len, char *passwo
 
 static esp_err_t wifi_clear_credentials(void)
 {
+    TRACE_SCOPE("nvs_wifi_clear");
     nvs_handle_t nvs_handle;
     esp_err_t err;
 
@@ -349,7 +409,6 @@ static esp_err_t wifi_scan_start(void)
             ESP_LOGE(TAG, "Failed to switch to APSTA mode: %s", esp_err_to_name(err));
             return err;
         }
-        vTaskDelay(pdMS_TO_TICKS(100));  // Wait for mode switch
     }
 
     scan_in_progress = true;
@@ -383,6 +442,10 @@ static void led_control_task(void *pvParameters)
     bool blink_state = false;
     uint8_t color_toggle = 0;  // 0 = GREEN, 1 = BLUE
 
+    // Here rather than in app_main, so the power-up wait is off the boot path
+    neopixel_init();
+    ESP_LOGI(TAG, "NeoPixel initialized OK");
+
     while (1) {
         if (sta_connected) {
             // Connected to external WiFi - Solid GREEN
@@ -641,6 +704,7 @@ static const char index_html_part3[] =
 // HTTP GET handler for root
 static esp_err_t root_handler(httpd_req_t *req)
 {
+    TRACE_SCOPE("http_root");
     httpd_resp_set_type(req, "text/html");
     httpd_resp_send_chunk(req, index_html_part1, strlen(index_html_part1));
     httpd_resp_send_chunk(req, index_html_part2, strlen(index_html_part2));
@@ -649,9 +713,30 @@ static esp_err_t root_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// Format the first subscriptions of a model as "0xC000,0xC001,..."; buf is left as is if none
+static void format_subscriptions(const char *model_id, char *buf, size_t buf_len)
+{
+    uint16_t addrs[16];
+    size_t count;
+    if (mesh_storage_load_subscriptions(model_id, addrs, 16, &count) != ESP_OK) {
+        return;
+    }
+
+    size_t shown = count < 16 ? count : 16;
+    size_t len = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < shown && len < buf_len; i++) {
+        len += snprintf(buf + len, buf_len - len, "%s0x%04X", i > 0 ? "," : "", addrs[i]);
+    }
+    if (count > shown && len < buf_len) {
+        snprintf(buf + len, buf_len - len, " (+%u)", (unsigned)(count - shown));
+    }
+}
+
 // HTTP GET handler for status API
 static esp_err_t status_handler(httpd_req_t *req)
 {
+    TRACE_SCOPE("http_status");
     char response[2048];
     esp_netif_ip_info_t ip_info;
     char sta_ip_str[16] = "-";
@@ -730,16 +815,7 @@ static esp_err_t status_handler(httpd_req_t *req)
             snprintf(cli_pub_addr, sizeof(cli_pub_addr), "0x%04X", cli_pub.publish_addr);
         }
 
-        mesh_subscription_t cli_sub;
-        if (mesh_storage_load_subscription("onoff_cli", &cli_sub) == ESP_OK) {
-            char temp[128] = "";
-            for (int i = 0; i < cli_sub.sub_count; i++) {
-                char addr[16];
-                snprintf(addr, sizeof(addr), "%s0x%04X", i > 0 ? "," : "", cli_sub.sub_addrs[i]);
-                strncat(temp, addr, sizeof(temp) - strlen(temp) - 1);
-            }
-            strncpy(cli_sub_addrs, temp, sizeof(cli_sub_addrs) - 1);
-        }
+        format_subscriptions("onoff_cli", cli_sub_addrs, sizeof(cli_sub_addrs));
 
         // Load Generic OnOff Server binding and subscription
         mesh_model_binding_t srv_binding;
@@ -753,16 +829,7 @@ static esp_err_t status_handler(httpd_req_t *req)
             snprintf(srv_pub_addr, sizeof(srv_pub_addr), "0x%04X", srv_pub.publish_addr);
         }
 
-        mesh_subscription_t srv_sub;
-        if (mesh_storage_load_subscription("onoff_srv", &srv_sub) == ESP_OK) {
-            char temp[128] = "";
-            for (int i = 0; i < srv_sub.sub_count; i++) {
-                char addr[16];
-                snprintf(addr, sizeof(addr), "%s0x%04X", i > 0 ? "," : "", srv_sub.sub_addrs[i]);
-                strncat(temp, addr, sizeof(temp) - strlen(temp) - 1);
-            }
-            strncpy(srv_sub_addrs, temp, sizeof(srv_sub_addrs) - 1);
-        }
+        format_subscriptions("onoff_srv", srv_sub_addrs, sizeof(srv_sub_addrs));
     }
 
     snprintf(response, sizeof(response),
@@ -799,6 +866,7 @@ static esp_err_t status_handler(httpd_req_t *req)
 // HTTP POST handler for clear provision (BLE Mesh only)
 static esp_err_t clear_provision_handler(httpd_req_t *req)
 {
+    TRACE_SCOPE("http_clear_provision");
     ESP_LOGW(TAG, "🔴 Clear BLE Mesh provision requested via Web UI");
 
     // Clear custom mesh storage
@@ -833,6 +901,7 @@ static esp_err_t clear_provision_handler(httpd_req_t *req)
 // HTTP POST handler for clear WiFi credentials
 static esp_err_t clear_wifi_handler(httpd_req_t *req)
 {
+    TRACE_SCOPE("http_clear_wifi");
     ESP_LOGW(TAG, "🔴 Clear WiFi credentials requested via Web UI");
 
     // Clear WiFi credentials only
@@ -850,6 +919,7 @@ static esp_err_t clear_wifi_handler(httpd_req_t *req)
     // Restart after 2 seconds
     ESP_LOGW(TAG, "Restarting device in 2 seconds...");
     vTaskDelay(pdMS_TO_TICKS(2000));
+    mesh_storage_flush();
     esp_restart();
 
     return ESP_OK;
@@ -858,6 +928,7 @@ static esp_err_t clear_wifi_handler(httpd_req_t *req)
 // HTTP GET handler for WiFi scan
 static esp_err_t scan_handler(httpd_req_t *req)
 {
+    TRACE_SCOPE("http_scan");
     // Start scan
     esp_err_t err = wifi_scan_start();
 
@@ -875,6 +946,7 @@ static esp_err_t scan_handler(httpd_req_t *req)
 // HTTP GET handler for scan results
 static esp_err_t scan_results_handler(httpd_req_t *req)
 {
+    TRACE_SCOPE("http_scan_results");
     if (scan_in_progress) {
         httpd_resp_set_type(req, "application/json");
         httpd_resp_send(req, "{\"status\":\"scanning\",\"networks\":[]}", -1);
@@ -916,6 +988,7 @@ static esp_err_t scan_results_handler(httpd_req_t *req)
 // HTTP POST handler for WiFi connect
 static esp_err_t connect_handler(httpd_req_t *req)
 {
+    TRACE_SCOPE("http_connect");
     char content[256];
     int ret = httpd_req_recv(req, content, sizeof(content) - 1);
 
@@ -990,7 +1063,6 @@ static esp_err_t connect_handler(httpd_req_t *req)
             httpd_resp_send(req, "{\"error\":\"Failed to switch WiFi mode\"}", -1);
             return ESP_FAIL;
         }
-        vTaskDelay(pdMS_TO_TICKS(100));  // Wait for mode switch
     }
 
     esp_wifi_set_config(WIFI_IF_STA, &sta_config);
@@ -1013,6 +1085,328 @@ static esp_err_t connect_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+#if CONFIG_TASK_PROFILER_ENABLE
+// HTTP GET handler for task profiler results
+static esp_err_t profiler_handler(httpd_req_t *req)
+{
+    TRACE_SCOPE("http_profiler");
+    task_profiler_snapshot_t *snapshot = malloc(sizeof(task_profiler_snapshot_t));
+    char *response = malloc(4096);
+    if (!snapshot || !response) {
+        free(snapshot);
+        free(response);
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_send(req, "{\"error\":\"Out of memory\"}", -1);
+        return ESP_FAIL;
+    }
+
+    if (task_profiler_get_snapshot(snapshot) != ESP_OK) {
+        free(snapshot);
+        free(response);
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_send(req, "{\"status\":\"sampling\",\"tasks\":[]}", -1);
+        return ESP_OK;
+    }
+
+    int offset = snprintf(response, 4096, "{\"status\":\"ok\",\"window_ms\":%lu,\"samples\":%lu,\"tasks\":[",
+                          (unsigned long)snapshot->window_ms, (unsigned long)snapshot->sample_count);
+
+    for (size_t i = 0; i < snapshot->task_count && offset < 4000; i++) {
+        const task_profiler_entry_t *t = &snapshot->tasks[i];
+        offset += snprintf(response + offset, 4096 - offset,
+                           "%s{\"name\":\"%s\",\"prio\":%u,\"cpu\":%u.%u,\"stack_free\":%lu}",
+                           i > 0 ? "," : "",
+                           t->name,
+                           t->priority,
+                           t->cpu_permille / 10, t->cpu_permille % 10,
+                           (unsigned long)t->stack_hwm_bytes);
+    }
+
+    snprintf(response + offset, 4096 - offset, "]}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, -1);
+    free(response);
+    free(snapshot);
+    return ESP_OK;
+}
+#endif
+
+// HTTP GET handler for the most recent deferred log records
+static esp_err_t log_handler(httpd_req_t *req)
+{
+    TRACE_SCOPE("http_log");
+    const size_t max_records = 48;
+    const size_t response_len = 8192;
+    dlog_record_t *records = malloc(max_records * sizeof(dlog_record_t));
+    char *response = malloc(response_len);
+    if (!records || !response) {
+        free(records);
+        free(response);
+        httpd_resp_set_status(req, "500 Internal Server Error");
+        httpd_resp_send(req, "{\"error\":\"Out of memory\"}", -1);
+        return ESP_FAIL;
+    }
+
+    size_t count = dlog_peek_recent(records, max_records);
+    int offset = snprintf(response, response_len, "{\"records\":[");
+
+    for (size_t i = 0; i < count && offset < (int)response_len - 256; i++) {
+        char msg[128];
+        dlog_format(&records[i], msg, sizeof(msg));
+
+        // Replace anything that would need escaping instead of growing the message
+        for (char *c = msg; *c; c++) {
+            if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) {
+                *c = '\'';
+            }
+        }
+
+        offset += snprintf(response + offset, response_len - offset,
+                           "%s{\"t\":%lu,\"level\":\"%c\",\"tag\":\"%s\",\"msg\":\"%s\"}",
+                           i > 0 ? "," : "",
+                           (unsigned long)(records[i].timestamp_us / 1000),
+                           dlog_level_char(records[i].level),
+                           records[i].tag,
+                           msg);
+    }
+
+    snprintf(response + offset, response_len - offset, "]}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, -1);
+    free(response);
+    free(records);
+    return ESP_OK;
+}
+
+#if CONFIG_HEAP_MONITOR_ENABLE
+// HTTP GET handler for heap usage, fragmentation trend and attribution
+static esp_err_t heap_handler(httpd_req_t *req)
+{
+    TRACE_SCOPE("http_heap");
+    heap_monitor_report_t report;
+    char response[1024];
+
+    if (heap_monitor_get_report(&report) != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "{\"error\":\"Heap monitor not running\"}", -1);
+        return ESP_FAIL;
+    }
+
+    int offset = snprintf(response, sizeof(response),
+                          "{\"uptime_s\":%lu,\"free\":%lu,\"min_free\":%lu,\"largest_block\":%lu,"
+                          "\"fragmentation_pct\":%u,\"samples\":%lu,\"free_trend_bph\":%ld,"
+                          "\"largest_trend_bph\":%ld,\"hours_to_exhaustion\":%lu,"
+                          "\"untracked_allocs\":%lu,\"subsystems\":{",
+                          (unsigned long)report.uptime_s, (unsigned long)report.free_bytes,
+                          (unsigned long)report.min_free_bytes, (unsigned long)report.largest_block,
+                          report.fragmentation_pct, (unsigned long)report.sample_count,
+                          (long)report.free_trend_bph, (long)report.largest_trend_bph,
+                          (unsigned long)report.hours_to_exhaustion,
+                          (unsigned long)report.untracked_allocs);
+
+    for (int i = 0; i < HEAP_SUBSYS_MAX; i++) {
+        const heap_subsys_stats_t *st = &report.subsys[i];
+        offset += snprintf(response + offset, sizeof(response) - offset,
+                           "%s\"%s\":{\"live\":%lu,\"count\":%lu,\"peak\":%lu,\"allocs\":%lu}",
+                           i > 0 ? "," : "", heap_monitor_subsys_name(i),
+                           (unsigned long)st->live_bytes, (unsigned long)st->live_count,
+                           (unsigned long)st->peak_bytes, (unsigned long)st->alloc_count);
+    }
+    snprintf(response + offset, sizeof(response) - offset, "}}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, -1);
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_NVS_WEAR_ENABLE
+// HTTP GET handler for NVS writes per key and the flash lifetime projection
+static esp_err_t nvs_wear_handler(httpd_req_t *req)
+{
+    TRACE_SCOPE("http_nvs_wear");
+    nvs_wear_report_t report;
+    nvs_wear_key_stats_t keys[16];
+    char response[2048];
+
+    if (nvs_wear_get_report(&report) != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "{\"error\":\"NVS stats unavailable\"}", -1);
+        return ESP_FAIL;
+    }
+    size_t key_count = nvs_wear_get_keys(keys, 16);
+
+    int offset = snprintf(response, sizeof(response),
+                          "{\"uptime_s\":%lu,\"writes\":%lu,\"entries\":%lu,\"erases\":%lu,"
+                          "\"commits\":%lu,\"untracked_writes\":%lu,\"used_entries\":%lu,"
+                          "\"free_entries\":%lu,\"total_entries\":%lu,\"namespaces\":%lu,"
+                          "\"entries_per_hour\":%lu,\"amplification_pct\":%lu,\"lifetime_days\":%lu,"
+                          "\"seq_store_rate\":%d,\"rpl_store_timeout_s\":%d,\"keys\":[",
+                          (unsigned long)report.uptime_s, (unsigned long)report.writes,
+                          (unsigned long)report.entries, (unsigned long)report.erases,
+                          (unsigned long)report.commits, (unsigned long)report.untracked_writes,
+                          (unsigned long)report.used_entries, (unsigned long)report.free_entries,
+                          (unsigned long)report.total_entries, (unsigned long)report.namespace_count,
+                          (unsigned long)report.entries_per_hour, (unsigned long)report.amplification_pct,
+                          (unsigned long)report.lifetime_days,
+                          CONFIG_BLE_MESH_SEQ_STORE_RATE, CONFIG_BLE_MESH_RPL_STORE_TIMEOUT);
+
+    for (size_t i = 0; i < key_count && offset < (int)sizeof(response); i++) {
+        offset += snprintf(response + offset, sizeof(response) - offset,
+                           "%s{\"ns\":\"%s\",\"key\":\"%s\",\"writes\":%lu,\"entries\":%lu,\"erases\":%lu}",
+                           i > 0 ? "," : "", keys[i].namespace_name, keys[i].key,
+                           (unsigned long)keys[i].writes, (unsigned long)keys[i].entries,
+                           (unsigned long)keys[i].erases);
+    }
+    if (offset < (int)sizeof(response)) {
+        snprintf(response + offset, sizeof(response) - offset, "]}");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, -1);
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_SNAPSHOT_ENABLE
+// Everything a replacement gateway needs: mesh_storage, the BLE Mesh stack and WiFi credentials
+static const char *const snapshot_namespaces[] = {
+    MESH_NVS_NAMESPACE, SNAPSHOT_BLE_MESH_NAMESPACE, NVS_NAMESPACE,
+};
+#define SNAPSHOT_NAMESPACE_COUNT (sizeof(snapshot_namespaces) / sizeof(snapshot_namespaces[0]))
+
+static bool snapshot_request_authorized(httpd_req_t *req)
+{
+    char auth[128];
+    if (httpd_req_get_hdr_value_str(req, "Authorization", auth, sizeof(auth)) == ESP_OK &&
+        config_snapshot_authorized(auth)) {
+        return true;
+    }
+    ESP_LOGW(TAG, "Snapshot request refused: bad or missing token");
+    httpd_resp_set_status(req, "401 Unauthorized");
+    httpd_resp_send(req, "{\"error\":\"Unauthorized\"}", -1);
+    return false;
+}
+
+// HTTP GET handler exporting the gateway configuration as a signed snapshot
+static esp_err_t snapshot_export_handler(httpd_req_t *req)
+{
+    TRACE_SCOPE("http_snapshot_export");
+    if (!snapshot_request_authorized(req)) {
+        return ESP_FAIL;
+    }
+
+    // Pending mesh_storage saves belong in the snapshot
+    mesh_storage_flush();
+
+    uint8_t *blob = NULL;
+    size_t len = 0;
+    esp_err_t err = config_snapshot_export(snapshot_namespaces, SNAPSHOT_NAMESPACE_COUNT, &blob, &len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Snapshot export failed: %s", esp_err_to_name(err));
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "{\"error\":\"Snapshot export failed\"}", -1);
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"gateway-snapshot.bin\"");
+    err = httpd_resp_send(req, (const char *)blob, len);
+    free(blob);
+    return err;
+}
+
+/*
+ * HTTP POST handler restoring a snapshot onto a spare gateway. Only an
+ * unprovisioned gateway accepts one: a provisioned BLE Mesh stack would
+ * keep writing its own state over the restored settings.
+ */
+static esp_err_t snapshot_import_handler(httpd_req_t *req)
+{
+    TRACE_SCOPE("http_snapshot_import");
+    if (!snapshot_request_authorized(req)) {
+        return ESP_FAIL;
+    }
+    if (provisioned) {
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_send(req, "{\"error\":\"Gateway is provisioned, clear it first\"}", -1);
+        return ESP_FAIL;
+    }
+    if (req->content_len == 0 || req->content_len > CONFIG_SNAPSHOT_MAX_SIZE) {
+        httpd_resp_set_status(req, "413 Payload Too Large");
+        httpd_resp_send(req, "{\"error\":\"Snapshot size out of range\"}", -1);
+        return ESP_FAIL;
+    }
+
+    uint8_t *blob = malloc(req->content_len);
+    if (blob == NULL) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "{\"error\":\"Out of memory\"}", -1);
+        return ESP_FAIL;
+    }
+    size_t received = 0;
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, (char *)blob + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (ret <= 0) {
+            free(blob);
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+
+    size_t entries = 0;
+    esp_err_t err = config_snapshot_import(snapshot_namespaces, SNAPSHOT_NAMESPACE_COUNT,
+                                           blob, received, &entries);
+    free(blob);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Snapshot import failed: %s", esp_err_to_name(err));
+        httpd_resp_set_status(req, err == ESP_ERR_INVALID_CRC ? "403 Forbidden" : "400 Bad Request");
+        httpd_resp_send(req, "{\"error\":\"Snapshot rejected\"}", -1);
+        return ESP_FAIL;
+    }
+
+    char response[96];
+    snprintf(response, sizeof(response), "{\"status\":\"ok\",\"entries\":%u}", (unsigned)entries);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, -1);
+
+    // mesh_storage and the BLE Mesh stack load the restored state at boot
+    ESP_LOGW(TAG, "Snapshot restored, restarting in 2 seconds...");
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    esp_restart();
+
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_TRACEPOINT_ENABLE
+static esp_err_t trace_write_chunk(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+// HTTP GET handler exporting the trace buffer as Chrome trace JSON
+static esp_err_t trace_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"gateway-trace.json\"");
+
+    esp_err_t err = tracepoint_export_chrome(trace_write_chunk, req);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Trace export failed: %s", esp_err_to_name(err));
+    }
+
+    // Terminate the chunked response
+    httpd_resp_send_chunk(req, NULL, 0);
+    return err;
+}
+#endif
+
 static const httpd_uri_t uri_root = {
     .uri       = "/",
     .method    = HTTP_GET,
@@ -1062,12 +1456,72 @@ static const httpd_uri_t uri_clear_wifi = {
     .user_ctx  = NULL
 };
 
+static const httpd_uri_t uri_log = {
+    .uri       = "/api/log",
+    .method    = HTTP_GET,
+    .handler   = log_handler,
+    .user_ctx  = NULL
+};
+
+#if CONFIG_HEAP_MONITOR_ENABLE
+static const httpd_uri_t uri_heap = {
+    .uri       = "/api/heap",
+    .method    = HTTP_GET,
+    .handler   = heap_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#if CONFIG_NVS_WEAR_ENABLE
+static const httpd_uri_t uri_nvs_wear = {
+    .uri       = "/api/nvs_wear",
+    .method    = HTTP_GET,
+    .handler   = nvs_wear_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#if CONFIG_SNAPSHOT_ENABLE
+static const httpd_uri_t uri_snapshot_export = {
+    .uri       = "/api/snapshot",
+    .method    = HTTP_GET,
+    .handler   = snapshot_export_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t uri_snapshot_import = {
+    .uri       = "/api/snapshot",
+    .method    = HTTP_POST,
+    .handler   = snapshot_import_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#if CONFIG_TRACEPOINT_ENABLE
+static const httpd_uri_t uri_trace = {
+    .uri       = "/api/trace",
+    .method    = HTTP_GET,
+    .handler   = trace_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#if CONFIG_TASK_PROFILER_ENABLE
+static const httpd_uri_t uri_profiler = {
+    .uri       = "/api/profiler",
+    .method    = HTTP_GET,
+    .handler   = profiler_handler,
+    .user_ctx  = NULL
+};
+#endif
+
 // Start web server
 static esp_err_t start_webserver(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
     config.stack_size = 8192;
+    config.max_uri_handlers = 16;
 
     ESP_LOGI(TAG, "Starting web server on port %d", config.server_port);
 
@@ -1079,6 +1533,23 @@ static esp_err_t start_webserver(void)
         httpd_register_uri_handler(server, &uri_connect);
         httpd_register_uri_handler(server, &uri_clear_provision);
         httpd_register_uri_handler(server, &uri_clear_wifi);
+        httpd_register_uri_handler(server, &uri_log);
+#if CONFIG_TRACEPOINT_ENABLE
+        httpd_register_uri_handler(server, &uri_trace);
+#endif
+#if CONFIG_HEAP_MONITOR_ENABLE
+        httpd_register_uri_handler(server, &uri_heap);
+#endif
+#if CONFIG_NVS_WEAR_ENABLE
+        httpd_register_uri_handler(server, &uri_nvs_wear);
+#endif
+#if CONFIG_TASK_PROFILER_ENABLE
+        httpd_register_uri_handler(server, &uri_profiler);
+#endif
+#if CONFIG_SNAPSHOT_ENABLE
+        httpd_register_uri_handler(server, &uri_snapshot_export);
+        httpd_register_uri_handler(server, &uri_snapshot_import);
+#endif
         ESP_LOGI(TAG, "✅ Web server started successfully");
         return ESP_OK;
     }
@@ -1147,6 +1618,9 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         sta_connected = true;
+        if (boot_profile_get_ms("got_ip") < 0) {
+            boot_profile_mark("got_ip");
+        }
         wifi_connected = true;
         sta_retry_count = 0;
 
@@ -1165,18 +1639,27 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "🚀 Starting MQTT client...");
         mqtt_app_start();
 
-        // Shutdown AP mode after successful STA connection
+        // Shutdown AP mode after successful STA connection, without holding up the event loop
         if (ap_active) {
-            ESP_LOGI(TAG, "🛑 Shutting down AP mode in 2 seconds...");
+            ESP_LOGI(TAG, "🛑 Shutting down AP mode in %d seconds...", AP_SHUTDOWN_DELAY_MS / 1000);
             ESP_LOGI(TAG, "   (AP will no longer be needed)");
-            vTaskDelay(pdMS_TO_TICKS(2000));  // Give clients time to see the status
-            esp_wifi_set_mode(WIFI_MODE_STA);
-            ap_active = false;
-            ESP_LOGI(TAG, "🛑 AP mode disabled - Gateway now in STA-only mode");
+            esp_timer_stop(ap_shutdown_timer);
+            esp_timer_start_once(ap_shutdown_timer, (uint64_t)AP_SHUTDOWN_DELAY_MS * 1000);
         }
     }
 }
 
+// Runs AP_SHUTDOWN_DELAY_MS after the STA got an IP, giving AP clients time to see the status
+static void ap_shutdown_callback(void *arg)
+{
+    if (!sta_connected || !ap_active) {
+        return;     // Lost the STA link meanwhile: keep the AP for reconfiguration
+    }
+    esp_wifi_set_mode(WIFI_MODE_STA);
+    ap_active = false;
+    ESP_LOGI(TAG, "🛑 AP mode disabled - Gateway now in STA-only mode");
+}
+
 // Initialize WiFi in AP mode (will switch to APSTA when user connects to external WiFi)
 static void wifi_init_ap(void)
 {
@@ -1207,6 +1690,12 @@ static void wifi_init_ap(void)
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL));
 
+    const esp_timer_create_args_t ap_shutdown_args = {
+        .callback = ap_shutdown_callback,
+        .name = "ap_shutdown",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&ap_shutdown_args, &ap_shutdown_timer));
+
     // Configure AP
     wifi_config_t ap_config = {
         .ap = {
@@ -1243,103 +1732,93 @@ static void wifi_init_ap(void)
 }
 
 /* Factory Reset Task */
-static void factory_reset_task(void *pvParameters)
+// Runs in the esp_timer task: hand the event to factory_reset_task
+static void button_event_cb(const button_evt_t *evt, void *arg)
 {
-    uint32_t button_hold_start = 0;
-    bool factory_reset_in_progress = false;
-    bool warning_shown = false;
-    bool critical_warning_shown = false;
+    xQueueSend(button_queue, evt, 0);
+}
 
-    while (1) {
-        // Read button state (active LOW)
-        int button_state = gpio_get_level(BUTTON_GPIO);
-
-        if (button_state == BUTTON_ACTIVE_LEVEL) {
-            // Button is pressed
-            if (button_hold_start == 0) {
-                // Button just pressed
-                button_hold_start = esp_timer_get_time() / 1000; // Convert to ms
-                factory_reset_in_progress = true;
-                warning_shown = false;
-                critical_warning_shown = false;
-                ESP_LOGI(TAG, "Button hold detected - hold for %d seconds to factory reset",
-                         FACTORY_RESET_HOLD_TIME_MS / 1000);
-            } else {
-                // Button is being held
-                uint32_t hold_duration = (esp_timer_get_time() / 1000) - button_hold_start;
-
-                // Warning at 3 seconds
-                if (hold_duration >= FACTORY_RESET_WARNING_TIME_MS && !warning_shown) {
-                    warning_shown = true;
-                    ESP_LOGW(TAG, "⚠️  Factory reset in %d seconds...",
-                             (FACTORY_RESET_HOLD_TIME_MS - hold_duration) / 1000);
-                }
+static void factory_reset(void)
+{
+    ESP_LOGW(TAG, "");
+    ESP_LOGW(TAG, "========================================");
+    ESP_LOGW(TAG, "🔴 FACTORY RESET TRIGGERED!");
+    ESP_LOGW(TAG, "========================================");
+    ESP_LOGW(TAG, "Clearing all provisioning data...");
 
-                // Critical warning at 7 seconds
-                if (hold_duration >= FACTORY_RESET_CRITICAL_TIME_MS && !critical_warning_shown) {
-                    critical_warning_shown = true;
-                    ESP_LOGW(TAG, "🔴 FACTORY RESET IN %d SECONDS! Release button to cancel!",
-                             (FACTORY_RESET_HOLD_TIME_MS - hold_duration) / 1000);
-                }
+    // Clear custom mesh storage
+    esp_err_t err = mesh_storage_clear();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ Custom mesh storage cleared");
+    } else {
+        ESP_LOGE(TAG, "✗ Failed to clear custom mesh storage: %s", esp_err_to_name(err));
+    }
 
-                // Factory reset at 10 seconds
-                if (hold_duration >= FACTORY_RESET_HOLD_TIME_MS) {
-                    ESP_LOGW(TAG, "");
-                    ESP_LOGW(TAG, "========================================");
-                    ESP_LOGW(TAG, "🔴 FACTORY RESET TRIGGERED!");
-                    ESP_LOGW(TAG, "========================================");
-                    ESP_LOGW(TAG, "Clearing all provisioning data...");
-
-                    // Clear custom mesh storage
-                    esp_err_t err = mesh_storage_clear();
-                    if (err == ESP_OK) {
-                        ESP_LOGI(TAG, "✓ Custom mesh storage cleared");
-                    } else {
-                        ESP_LOGE(TAG, "✗ Failed to clear custom mesh storage: %s", esp_err_to_name(err));
-                    }
+    // Reset BLE Mesh stack (this clears ESP-IDF internal BLE Mesh NVS)
+    ESP_LOGW(TAG, "Resetting BLE Mesh stack...");
+    err = esp_ble_mesh_node_local_reset();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ BLE Mesh stack reset successfully");
+    } else {
+        ESP_LOGE(TAG, "✗ Failed to reset BLE Mesh stack: %s", esp_err_to_name(err));
+    }
 
-                    // Reset BLE Mesh stack (this clears ESP-IDF internal BLE Mesh NVS)
-                    ESP_LOGW(TAG, "Resetting BLE Mesh stack...");
-                    err = esp_ble_mesh_node_local_reset();
-                    if (err == ESP_OK) {
-                        ESP_LOGI(TAG, "✓ BLE Mesh stack reset successfully");
-                    } else {
-                        ESP_LOGE(TAG, "✗ Failed to reset BLE Mesh stack: %s", esp_err_to_name(err));
-                    }
+    // Clear WiFi credentials
+    err = wifi_clear_credentials();
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "✓ WiFi credentials cleared");
+    } else {
+        ESP_LOGE(TAG, "✗ Failed to clear WiFi credentials: %s", esp_err_to_name(err));
+    }
 
-                    // Clear WiFi credentials
-                    err = wifi_clear_credentials();
-                    if (err == ESP_OK) {
-                        ESP_LOGI(TAG, "✓ WiFi credentials cleared");
-                    } else {
-                        ESP_LOGE(TAG, "✗ Failed to clear WiFi credentials: %s", esp_err_to_name(err));
-                    }
+    ESP_LOGW(TAG, "Restarting device in 2 seconds...");
+    vTaskDelay(pdMS_TO_TICKS(2000));
 
-                    ESP_LOGW(TAG, "Restarting device in 2 seconds...");
-                    vTaskDelay(pdMS_TO_TICKS(2000));
+    ESP_LOGW(TAG, "========================================");
+    ESP_LOGW(TAG, "🔄 RESTARTING...");
+    ESP_LOGW(TAG, "========================================");
 
-                    ESP_LOGW(TAG, "========================================");
-                    ESP_LOGW(TAG, "🔄 RESTARTING...");
-                    ESP_LOGW(TAG, "========================================");
+    esp_restart();
+}
 
-                    esp_restart();
-                }
-            }
-        } else {
-            // Button is released
-            if (factory_reset_in_progress) {
-                uint32_t hold_duration = (esp_timer_get_time() / 1000) - button_hold_start;
-                if (hold_duration < FACTORY_RESET_HOLD_TIME_MS) {
-                    ESP_LOGI(TAG, "Factory reset cancelled (held for %d ms)", hold_duration);
-                }
-                button_hold_start = 0;
-                factory_reset_in_progress = false;
-                warning_shown = false;
-                critical_warning_shown = false;
-            }
+static void factory_reset_task(void *pvParameters)
+{
+    button_evt_t evt;
+
+    // Sleeps until the button driver reports something
+    while (1) {
+        if (xQueueReceive(button_queue, &evt, portMAX_DELAY) != pdTRUE) {
+            continue;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(100));
+        int remaining_s = (CONFIG_BUTTON_RESET_HOLD_MS - (int)evt.hold_ms) / 1000;
+
+        switch (evt.event) {
+        case BUTTON_EVENT_PRESS:
+            ESP_LOGI(TAG, "Button hold detected - hold for %d seconds to factory reset",
+                     CONFIG_BUTTON_RESET_HOLD_MS / 1000);
+            break;
+
+        case BUTTON_EVENT_RESET_WARNING:
+            if (evt.hold_ms < CONFIG_BUTTON_RESET_CRITICAL_MS) {
+                ESP_LOGW(TAG, "⚠️  Factory reset in %d seconds...", remaining_s);
+            } else {
+                ESP_LOGW(TAG, "🔴 FACTORY RESET IN %d SECONDS! Release button to cancel!", remaining_s);
+            }
+            break;
+
+        case BUTTON_EVENT_TAP:
+        case BUTTON_EVENT_RELEASE:
+            ESP_LOGI(TAG, "Factory reset cancelled (held for %lu ms)", (unsigned long)evt.hold_ms);
+            break;
+
+        case BUTTON_EVENT_RESET_HOLD:
+            factory_reset();
+            break;
+
+        default:
+            break;
+        }
     }
 }
 
@@ -1360,9 +1839,8 @@ static void provisioning_cb(esp_ble_mesh_prov_cb_event_t event, esp_ble_mesh_pro
         ESP_LOGI(TAG, "Provisioning link closed");
         break;
     case ESP_BLE_MESH_NODE_PROV_COMPLETE_EVT:
-        ESP_LOGI(TAG, "========================================");
-        ESP_LOGI(TAG, "🎉 PROVISIONING COMPLETE!");
-        ESP_LOGI(TAG, "========================================");
+        DLOG_I(TAG, "🎉 Provisioning complete: addr=0x%04X net_idx=0x%04X",
+               param->node_prov_complete.addr, param->node_prov_complete.net_idx);
         node_addr = param->node_prov_complete.addr;
         provisioned = true;
 
@@ -1394,7 +1872,7 @@ static void provisioning_cb(esp_ble_mesh_prov_cb_event_t event, esp_ble_mesh_pro
         // Save to NVS
         err = mesh_storage_save_prov_data(&prov_data);
         if (err != ESP_OK) {
-            ESP_LOGE(TAG, "❌ Failed to save provisioning data: %s", esp_err_to_name(err));
+            DLOG_E(TAG, "❌ Failed to save provisioning data: 0x%x", err);
         }
         break;
     case ESP_BLE_MESH_FRIEND_FRIENDSHIP_ESTABLISH_EVT:
@@ -1411,15 +1889,13 @@ static void provisioning_cb(esp_ble_mesh_prov_cb_event_t event, esp_ble_mesh_pro
 static void config_server_cb(esp_ble_mesh_cfg_server_cb_event_t event, esp_ble_mesh_cfg_server_cb_param_t *param)
 {
     if (event == ESP_BLE_MESH_CFG_SERVER_STATE_CHANGE_EVT) {
-        ESP_LOGI(TAG, "Config server state changed");
+        DLOG_D(TAG, "Config server state changed, op 0x%04X", param->ctx.recv_op);
 
         switch (param->ctx.recv_op) {
         case ESP_BLE_MESH_MODEL_OP_APP_KEY_ADD:
-            printf("\n========================================\n");
-            printf("🔑 APPKEY ADDED!\n");
-            printf("========================================\n");
-            printf("   Net Index: 0x%04X\n", param->value.state_change.appkey_add.net_idx);
-            printf("   App Index: 0x%04X\n", param->value.state_change.appkey_add.app_idx);
+            DLOG_I(TAG, "🔑 AppKey added: net_idx=0x%04X app_idx=0x%04X",
+                   param->value.state_change.appkey_add.net_idx,
+                   param->value.state_change.appkey_add.app_idx);
 
             // Update provisioning data with AppKey index and AppKey value
             mesh_prov_data_t prov_data;
@@ -1428,33 +1904,21 @@ static void config_server_cb(esp_ble_mesh_cfg_server_cb_event_t event, esp_ble_m
                 // Copy AppKey (app_key is always available as array)
                 memcpy(prov_data.app_key, param->value.state_change.appkey_add.app_key, 16);
                 mesh_storage_save_prov_data(&prov_data);
-
-                printf("💾 AppKey saved to NVS:\n");
-                printf("   AppKey: %02X%02X%02X%02X%02X%02X%02X%02X...\n",
-                         prov_data.app_key[0], prov_data.app_key[1],
-                         prov_data.app_key[2], prov_data.app_key[3],
-                         prov_data.app_key[4], prov_data.app_key[5],
-                         prov_data.app_key[6], prov_data.app_key[7]);
             }
-            printf("========================================\n\n");
             break;
 
         case ESP_BLE_MESH_MODEL_OP_MODEL_APP_BIND:
-            printf("\n========================================\n");
-            printf("🔗 MODEL BOUND TO APPKEY!\n");
-            printf("========================================\n");
-            printf("   Element Addr: 0x%04X\n", param->value.state_change.mod_app_bind.element_addr);
-            printf("   Model ID: 0x%04X\n", param->value.state_change.mod_app_bind.model_id);
-            printf("   App Index: 0x%04X\n", param->value.state_change.mod_app_bind.app_idx);
+            DLOG_I(TAG, "🔗 Model 0x%04X bound: elem=0x%04X app_idx=0x%04X",
+                   param->value.state_change.mod_app_bind.model_id,
+                   param->value.state_change.mod_app_bind.element_addr,
+                   param->value.state_change.mod_app_bind.app_idx);
 
             // Determine model ID string
             const char *model_id = NULL;
             if (param->value.state_change.mod_app_bind.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI) {
                 model_id = "onoff_cli";
-                printf("   Model: Generic OnOff Client\n");
             } else if (param->value.state_change.mod_app_bind.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV) {
                 model_id = "onoff_srv";
-                printf("   Model: Generic OnOff Server\n");
             }
 
             if (model_id) {
@@ -1463,59 +1927,45 @@ static void config_server_cb(esp_ble_mesh_cfg_server_cb_event_t event, esp_ble_m
                     .app_idx = param->value.state_change.mod_app_bind.app_idx,
                 };
                 mesh_storage_save_model_binding(model_id, &binding);
-                printf("💾 Model binding saved to NVS\n");
             }
-            printf("========================================\n\n");
             break;
 
         case ESP_BLE_MESH_MODEL_OP_MODEL_SUB_ADD:
-            printf("\n========================================\n");
-            printf("📬 SUBSCRIPTION ADDED!\n");
-            printf("========================================\n");
-            printf("   Element Addr: 0x%04X\n", param->value.state_change.mod_sub_add.element_addr);
-            printf("   Model ID: 0x%04X\n", param->value.state_change.mod_sub_add.model_id);
-            printf("   Sub Addr: 0x%04X\n", param->value.state_change.mod_sub_add.sub_addr);
+            DLOG_I(TAG, "📬 Model 0x%04X subscribed: elem=0x%04X sub=0x%04X",
+                   param->value.state_change.mod_sub_add.model_id,
+                   param->value.state_change.mod_sub_add.element_addr,
+                   param->value.state_change.mod_sub_add.sub_addr);
 
             // Determine model ID string
             model_id = NULL;
             if (param->value.state_change.mod_sub_add.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI) {
                 model_id = "onoff_cli";
-                printf("   Model: Generic OnOff Client\n");
             } else if (param->value.state_change.mod_sub_add.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV) {
                 model_id = "onoff_srv";
-                printf("   Model: Generic OnOff Server\n");
             }
 
             if (model_id) {
                 mesh_storage_add_subscription(model_id, param->value.state_change.mod_sub_add.sub_addr);
-                printf("💾 Subscription saved to NVS\n");
             }
-            printf("========================================\n\n");
             break;
 
         case ESP_BLE_MESH_MODEL_OP_MODEL_SUB_DELETE:
-            printf("\n========================================\n");
-            printf("📭 SUBSCRIPTION REMOVED!\n");
-            printf("========================================\n");
-            printf("   Element Addr: 0x%04X\n", param->value.state_change.mod_sub_delete.element_addr);
-            printf("   Model ID: 0x%04X\n", param->value.state_change.mod_sub_delete.model_id);
-            printf("   Sub Addr: 0x%04X\n", param->value.state_change.mod_sub_delete.sub_addr);
+            DLOG_I(TAG, "📭 Model 0x%04X unsubscribed: elem=0x%04X sub=0x%04X",
+                   param->value.state_change.mod_sub_delete.model_id,
+                   param->value.state_change.mod_sub_delete.element_addr,
+                   param->value.state_change.mod_sub_delete.sub_addr);
 
             // Determine model ID string
             model_id = NULL;
             if (param->value.state_change.mod_sub_delete.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_CLI) {
                 model_id = "onoff_cli";
-                printf("   Model: Generic OnOff Client\n");
             } else if (param->value.state_change.mod_sub_delete.model_id == ESP_BLE_MESH_MODEL_ID_GEN_ONOFF_SRV) {
                 model_id = "onoff_srv";
-                printf("   Model: Generic OnOff Server\n");
             }
 
             if (model_id) {
                 mesh_storage_remove_subscription(model_id, param->value.state_change.mod_sub_delete.sub_addr);
-                printf("💾 Subscription removed from NVS\n");
             }
-            printf("========================================\n\n");
             break;
 
         default:
@@ -1532,8 +1982,9 @@ static void generic_server_cb(esp_ble_mesh_generic_server_cb_event_t event, esp_
         // Handle button press from endpoint nodes
         if (param->ctx.recv_op == ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET ||
             param->ctx.recv_op == ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET_UNACK) {
+            TRACE_INSTANT("mesh_rx_press");
             ESP_LOGI(TAG, "📩 Received button press from node 0x%04x", param->ctx.addr);
-            publish_button_press(param->ctx.addr);
+            publish_button_press(param->ctx.addr, NULL, 0);
         }
         break;
     default:
@@ -1552,6 +2003,97 @@ static void generic_client_cb(esp_ble_mesh_generic_client_cb_event_t event, esp_
     }
 }
 
+/*
+ * A press can reach the gateway more than once (retransmits over different
+ * relays), seconds apart at most; drop repeats by sequence. An entry only
+ * counts for PRESS_REPEAT_WINDOW_S, so the table covers the presses of that
+ * window rather than every node, and a full table gives up its oldest entry.
+ */
+#define PRESS_SEEN_SLOTS        64
+#define PRESS_REPEAT_WINDOW_S   30
+
+static struct {
+    uint16_t addr;
+    uint8_t seq;
+    int64_t at_us;
+} press_seen[PRESS_SEEN_SLOTS];
+
+static bool press_is_repeat(uint16_t src_addr, uint8_t seq)
+{
+    int64_t now = esp_timer_get_time();
+    int oldest = 0;
+
+    for (int i = 0; i < PRESS_SEEN_SLOTS; i++) {
+        bool live = press_seen[i].addr != 0 && now - press_seen[i].at_us < PRESS_REPEAT_WINDOW_S * 1000000LL;
+        if (live && press_seen[i].addr == src_addr) {
+            if (press_seen[i].seq == seq) {
+                return true;
+            }
+            press_seen[i].seq = seq;
+            press_seen[i].at_us = now;
+            return false;
+        }
+        if (!live) {
+            press_seen[i].addr = 0;
+        }
+        if (press_seen[i].addr == 0 || (press_seen[oldest].addr != 0 && press_seen[i].at_us < press_seen[oldest].at_us)) {
+            oldest = i;
+        }
+    }
+
+    press_seen[oldest].addr = src_addr;
+    press_seen[oldest].seq = seq;
+    press_seen[oldest].at_us = now;
+    return false;
+}
+
+static void vendor_msg_received(uint16_t src_addr, uint32_t opcode, const uint8_t *msg, uint16_t len)
+{
+    switch (opcode) {
+    case MESH_VND_OP_PRESS_REPORT:
+        if (len < MESH_VND_PRESS_REPORT_MIN_LEN || press_is_repeat(src_addr, msg[0])) {
+            break;
+        }
+        TRACE_INSTANT("mesh_rx_press");
+        ESP_LOGI(TAG, "📩 Received press report %d from node 0x%04x", msg[0], src_addr);
+        publish_button_press(src_addr, msg, len);
+        break;
+    case MESH_VND_OP_LPN_STATUS:
+        if (len >= MESH_VND_LPN_STATUS_LEN) {
+            publish_lpn_report(src_addr, msg);
+        }
+        break;
+    case MESH_VND_OP_ENERGY_STATUS:
+        if (len >= MESH_VND_ENERGY_STATUS_LEN) {
+            publish_energy_report(src_addr, msg);
+        }
+        break;
+#if CONFIG_TASK_PROFILER_ENABLE
+    case MESH_VND_OP_PROFILE_STATUS:
+        publish_profile_report(src_addr, msg, len);
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+static void custom_model_cb(esp_ble_mesh_model_cb_event_t event, esp_ble_mesh_model_cb_param_t *param)
+{
+    switch (event) {
+    case ESP_BLE_MESH_MODEL_OPERATION_EVT:
+        vendor_msg_received(param->model_operation.ctx->addr, param->model_operation.opcode,
+                            param->model_operation.msg, param->model_operation.length);
+        break;
+    case ESP_BLE_MESH_CLIENT_MODEL_RECV_PUBLISH_MSG_EVT:
+        vendor_msg_received(param->client_recv_publish_msg.ctx->addr, param->client_recv_publish_msg.opcode,
+                            param->client_recv_publish_msg.msg, param->client_recv_publish_msg.length);
+        break;
+    default:
+        break;
+    }
+}
+
 /* BLE Mesh Initialization */
 static esp_err_t ble_mesh_init(void)
 {
@@ -1561,6 +2103,7 @@ static esp_err_t ble_mesh_init(void)
     esp_ble_mesh_register_config_server_callback(config_server_cb);
     esp_ble_mesh_register_generic_server_callback(generic_server_cb);
     esp_ble_mesh_register_generic_client_callback(generic_client_cb);
+    esp_ble_mesh_register_custom_model_callback(custom_model_cb);
 
     err = esp_ble_mesh_init(&provision, &composition);
     if (err != ESP_OK) {
@@ -1568,6 +2111,12 @@ static esp_err_t ble_mesh_init(void)
         return err;
     }
 
+    err = esp_ble_mesh_client_model_init(&vnd_models[0]);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize vendor client");
+        return err;
+    }
+
     // Load provisioning data from custom NVS to update global variables
     // Note: CONFIG_BLE_MESH_SETTINGS=y automatically restores BLE Mesh stack state
     // We only load from custom NVS to update global variables for Web UI display
@@ -1576,13 +2125,6 @@ static esp_err_t ble_mesh_init(void)
         provisioned = true;
         node_addr = prov_data.node_addr;
 
-        printf("\n========================================\n");
-        printf("📂 LOADED PROVISIONING DATA FROM NVS\n");
-        printf("========================================\n");
-        printf("   Node Address: 0x%04X\n", prov_data.node_addr);
-        printf("   Net Index: 0x%04X\n", prov_data.net_idx);
-        printf("   App Index: 0x%04X\n", prov_data.app_idx);
-
         // Check if AppKey is valid (not all zeros)
         bool app_key_valid = false;
         for (int i = 0; i < 16; i++) {
@@ -1592,21 +2134,10 @@ static esp_err_t ble_mesh_init(void)
             }
         }
 
-        if (app_key_valid) {
-            printf("   AppKey: %02X%02X%02X%02X%02X%02X%02X%02X...\n",
-                     prov_data.app_key[0], prov_data.app_key[1],
-                     prov_data.app_key[2], prov_data.app_key[3],
-                     prov_data.app_key[4], prov_data.app_key[5],
-                     prov_data.app_key[6], prov_data.app_key[7]);
-        } else {
-            printf("   AppKey: Not configured yet\n");
-        }
-        printf("========================================\n");
-        printf("ℹ️  BLE Mesh stack auto-restored by CONFIG_BLE_MESH_SETTINGS\n");
-        printf("✅ BLE Mesh Gateway - Already provisioned\n");
-        printf("========================================\n\n");
+        DLOG_I(TAG, "✅ Already provisioned: addr=0x%04X net_idx=0x%04X app_idx=0x%04X appkey=%d",
+               prov_data.node_addr, prov_data.net_idx, prov_data.app_idx, app_key_valid);
     } else {
-        printf("\nℹ️  No provisioning data found - device is unprovisioned\n\n");
+        DLOG_I(TAG, "ℹ️  No provisioning data found - device is unprovisioned");
 
         // Only enable provisioning if device is not already provisioned
         err = esp_ble_mesh_node_prov_enable(ESP_BLE_MESH_PROV_ADV | ESP_BLE_MESH_PROV_GATT);
@@ -1614,29 +2145,305 @@ static esp_err_t ble_mesh_init(void)
             ESP_LOGE(TAG, "Failed to enable provisioning");
             return err;
         }
-        printf("✅ BLE Mesh Gateway - Ready for provisioning\n\n");
+        DLOG_I(TAG, "✅ BLE Mesh Gateway - Ready for provisioning");
     }
 
     return ESP_OK;
 }
 
 /* MQTT Functions */
-static void publish_button_press(uint16_t src_addr)
+// report: PRESS_REPORT payload, NULL for a Generic OnOff press from older endpoints
+// A press queued on the endpoint carries its age: timestamp is when it happened, not when it arrived
+static void publish_button_press(uint16_t src_addr, const uint8_t *report, uint16_t len)
 {
+    TRACE_SCOPE("mqtt_publish_press");
+
     if (mqtt_client == NULL || !wifi_connected) {
         ESP_LOGW(TAG, "Cannot publish - MQTT not connected");
         return;
     }
 
-    char payload[128];
-    snprintf(payload, sizeof(payload),
-             "{\"node_addr\":\"0x%04x\",\"event\":\"button_press\",\"timestamp\":%lld}",
-             src_addr, esp_timer_get_time() / 1000);
+    char payload[224];
+    if (report != NULL) {
+        uint16_t age_s = len >= MESH_VND_PRESS_REPORT_LEN ? report[3] | (report[4] << 8) : 0;
+        int64_t timestamp = esp_timer_get_time() / 1000;
+        if (age_s != MESH_VND_PRESS_AGE_UNKNOWN) {
+            timestamp -= age_s * 1000LL;
+        }
+        snprintf(payload, sizeof(payload),
+                 "{\"node_addr\":\"0x%04x\",\"event\":\"button_press\",\"press\":\"%s\","
+                 "\"seq\":%d,\"battery\":%d,\"timestamp\":%lld,\"queued_s\":%d}",
+                 src_addr, report[1] == MESH_VND_PRESS_LONG ? "long" : "tap",
+                 report[0], report[2], timestamp,
+                 age_s == MESH_VND_PRESS_AGE_UNKNOWN ? -1 : age_s);
+    } else {
+        snprintf(payload, sizeof(payload),
+                 "{\"node_addr\":\"0x%04x\",\"event\":\"button_press\",\"timestamp\":%lld}",
+                 src_addr, esp_timer_get_time() / 1000);
+    }
 
     int msg_id = esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_BUTTON, payload, 0, 1, 0);
     ESP_LOGI(TAG, "📤 Published button press from 0x%04x, msg_id=%d", src_addr, msg_id);
 }
 
+// Polls per hour is the battery side of the tradeoff, wait_ms the latency side
+static void publish_lpn_report(uint16_t src_addr, const uint8_t *data)
+{
+    if (mqtt_client == NULL || !wifi_connected) {
+        return;
+    }
+
+    uint8_t period_min = data[0];
+    uint16_t polls = data[1] | (data[2] << 8);
+    uint16_t active_s = data[3] | (data[4] << 8);
+
+    char payload[256];
+    snprintf(payload, sizeof(payload),
+             "{\"node_addr\":\"0x%04x\",\"period_min\":%d,\"polls\":%d,\"polls_per_hour\":%lu,"
+             "\"active_s\":%d,\"indications\":%d,\"wait_ms\":%d,\"battery\":%d}",
+             src_addr, period_min, polls,
+             period_min ? (unsigned long)polls * 60 / period_min : 0UL,
+             active_s, data[5], data[6] * MESH_VND_LPN_LATENCY_UNIT_MS, data[7]);
+
+    esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_LPN, payload, 0, 0, 0);
+    ESP_LOGI(TAG, "📤 Published LPN report from 0x%04x", src_addr);
+}
+
+// Model estimate from the endpoint, not a measurement: compare nodes and settings with it
+static void publish_energy_report(uint16_t src_addr, const uint8_t *data)
+{
+    if (mqtt_client == NULL || !wifi_connected) {
+        return;
+    }
+
+    uint16_t average_ua = data[1] | (data[2] << 8);
+    unsigned long mah_per_day_x10 = (unsigned long)average_ua * 24 / 100;
+
+    char payload[256];
+    snprintf(payload, sizeof(payload),
+             "{\"node_addr\":\"0x%04x\",\"period_min\":%d,\"average_ua\":%d,"
+             "\"mah_per_day\":%lu.%lu,\"sleep_pct\":%d,"
+             "\"charge_pct\":{\"cpu\":%d,\"radio\":%d,\"led\":%d,\"sleep\":%d}}",
+             src_addr, data[0], average_ua, mah_per_day_x10 / 10, mah_per_day_x10 % 10,
+             data[3], data[4], data[5], data[6], data[7]);
+
+    esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_ENERGY, payload, 0, 0, 0);
+    ESP_LOGI(TAG, "📤 Published energy report from 0x%04x", src_addr);
+}
+
+#if CONFIG_TASK_PROFILER_ENABLE
+static void publish_profile_report(uint16_t src_addr, const uint8_t *data, uint16_t len)
+{
+    if (mqtt_client == NULL || !wifi_connected) {
+        return;
+    }
+    if (len < 2 || len < 2 + data[1] * MESH_VND_PROFILE_ENTRY_LEN) {
+        ESP_LOGW(TAG, "Malformed profile report from 0x%04x (%d bytes)", src_addr, len);
+        return;
+    }
+
+    char payload[768];
+    int offset = snprintf(payload, sizeof(payload),
+                          "{\"node_addr\":\"0x%04x\",\"window_s\":%d,\"tasks\":[",
+                          src_addr, data[0]);
+
+    const uint8_t *entry = &data[2];
+    for (int i = 0; i < data[1] && offset < (int)sizeof(payload) - 64; i++) {
+        uint16_t stack_free = entry[5] | (entry[6] << 8);
+        offset += snprintf(payload + offset, sizeof(payload) - offset,
+                           "%s{\"name\":\"%.*s\",\"cpu\":%d.%d,\"stack_free\":%d}",
+                           i > 0 ? "," : "",
+                           (int)strnlen((const char *)entry, MESH_VND_PROFILE_NAME_LEN), (const char *)entry,
+                           entry[4] / 2, (entry[4] % 2) * 5,
+                           stack_free);
+        entry += MESH_VND_PROFILE_ENTRY_LEN;
+    }
+    snprintf(payload + offset, sizeof(payload) - offset, "]}");
+
+    esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_PROFILE, payload, 0, 0, 0);
+    ESP_LOGI(TAG, "📤 Published profile report from 0x%04x", src_addr);
+}
+#endif
+
+/* LED Pattern Commands */
+static void send_vendor_msg(uint16_t target_addr, uint32_t opcode, uint8_t *data, uint16_t len)
+{
+    esp_ble_mesh_msg_ctx_t ctx = {0};
+    ctx.net_idx = 0;
+    ctx.app_idx = 0;
+    ctx.addr = target_addr;
+    ctx.send_ttl = 3;
+
+    TRACE_BEGIN("mesh_send");
+    esp_err_t err = esp_ble_mesh_client_model_send_msg(&vnd_models[0], &ctx, opcode, len, data,
+                                                       0, false, ROLE_NODE);
+    TRACE_END("mesh_send");
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to send vendor message to 0x%04x: %s", target_addr, esp_err_to_name(err));
+    }
+}
+
+static uint8_t led_time_units(const cJSON *item, int default_ms)
+{
+    int ms = cJSON_IsNumber(item) ? item->valueint : default_ms;
+    if (ms <= 0) {
+        return 0;
+    }
+    int units = (ms + MESH_VND_LED_TIME_UNIT_MS / 2) / MESH_VND_LED_TIME_UNIT_MS;
+    return units < 1 ? 1 : units > UINT8_MAX ? UINT8_MAX : (uint8_t)units;
+}
+
+/*
+ * {"id":4,"rgb":[255,128,0],"on_ms":200,"off_ms":200,"repeat":5,"priority":4}
+ * Missing fields: white, 500 ms on, solid, until stopped, priority 0.
+ */
+static void send_led_pattern(uint16_t target_addr, const cJSON *pattern)
+{
+    const cJSON *id = cJSON_GetObjectItem(pattern, "id");
+    if (!cJSON_IsNumber(id) || id->valueint < 0 || id->valueint >= MESH_VND_LED_PATTERN_MAX) {
+        ESP_LOGW(TAG, "LED pattern needs an id below %d", MESH_VND_LED_PATTERN_MAX);
+        return;
+    }
+
+    uint8_t msg[MESH_VND_LED_PATTERN_SET_LEN] = { (uint8_t)id->valueint, 255, 255, 255 };
+    const cJSON *rgb = cJSON_GetObjectItem(pattern, "rgb");
+    if (cJSON_IsArray(rgb) && cJSON_GetArraySize(rgb) == 3) {
+        for (int i = 0; i < 3; i++) {
+            msg[1 + i] = (uint8_t)cJSON_GetArrayItem(rgb, i)->valueint;
+        }
+    }
+    msg[4] = led_time_units(cJSON_GetObjectItem(pattern, "on_ms"), 500);
+    msg[5] = led_time_units(cJSON_GetObjectItem(pattern, "off_ms"), 0);
+    const cJSON *repeat = cJSON_GetObjectItem(pattern, "repeat");
+    msg[6] = cJSON_IsNumber(repeat) ? (uint8_t)repeat->valueint : 0;
+    const cJSON *priority = cJSON_GetObjectItem(pattern, "priority");
+    msg[7] = cJSON_IsNumber(priority) ? (uint8_t)priority->valueint : 0;
+
+    ESP_LOGI(TAG, "Installing LED pattern %d on node 0x%04x", msg[0], target_addr);
+    send_vendor_msg(target_addr, MESH_VND_OP_LED_PATTERN_SET, msg, sizeof(msg));
+}
+
+static void send_led_trigger(uint16_t target_addr, const cJSON *id, bool start)
+{
+    if (!cJSON_IsNumber(id) || id->valueint < 0 || id->valueint >= MESH_VND_LED_PATTERN_MAX) {
+        ESP_LOGW(TAG, "LED trigger needs an id below %d", MESH_VND_LED_PATTERN_MAX);
+        return;
+    }
+
+    uint8_t msg[MESH_VND_LED_PATTERN_TRIGGER_LEN] = { (uint8_t)id->valueint, start };
+    ESP_LOGI(TAG, "%s LED pattern %d on node 0x%04x", start ? "Starting" : "Stopping", msg[0], target_addr);
+    send_vendor_msg(target_addr, MESH_VND_OP_LED_PATTERN_TRIGGER, msg, sizeof(msg));
+}
+
+// "led_brightness":25, percent of full value, kept by the endpoint
+static void send_led_brightness(uint16_t target_addr, const cJSON *pct)
+{
+    if (!cJSON_IsNumber(pct) || pct->valueint < MESH_VND_LED_BRIGHTNESS_MIN ||
+        pct->valueint > MESH_VND_LED_BRIGHTNESS_MAX) {
+        ESP_LOGW(TAG, "LED brightness needs a percentage from %d to %d",
+                 MESH_VND_LED_BRIGHTNESS_MIN, MESH_VND_LED_BRIGHTNESS_MAX);
+        return;
+    }
+
+    uint8_t msg[MESH_VND_LED_BRIGHTNESS_SET_LEN] = { (uint8_t)pct->valueint };
+    ESP_LOGI(TAG, "LED brightness %d%% on node 0x%04x", msg[0], target_addr);
+    send_vendor_msg(target_addr, MESH_VND_OP_LED_BRIGHTNESS_SET, msg, sizeof(msg));
+}
+
+/*
+ * {"fast_ms":500,"active_s":60,"idle_s":0}, missing fields take the defaults
+ * of a fresh endpoint; idle_s 0 leaves idle polling to the endpoint's stack.
+ */
+static void send_lpn_poll(uint16_t target_addr, const cJSON *poll)
+{
+    const cJSON *fast = cJSON_GetObjectItem(poll, "fast_ms");
+    const cJSON *active = cJSON_GetObjectItem(poll, "active_s");
+    const cJSON *idle = cJSON_GetObjectItem(poll, "idle_s");
+    uint16_t fast_ms = cJSON_IsNumber(fast) ? (uint16_t)fast->valueint : 1000;
+    uint16_t active_s = cJSON_IsNumber(active) ? (uint16_t)active->valueint : 30;
+    uint16_t idle_s = cJSON_IsNumber(idle) ? (uint16_t)idle->valueint : 0;
+
+    uint8_t msg[MESH_VND_LPN_POLL_SET_LEN] = {
+        fast_ms & 0xFF, fast_ms >> 8,
+        active_s & 0xFF, active_s >> 8,
+        idle_s & 0xFF, idle_s >> 8,
+    };
+
+    ESP_LOGI(TAG, "LPN poll policy for node 0x%04x: fast %d ms for %d s, idle %d s",
+             target_addr, fast_ms, active_s, idle_s);
+    send_vendor_msg(target_addr, MESH_VND_OP_LPN_POLL_SET, msg, sizeof(msg));
+}
+
+/*
+ * {"rgb":[0,255,0],"pattern":"blink","duration_s":30,"quantity":3}
+ * pattern is "solid" (default), "blink" or "fast"; rgb [0,0,0] ends the indication.
+ */
+static void send_indicate(uint16_t target_addr, const cJSON *indicate)
+{
+    uint8_t msg[MESH_VND_INDICATE_LEN] = { 0, 255, 0, MESH_VND_INDICATE_SOLID };
+
+    const cJSON *rgb = cJSON_GetObjectItem(indicate, "rgb");
+    if (cJSON_IsArray(rgb) && cJSON_GetArraySize(rgb) == 3) {
+        for (int i = 0; i < 3; i++) {
+            msg[i] = (uint8_t)cJSON_GetArrayItem(rgb, i)->valueint;
+        }
+    }
+
+    const cJSON *pattern = cJSON_GetObjectItem(indicate, "pattern");
+    if (cJSON_IsString(pattern)) {
+        if (strcmp(pattern->valuestring, "blink") == 0) {
+            msg[3] = MESH_VND_INDICATE_BLINK;
+        } else if (strcmp(pattern->valuestring, "fast") == 0) {
+            msg[3] = MESH_VND_INDICATE_FAST_BLINK;
+        }
+    }
+
+    const cJSON *duration = cJSON_GetObjectItem(indicate, "duration_s");
+    int duration_s = cJSON_IsNumber(duration) ? duration->valueint : 0;
+    duration_s = duration_s < 0 ? 0 : duration_s > UINT16_MAX ? UINT16_MAX : duration_s;
+    msg[4] = duration_s & 0xFF;
+    msg[5] = duration_s >> 8;
+
+    const cJSON *quantity = cJSON_GetObjectItem(indicate, "quantity");
+    int count = cJSON_IsNumber(quantity) ? quantity->valueint : 0;
+    msg[6] = count < 0 ? 0 : count > MESH_VND_INDICATE_QUANTITY_MAX ? MESH_VND_INDICATE_QUANTITY_MAX : count;
+
+    ESP_LOGI(TAG, "Indicate on node 0x%04x: #%02x%02x%02x pattern %d for %d s, quantity %d",
+             target_addr, msg[0], msg[1], msg[2], msg[3], duration_s, msg[6]);
+    send_vendor_msg(target_addr, MESH_VND_OP_INDICATE, msg, sizeof(msg));
+}
+
+/*
+ * Commands drive the mesh, so the command topic waits for it, and so does
+ * the retained online status: ble_mesh_init() sets node_addr and
+ * provisioned. Both the MQTT task and app_main call this after setting
+ * their flag; at least one of them sees both set, and a second
+ * subscription or status is harmless.
+ */
+static void mqtt_subscribe_commands(void)
+{
+    if (!atomic_load(&mesh_up) || !atomic_load(&mqtt_up)) {
+        return;
+    }
+    esp_mqtt_client_subscribe(mqtt_client, MQTT_TOPIC_COMMAND, 0);
+
+    if (boot_profile_get_ms("mqtt_ready") < 0) {
+        uint32_t ms = boot_profile_mark("mqtt_ready");
+        ESP_LOGI(TAG, "⏱️  Accepting MQTT commands %lu ms after start-up (target %d ms)%s",
+                 (unsigned long)ms, BOOT_TARGET_MQTT_MS, ms > BOOT_TARGET_MQTT_MS ? " - over target" : "");
+        boot_profile_report();
+    }
+
+    // Publish status, with the boot milestones so slow starts show up at the server
+    char status[192];
+    snprintf(status, sizeof(status),
+             "{\"status\":\"online\",\"node_addr\":\"0x%04x\",\"provisioned\":%s,"
+             "\"boot_ms\":{\"mesh\":%ld,\"mqtt\":%ld}}",
+             node_addr, provisioned ? "true" : "false",
+             (long)boot_profile_get_ms("mesh_ready"), (long)boot_profile_get_ms("mqtt_ready"));
+    esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_STATUS, status, 0, 1, 1);
+}
+
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
     esp_mqtt_event_handle_t event = event_data;
@@ -1644,18 +2451,13 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     switch ((esp_mqtt_event_id_t)event_id) {
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "✅ MQTT Connected");
-        esp_mqtt_client_subscribe(mqtt_client, MQTT_TOPIC_COMMAND, 0);
-
-        // Publish status
-        char status[128];
-        snprintf(status, sizeof(status),
-                 "{\"status\":\"online\",\"node_addr\":\"0x%04x\",\"provisioned\":%s}",
-                 node_addr, provisioned ? "true" : "false");
-        esp_mqtt_client_publish(mqtt_client, MQTT_TOPIC_STATUS, status, 0, 1, 1);
+        atomic_store(&mqtt_up, true);
+        mqtt_subscribe_commands();      // And the online status, once the mesh is up too
         break;
 
     case MQTT_EVENT_DISCONNECTED:
         ESP_LOGW(TAG, "⚠️  MQTT Disconnected");
+        atomic_store(&mqtt_up, false);
         break;
 
     case MQTT_EVENT_SUBSCRIBED:
@@ -1663,6 +2465,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         break;
 
     case MQTT_EVENT_DATA:
+        TRACE_BEGIN("mqtt_command");
         ESP_LOGI(TAG, "📨 MQTT Message Received");
         ESP_LOGI(TAG, "TOPIC=%.*s", event->topic_len, event->topic);
         ESP_LOGI(TAG, "DATA=%.*s", event->data_len, event->data);
@@ -1674,6 +2477,12 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
                 cJSON *node = cJSON_GetObjectItem(json, "node_addr");
                 cJSON *led = cJSON_GetObjectItem(json, "led");
                 cJSON *factory_reset = cJSON_GetObjectItem(json, "factory_reset");
+                cJSON *led_pattern = cJSON_GetObjectItem(json, "led_pattern");
+                cJSON *led_trigger = cJSON_GetObjectItem(json, "led_trigger");
+                cJSON *led_stop = cJSON_GetObjectItem(json, "led_stop");
+                cJSON *led_brightness = cJSON_GetObjectItem(json, "led_brightness");
+                cJSON *indicate = cJSON_GetObjectItem(json, "indicate");
+                cJSON *lpn_poll = cJSON_GetObjectItem(json, "lpn_poll");
 
                 if (node && cJSON_IsString(node)) {
                     uint16_t target_addr;
@@ -1682,22 +2491,9 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
                     if (factory_reset && cJSON_IsTrue(factory_reset)) {
                         ESP_LOGW(TAG, "🔴 Factory reset command for node 0x%04x", target_addr);
 
-                        // Send factory reset message using Generic OnOff with special value
-                        esp_ble_mesh_generic_client_set_state_t set_state = {0};
-                        set_state.onoff_set.op_en = false;
-                        set_state.onoff_set.onoff = 2;  // Special value for factory reset
-                        set_state.onoff_set.tid = 0;
-
-                        esp_ble_mesh_client_common_param_t common = {0};
-                        common.opcode = ESP_BLE_MESH_MODEL_OP_GEN_ONOFF_SET_UNACK;
-                        common.model = &root_models[1];
-                        common.ctx.net_idx = 0;
-                        common.ctx.app_idx = 0;
-                        common.ctx.addr = target_addr;
-                        common.ctx.send_ttl = 3;
-                        common.msg_timeout = 0;
-
-                        esp_ble_mesh_generic_client_set_state(&common, &set_state);
+                        // The endpoint only acts on a reset naming its own address
+                        uint8_t reset_msg[MESH_VND_RESET_LEN] = { target_addr & 0xFF, target_addr >> 8 };
+                        send_vendor_msg(target_addr, MESH_VND_OP_RESET, reset_msg, sizeof(reset_msg));
                         ESP_LOGI(TAG, "✓ Factory reset command sent to node 0x%04x", target_addr);
                     }
                     else if (led && cJSON_IsBool(led)) {
@@ -1719,12 +2515,35 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
                         common.ctx.send_ttl = 3;
                         common.msg_timeout = 0;
 
+                        TRACE_BEGIN("mesh_send");
                         esp_ble_mesh_generic_client_set_state(&common, &set_state);
+                        TRACE_END("mesh_send");
+                    }
+
+                    // Install first so one command can install and start a pattern
+                    if (led_pattern && cJSON_IsObject(led_pattern)) {
+                        send_led_pattern(target_addr, led_pattern);
+                    }
+                    if (led_trigger) {
+                        send_led_trigger(target_addr, led_trigger, true);
+                    }
+                    if (led_stop) {
+                        send_led_trigger(target_addr, led_stop, false);
+                    }
+                    if (led_brightness) {
+                        send_led_brightness(target_addr, led_brightness);
+                    }
+                    if (indicate && cJSON_IsObject(indicate)) {
+                        send_indicate(target_addr, indicate);
+                    }
+                    if (lpn_poll && cJSON_IsObject(lpn_poll)) {
+                        send_lpn_poll(target_addr, lpn_poll);
                     }
                 }
                 cJSON_Delete(json);
             }
         }
+        TRACE_END("mqtt_command");
         break;
 
     case MQTT_EVENT_ERROR:
@@ -1754,12 +2573,75 @@ static void mqtt_app_start(void)
     ESP_LOGI(TAG, "🚀 MQTT Client Started");
 }
 
+// Bluetooth controller, Bluedroid, mesh storage and BLE Mesh, in that order
+static esp_err_t mesh_start(void)
+{
+    esp_err_t ret;
+
+    ESP_LOGI(TAG, "Step 4: Initializing Bluetooth...");
+    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    ret = esp_bt_controller_init(&bt_cfg);
+    if (ret) {
+        ESP_LOGE(TAG, "Bluetooth controller init failed");
+        return ret;
+    }
+
+    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+    if (ret) {
+        ESP_LOGE(TAG, "Bluetooth controller enable failed");
+        return ret;
+    }
+
+    ret = esp_bluedroid_init();
+    if (ret) {
+        ESP_LOGE(TAG, "Bluedroid init failed");
+        return ret;
+    }
+
+    ret = esp_bluedroid_enable();
+    if (ret) {
+        ESP_LOGE(TAG, "Bluedroid enable failed");
+        return ret;
+    }
+    ESP_LOGI(TAG, "Bluetooth initialized OK");
+    boot_profile_mark("bluetooth");
+
+    ESP_LOGI(TAG, "Step 5: Initializing Mesh Storage...");
+    ret = mesh_storage_init();
+    if (ret) {
+        ESP_LOGE(TAG, "Mesh storage init failed");
+        return ret;
+    }
+    ESP_LOGI(TAG, "Mesh storage initialized OK");
+
+    ESP_LOGI(TAG, "Step 6: Initializing BLE Mesh...");
+    ret = ble_mesh_init();
+    if (ret) {
+        ESP_LOGE(TAG, "BLE Mesh init failed");
+        return ret;
+    }
+    ESP_LOGI(TAG, "BLE Mesh initialized OK");
+    return ESP_OK;
+}
+
 void app_main(void)
 {
+    boot_profile_mark("app_main");
+
     printf("\n\n========================================\n");
     printf("APP_MAIN STARTED!\n");
     printf("========================================\n\n");
 
+    // Deferred log first so early mesh/storage records are kept
+    dlog_init();
+
+#if CONFIG_HEAP_MONITOR_ENABLE
+    // Before any cJSON use so its allocations are attributed
+    heap_monitor_start();
+#endif
+
     ESP_LOGI(TAG, "Step 1: Initializing NVS...");
 
     // Initialize NVS
@@ -1777,27 +2659,28 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
     ESP_LOGI(TAG, "NVS initialized OK");
+    boot_profile_mark("nvs");
 
     ESP_LOGI(TAG, "🚀 Smart Storage Gateway Starting...");
 
     ESP_LOGI(TAG, "Step 2: Initializing GPIO...");
-    // Initialize button GPIO for factory reset
-    gpio_config_t button_conf = {
-        .pin_bit_mask = (1ULL << BUTTON_GPIO),
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
+    // Initialize button GPIO for factory reset (events are queued until the task starts)
+    button_queue = xQueueCreate(8, sizeof(button_evt_t));
+    const button_config_t button_conf = {
+        .gpio = BUTTON_GPIO,
+        .active_level = BUTTON_ACTIVE_LEVEL,
+        .callback = button_event_cb,
     };
-    gpio_config(&button_conf);
+    ESP_ERROR_CHECK(button_init(&button_conf));
     ESP_LOGI(TAG, "GPIO initialized OK (Button on GPIO%d)", BUTTON_GPIO);
 
-    ESP_LOGI(TAG, "Step 3: Initializing NeoPixel LED...");
-    // Initialize NeoPixel LED
-    neopixel_init();
-    ESP_LOGI(TAG, "NeoPixel initialized OK");
-
-    ESP_LOGI(TAG, "Step 4: Initializing WiFi...");
+    /*
+     * WiFi goes first: association, DHCP and the broker connection run in the
+     * WiFi and MQTT tasks while Bluetooth and the mesh come up here. The web
+     * server, LED and factory reset tasks are not on the way to either and
+     * start last.
+     */
+    ESP_LOGI(TAG, "Step 3: Initializing WiFi...");
     // Initialize WiFi in AP mode
     wifi_init_ap();
     ESP_LOGI(TAG, "WiFi initialized OK");
@@ -1809,9 +2692,8 @@ void app_main(void)
     if (wifi_load_credentials(saved_ssid, sizeof(saved_ssid), saved_password, sizeof(saved_password)) == ESP_OK) {
         ESP_LOGI(TAG, "🔄 Auto-connecting to saved WiFi: %s", saved_ssid);
 
-        // Switch to APSTA mode
+        // Switch to APSTA mode (returns once the mode is applied)
         esp_wifi_set_mode(WIFI_MODE_APSTA);
-        vTaskDelay(pdMS_TO_TICKS(100));
 
         // Configure and connect
         wifi_config_t sta_config = {0};
@@ -1826,73 +2708,46 @@ void app_main(void)
     } else {
         ESP_LOGI(TAG, "ℹ️  No saved WiFi credentials - staying in AP mode");
     }
+    boot_profile_mark("wifi_started");
+
+    // A failure here leaves the web UI up for diagnosis
+    if (mesh_start() == ESP_OK) {
+        uint32_t ms = boot_profile_mark("mesh_ready");
+        ESP_LOGI(TAG, "⏱️  Mesh up %lu ms after start-up (target %d ms)%s",
+                 (unsigned long)ms, BOOT_TARGET_MESH_MS, ms > BOOT_TARGET_MESH_MS ? " - over target" : "");
+        atomic_store(&mesh_up, true);
+        mqtt_subscribe_commands();
+
+        // The tables are allocated by now; what is left has to carry MQTT, HTTP and cJSON
+        size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        ESP_LOGI(TAG, "Mesh tables ~%d KB (RPL %d, cache %d, %d Friend slots), free heap %u KB",
+                 MESH_SCALE_RAM_CONFIG / 1024, CONFIG_BLE_MESH_CRPL, CONFIG_BLE_MESH_MSG_CACHE_SIZE,
+                 CONFIG_BLE_MESH_FRIEND_LPN_COUNT, (unsigned)(free_heap / 1024));
+        if (free_heap < MESH_SCALE_HEAP_RESERVE) {
+            ESP_LOGW(TAG, "⚠️  Free heap below the %d KB reserve - reduce CONFIG_BLE_MESH_CRPL or the Friend settings",
+                     MESH_SCALE_HEAP_RESERVE / 1024);
+        }
+    }
 
-    ESP_LOGI(TAG, "Step 5: Waiting for WiFi to stabilize...");
-    // Wait a bit for WiFi to stabilize
-    vTaskDelay(pdMS_TO_TICKS(1000));
-
-    ESP_LOGI(TAG, "Step 6: Starting web server...");
+    ESP_LOGI(TAG, "Step 7: Starting web server...");
     // Start web server
     start_webserver();
     ESP_LOGI(TAG, "Web server started OK");
 
-    ESP_LOGI(TAG, "Step 7: Starting LED control task...");
-    // Start LED control task
-    xTaskCreate(led_control_task, "led_control", 2048, NULL, 5, NULL);
+    ESP_LOGI(TAG, "Step 8: Starting LED control task...");
+    // Start LED control task (initializes the NeoPixel)
+    xTaskCreate(led_control_task, "led_control", LED_TASK_STACK_SIZE, NULL, 5, NULL);
     ESP_LOGI(TAG, "LED task started OK");
 
-    ESP_LOGI(TAG, "Step 8: Starting factory reset monitor task...");
+    ESP_LOGI(TAG, "Step 9: Starting factory reset monitor task...");
     // Start factory reset monitor task
     xTaskCreate(factory_reset_task, "factory_reset", 2048, NULL, 5, NULL);
     ESP_LOGI(TAG, "Factory reset task started OK");
 
-    ESP_LOGI(TAG, "Step 9: Initializing Bluetooth...");
-    // Initialize Bluetooth
-    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
-
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-    ret = esp_bt_controller_init(&bt_cfg);
-    if (ret) {
-        ESP_LOGE(TAG, "Bluetooth controller init failed");
-        return;
-    }
-
-    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
-    if (ret) {
-        ESP_LOGE(TAG, "Bluetooth controller enable failed");
-        return;
-    }
-
-    ret = esp_bluedroid_init();
-    if (ret) {
-        ESP_LOGE(TAG, "Bluedroid init failed");
-        return;
-    }
-
-    ret = esp_bluedroid_enable();
-    if (ret) {
-        ESP_LOGE(TAG, "Bluedroid enable failed");
-        return;
-    }
-    ESP_LOGI(TAG, "Bluetooth initialized OK");
-
-    ESP_LOGI(TAG, "Step 10: Initializing Mesh Storage...");
-    // Initialize mesh storage
-    ret = mesh_storage_init();
-    if (ret) {
-        ESP_LOGE(TAG, "Mesh storage init failed");
-        return;
-    }
-    ESP_LOGI(TAG, "Mesh storage initialized OK");
-
-    ESP_LOGI(TAG, "Step 11: Initializing BLE Mesh...");
-    // Initialize BLE Mesh
-    ret = ble_mesh_init();
-    if (ret) {
-        ESP_LOGE(TAG, "BLE Mesh init failed");
-        return;
-    }
-    ESP_LOGI(TAG, "BLE Mesh initialized OK");
+#if CONFIG_TASK_PROFILER_ENABLE
+    task_profiler_start(NULL, NULL);
+#endif
+    boot_profile_mark("app_done");
 
     ESP_LOGI(TAG, "✅ System ready!");
     ESP_LOGI(TAG, "📱 Connect to AP: %s (Password: %s)", WIFI_AP_SSID, WIFI_AP_PASS);
@@ -1902,6 +2757,9 @@ void app_main(void)
     ESP_LOGI(TAG, "   - Solid BLUE = Client connected to AP");
     ESP_LOGI(TAG, "   - Solid GREEN = Connected to external WiFi (AP disabled)");
 
+    // Usually before got_ip and mqtt_ready; the timeline is logged again with them
+    boot_profile_report();
+
     printf("\n========================================\n");
     printf("APP_MAIN COMPLETED SUCCESSFULLY!\n");
     printf("========================================\n\n");
@@ -0,0 +1,60 @@
+#ifndef MESH_SCALE_H
+#define MESH_SCALE_H
+
+/*
+ * RAM taken by the mesh tables that grow with the number of endpoints,
+ * estimated from the BLE Mesh stack's structures in ESP-IDF 5.5. Shared by
+ * the gateway's budget check and firmware/host_test/mesh_sim, so it has no
+ * ESP-IDF dependencies.
+ *
+ * - Replay protection list: one entry per source element that has sent to
+ *   the gateway. Entries are only freed by an IV Index update, so a full
+ *   list drops every message from a new source.
+ * - Network message cache: recent network PDUs, so copies relayed by
+ *   several neighbours are decrypted once.
+ * - Friend: per LPN slot, its state, subscription list, incomplete segment
+ *   lists and queue of buffers.
+ * - Segmented receive and transmit contexts; a receive context holds a
+ *   reassembly buffer of CONFIG_BLE_MESH_RX_SDU_MAX bytes.
+ */
+
+#define MESH_SCALE_RPL_ENTRY_BYTES      8
+#define MESH_SCALE_CACHE_ENTRY_BYTES    8
+#define MESH_SCALE_FRIEND_BYTES         192     // Per LPN, without its lists and queue
+#define MESH_SCALE_FRIEND_SUB_BYTES     2       // Per subscription list entry
+#define MESH_SCALE_FRIEND_SEG_BYTES     12      // Per incomplete segment list
+#define MESH_SCALE_FRIEND_BUF_BYTES     64      // Per queued PDU: buffer header and advertising data
+#define MESH_SCALE_SEG_CTX_BYTES        64
+
+// Budget for the tables above, checked at build time
+#define MESH_SCALE_RAM_BUDGET           (48 * 1024)
+// Heap that must be left once the mesh is up, for MQTT, the web server and cJSON
+#define MESH_SCALE_HEAP_RESERVE         (40 * 1024)
+
+#define MESH_SCALE_RAM_BYTES(crpl, cache, lpns, sub_list, seg_rx, queue, rx_seg, rx_sdu, tx_seg) \
+    ((crpl) * MESH_SCALE_RPL_ENTRY_BYTES +                                                  \
+     (cache) * MESH_SCALE_CACHE_ENTRY_BYTES +                                               \
+     (lpns) * (MESH_SCALE_FRIEND_BYTES + (sub_list) * MESH_SCALE_FRIEND_SUB_BYTES +          \
+               (seg_rx) * MESH_SCALE_FRIEND_SEG_BYTES + (queue) * MESH_SCALE_FRIEND_BUF_BYTES) + \
+     (rx_seg) * (MESH_SCALE_SEG_CTX_BYTES + (rx_sdu)) +                                     \
+     (tx_seg) * MESH_SCALE_SEG_CTX_BYTES)
+
+#if defined(CONFIG_BLE_MESH_CRPL)
+
+#if CONFIG_BLE_MESH_FRIEND
+#define MESH_SCALE_RAM_CONFIG                                                               \
+    MESH_SCALE_RAM_BYTES(CONFIG_BLE_MESH_CRPL, CONFIG_BLE_MESH_MSG_CACHE_SIZE,              \
+                         CONFIG_BLE_MESH_FRIEND_LPN_COUNT, CONFIG_BLE_MESH_FRIEND_SUB_LIST_SIZE, \
+                         CONFIG_BLE_MESH_FRIEND_SEG_RX, CONFIG_BLE_MESH_FRIEND_QUEUE_SIZE,  \
+                         CONFIG_BLE_MESH_RX_SEG_MSG_COUNT, CONFIG_BLE_MESH_RX_SDU_MAX,      \
+                         CONFIG_BLE_MESH_TX_SEG_MSG_COUNT)
+#else
+#define MESH_SCALE_RAM_CONFIG                                                               \
+    MESH_SCALE_RAM_BYTES(CONFIG_BLE_MESH_CRPL, CONFIG_BLE_MESH_MSG_CACHE_SIZE, 0, 0, 0, 0,  \
+                         CONFIG_BLE_MESH_RX_SEG_MSG_COUNT, CONFIG_BLE_MESH_RX_SDU_MAX,      \
+                         CONFIG_BLE_MESH_TX_SEG_MSG_COUNT)
+#endif
+
+#endif // CONFIG_BLE_MESH_CRPL
+
+#endif // MESH_SCALE_H
@@ -0,0 +1,182 @@
+/*
+ * Host tests for the battery filter. Each trace in traces/ is replayed
+ * sample by sample through battery_filter_oversample() and
+ * battery_filter_update() with the Kconfig defaults.
+ */
+#include "battery_filter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// components/battery/Kconfig defaults
+#define FILTER_SHIFT        3
+#define HYSTERESIS_PCT      2
+#define READINGS            8
+#define LOW_THRESHOLD       10  // BATTERY_LOW_THRESHOLD in the endpoint
+#define MAX_SAMPLES         1024
+
+static int s_failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("    FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            s_failures++; \
+        } \
+    } while (0)
+
+#define RUN(test) do { \
+        int before = s_failures; \
+        test(); \
+        printf("%s %s\n", s_failures == before ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+typedef struct {
+    size_t count;
+    uint8_t percent[MAX_SAMPLES];   // Reported level after each sample
+    size_t changes;                 // Times the reported level moved
+    size_t rises;                   // Times it moved up
+    size_t low_toggles;             // Times it crossed LOW_THRESHOLD
+} replay_t;
+
+static void replay(const char *name, uint8_t shift, uint8_t hysteresis, replay_t *out)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", TRACE_DIR, name);
+    FILE *f = fopen(path, "r");
+    memset(out, 0, sizeof(*out));
+    CHECK(f != NULL);
+    if (f == NULL) {
+        return;
+    }
+
+    battery_filter_t filter;
+    battery_filter_init(&filter, shift, hysteresis);
+
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL && out->count < MAX_SAMPLES) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        uint16_t readings[READINGS];
+        char *field = strchr(line, ',');     // Skip the timestamp
+        for (int i = 0; i < READINGS; i++) {
+            CHECK(field != NULL);
+            if (field == NULL) {
+                fclose(f);
+                return;
+            }
+            readings[i] = (uint16_t)strtoul(field + 1, &field, 10);
+        }
+
+        uint8_t percent = battery_filter_update(&filter, battery_filter_oversample(readings, READINGS));
+        if (out->count > 0) {
+            uint8_t last = out->percent[out->count - 1];
+            out->changes += percent != last;
+            out->rises += percent > last;
+            out->low_toggles += (percent < LOW_THRESHOLD) != (last < LOW_THRESHOLD);
+        }
+        out->percent[out->count++] = percent;
+    }
+    fclose(f);
+}
+
+static void test_curve(void)
+{
+    CHECK(battery_mv_to_percent(4300) == 100);
+    CHECK(battery_mv_to_percent(4200) == 100);
+    CHECK(battery_mv_to_percent(3690) == 10);
+    CHECK(battery_mv_to_percent(3710) == 15);
+    CHECK(battery_mv_to_percent(3270) == 0);
+    CHECK(battery_mv_to_percent(3000) == 0);
+
+    uint8_t last = 0;
+    for (uint16_t mv = 3000; mv <= 4300; mv++) {
+        uint8_t percent = battery_mv_to_percent(mv);
+        CHECK(percent >= last);
+        last = percent;
+    }
+}
+
+static void test_oversample_drops_load_steps(void)
+{
+    uint16_t readings[READINGS] = { 3900, 3680, 3901, 3899, 3750, 3900, 3900, 3902 };
+    CHECK(battery_filter_oversample(readings, READINGS) == 3900);
+
+    uint16_t single = 3800;
+    CHECK(battery_filter_oversample(&single, 1) == 3800);
+}
+
+static void test_first_sample_sets_level(void)
+{
+    battery_filter_t filter;
+    battery_filter_init(&filter, FILTER_SHIFT, HYSTERESIS_PCT);
+    CHECK(battery_filter_update(&filter, 3950) == 70);
+    CHECK(battery_filter_mv(&filter) == 3950);
+}
+
+static void test_trace_discharge(void)
+{
+    replay_t r;
+    replay("discharge.csv", FILTER_SHIFT, HYSTERESIS_PCT, &r);
+
+    CHECK(r.count == 400);
+    CHECK(r.percent[0] >= 95);
+    CHECK(r.percent[r.count - 1] <= 5);
+    CHECK(r.rises == 0);
+    CHECK(r.low_toggles == 1);
+    printf("    %zu samples, %zu level changes\n", r.count, r.changes);
+}
+
+static void test_trace_threshold(void)
+{
+    replay_t raw, filtered;
+    replay("threshold.csv", 0, 0, &raw);
+    replay("threshold.csv", FILTER_SHIFT, HYSTERESIS_PCT, &filtered);
+
+    // The readings keep crossing the threshold; the filtered level only follows the slow wander
+    CHECK(raw.low_toggles > 10);
+    CHECK(filtered.low_toggles <= 1);
+    CHECK(filtered.changes * 10 < raw.changes);
+    printf("    level changes: %zu unfiltered, %zu filtered; low toggles: %zu unfiltered, %zu filtered\n",
+           raw.changes, filtered.changes, raw.low_toggles, filtered.low_toggles);
+}
+
+static void test_trace_charge(void)
+{
+    replay_t r;
+    replay("charge.csv", FILTER_SHIFT, HYSTERESIS_PCT, &r);
+
+    // No rise before the charger, then it follows the charge up
+    for (size_t i = 1; i < 60; i++) {
+        CHECK(r.percent[i] <= r.percent[i - 1]);
+    }
+    CHECK(r.percent[59] <= 32);
+    CHECK(r.percent[r.count - 1] >= 95);
+}
+
+static void test_trace_tx_bursts(void)
+{
+    replay_t r;
+    replay("tx_bursts.csv", FILTER_SHIFT, HYSTERESIS_PCT, &r);
+
+    CHECK(r.count == 200);
+    CHECK(r.changes == 0);
+    CHECK(r.percent[0] >= 69 && r.percent[0] <= 71);
+}
+
+int main(void)
+{
+    printf("battery filter host tests\n");
+
+    RUN(test_curve);
+    RUN(test_oversample_drops_load_steps);
+    RUN(test_first_sample_sets_level);
+    RUN(test_trace_discharge);
+    RUN(test_trace_threshold);
+    RUN(test_trace_charge);
+    RUN(test_trace_tx_bursts);
+
+    printf("%d failure(s)\n", s_failures);
+    return s_failures == 0 ? 0 : 1;
+}
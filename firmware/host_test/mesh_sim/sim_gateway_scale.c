@@ -0,0 +1,634 @@
+/*
+ * The gateway's receive path for an hour of a 500-node warehouse mesh,
+ * once with the stack defaults and once with the scale profile from
+ * gateway-node/sdkconfig.defaults (passed in as PROFILE_* by CMake).
+ *
+ * Layout and flooding follow sim_press_routing: a 25 x 20 grid of bins,
+ * every third column a mains-powered Relay and Friend, the gateway on the
+ * left wall, one transmission per node per PDU, no collisions. This tree
+ * has no Relay/Friend firmware: those nodes are a site requirement, and the
+ * layout is also checked with the gateway as the only Friend. Each
+ * transmission goes out NET_TRANSMITS times and a relay waits a random
+ * 10-50 ms before relaying. A PDU's copies arrive at the gateway from
+ * every transmitter in its range.
+ *
+ * Traffic, after the power comes back and every node boots within 2 s:
+ * - LPN_STATUS every 15 minutes and ENERGY_STATUS every hour from every
+ *   node, timed from its boot, so they arrive in bursts
+ * - PICKS_PER_HOUR presses from random nodes, each after an INDICATE
+ * - PROFILE_STATUS, 8 segments, every 5 s from the PROFILED_NODES bins of
+ *   one zone under diagnosis
+ *
+ * At the gateway:
+ * - Network cache: a FIFO of PDUs. A copy of a PDU that has already been
+ *   evicted is decrypted and handed up again.
+ * - Replay protection list: sized for capacity only, sequence order is
+ *   not checked. A message from a new source finds the list full and is
+ *   dropped.
+ * - Segmented receive: a message whose first segment finds every context
+ *   busy is not acknowledged. The sender sends it again after
+ *   200 + 50 * TTL ms, up to SEG_ATTEMPTS times, then drops it.
+ * - Its own PDUs (INDICATEs and segment acks) echoed by relays take cache
+ *   entries; they are dropped by source address either way.
+ * - Friend: every LPN takes a slot on the nearest Friend in range with one
+ *   free. An LPN without a Friend receives no INDICATE and keeps its
+ *   presses queued, so its messages count as dropped. The LPNs in the
+ *   gateway's range are the most that can ask it for a friendship when
+ *   their Relay/Friend neighbours are down.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "mesh_scale.h"
+
+#define COLS            25
+#define ROWS            20
+#define NODE_COUNT      (COLS * ROWS)
+#define GATEWAY         NODE_COUNT          // Index of the gateway
+#define SPACING_X_M     3.0
+#define SPACING_Y_M     4.0
+#define RANGE_M         10.0
+#define MAX_NEIGHBOURS  64
+
+#define SIM_MS              (3700 * 1000)   // Past the first hourly burst
+#define BOOT_SPREAD_MS      2000
+#define LPN_REPORT_MS       (900 * 1000)
+#define ENERGY_REPORT_MS    (3600 * 1000)
+#define PICKS_PER_HOUR      6000
+#define PROFILED_NODES      50
+#define PROFILE_PERIOD_MS   5000
+#define PROFILE_SEGMENTS    8               // 3 + 86 byte payload + TransMIC, 12 bytes per segment
+#define SEG_INTERVAL_MS     30              // Between the segments of one message
+#define NET_TRANSMITS       3               // Copies of each transmission
+#define NET_TRANSMIT_MS     20              // Between them
+#define RELAY_DELAY_MIN_MS  10
+#define RELAY_DELAY_MAX_MS  50
+#define SEG_ATTEMPTS        4
+#define RELAY_FRIEND_SLOTS  3               // Friend slots on each Relay/Friend node; 2 leaves LPNs out
+
+typedef struct {
+    double x, y;
+    bool relay;
+    int friend;         // LPN only: its Friend, -1 if none
+    int hops;
+    int neighbours[MAX_NEIGHBOURS];
+    int neighbour_count;
+} sim_node_t;
+
+typedef struct {
+    const char *name;
+    int crpl;
+    int cache;
+    int lpn_count;
+    int sub_list;
+    int friend_seg_rx;
+    int friend_queue;
+    int rx_seg;
+    int rx_sdu;
+    int tx_seg;
+} sim_config_t;
+
+typedef enum {
+    MSG_REPORT,         // Unsegmented, to the gateway
+    MSG_PROFILE,        // Segmented, to the gateway
+    MSG_GATEWAY,        // Sent by the gateway: INDICATE or segment ack
+} msg_kind_t;
+
+typedef struct {
+    int src;            // Node, or GATEWAY for MSG_GATEWAY
+    int peer;           // MSG_GATEWAY: the node it is sent to
+    msg_kind_t kind;
+    int segments;
+    int attempt;        // MSG_PROFILE: 1 for the first transmission
+    int first_pdu;      // PDU id of segment 0
+    int ctx;            // Segmented receive context, -1 if none
+    int received;       // Segments received
+    bool rejected;
+} sim_msg_t;
+
+typedef enum {
+    EV_SEND,
+    EV_COPY,
+} event_type_t;
+
+typedef struct {
+    double at_ms;
+    event_type_t type;
+    int msg;
+    int seg;            // EV_COPY only
+} sim_event_t;
+
+typedef struct {
+    int messages;               // Sent to the gateway by the endpoints, retries excluded
+    int delivered;
+    int rpl_drops;
+    int friendless_drops;       // From or to LPNs without a Friend
+    int seg_drops;
+    int seg_retries;
+    int duplicates;             // Copies decrypted again after leaving the cache
+    int cache_need;             // Smallest cache that would have caught every copy caught here
+    int sources;                // Distinct sources heard
+    int seg_peak;               // Most segmented messages that were in reception at once
+} sim_result_t;
+
+static sim_node_t nodes[NODE_COUNT + 1];
+
+static sim_msg_t *msgs;
+static int msg_count, msg_cap;
+static sim_event_t *heap;
+static int heap_count, heap_cap;
+static int pdu_count;
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static double rng_uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (rng() / 16777216.0);
+}
+
+static bool scans(int i)
+{
+    return i == GATEWAY || nodes[i].relay;
+}
+
+static void build_mesh(void)
+{
+    for (int i = 0; i < NODE_COUNT; i++) {
+        nodes[i].x = (i % COLS) * SPACING_X_M;
+        nodes[i].y = (i / COLS) * SPACING_Y_M;
+        nodes[i].relay = (i % COLS) % 3 == 1;
+    }
+    nodes[GATEWAY].x = -SPACING_X_M;
+    nodes[GATEWAY].y = (ROWS - 1) * SPACING_Y_M / 2;
+    nodes[GATEWAY].relay = true;
+
+    for (int a = 0; a <= NODE_COUNT; a++) {
+        for (int b = 0; b <= NODE_COUNT; b++) {
+            if (a != b && hypot(nodes[a].x - nodes[b].x, nodes[a].y - nodes[b].y) <= RANGE_M &&
+                nodes[a].neighbour_count < MAX_NEIGHBOURS) {
+                nodes[a].neighbours[nodes[a].neighbour_count++] = b;
+            }
+        }
+    }
+
+    // Hops to the gateway over the scanning nodes; an LPN is one past its nearest one
+    int queue[NODE_COUNT + 1];
+    int head = 0, tail = 0;
+    for (int i = 0; i <= NODE_COUNT; i++) {
+        nodes[i].hops = -1;
+    }
+    nodes[GATEWAY].hops = 0;
+    queue[tail++] = GATEWAY;
+    while (head < tail) {
+        int n = queue[head++];
+        for (int k = 0; k < nodes[n].neighbour_count; k++) {
+            int i = nodes[n].neighbours[k];
+            if (nodes[i].relay && nodes[i].hops < 0) {
+                nodes[i].hops = nodes[n].hops + 1;
+                queue[tail++] = i;
+            }
+        }
+    }
+    for (int i = 0; i < NODE_COUNT; i++) {
+        if (nodes[i].relay) {
+            continue;
+        }
+        for (int k = 0; k < nodes[i].neighbour_count; k++) {
+            int f = nodes[i].neighbours[k];
+            if (scans(f) && nodes[f].hops >= 0 && (nodes[i].hops < 0 || nodes[f].hops + 1 < nodes[i].hops)) {
+                nodes[i].hops = nodes[f].hops + 1;
+            }
+        }
+    }
+}
+
+/*
+ * Give every LPN a slot on the nearest Friend in its range that has one
+ * free: the gateway, and the relays when relay_friends is set. Returns the
+ * LPNs left without a Friend.
+ */
+static int assign_friends(bool relay_friends, int gateway_slots)
+{
+    int slots[NODE_COUNT + 1];
+    for (int i = 0; i <= NODE_COUNT; i++) {
+        slots[i] = i == GATEWAY ? gateway_slots : relay_friends && nodes[i].relay ? RELAY_FRIEND_SLOTS : 0;
+        nodes[i].friend = -1;
+    }
+
+    int friendless = 0;
+    for (int i = 0; i < NODE_COUNT; i++) {
+        if (nodes[i].relay) {
+            continue;
+        }
+        double best_m = 0;
+        for (int k = 0; k < nodes[i].neighbour_count; k++) {
+            int f = nodes[i].neighbours[k];
+            double d = hypot(nodes[i].x - nodes[f].x, nodes[i].y - nodes[f].y);
+            if (slots[f] > 0 && (nodes[i].friend < 0 || d < best_m)) {
+                nodes[i].friend = f;
+                best_m = d;
+            }
+        }
+        if (nodes[i].friend < 0) {
+            friendless++;
+        } else {
+            slots[nodes[i].friend]--;
+        }
+    }
+    return friendless;
+}
+
+static bool has_friend(int node)
+{
+    return nodes[node].relay || nodes[node].friend >= 0;
+}
+
+/* Event queue: a binary min-heap on time */
+
+static void push(sim_event_t ev)
+{
+    if (heap_count == heap_cap) {
+        heap_cap = heap_cap ? heap_cap * 2 : 4096;
+        heap = realloc(heap, heap_cap * sizeof(*heap));
+    }
+    int i = heap_count++;
+    while (i > 0 && heap[(i - 1) / 2].at_ms > ev.at_ms) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = ev;
+}
+
+static sim_event_t pop(void)
+{
+    sim_event_t top = heap[0];
+    sim_event_t last = heap[--heap_count];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= heap_count) {
+            break;
+        }
+        if (c + 1 < heap_count && heap[c + 1].at_ms < heap[c].at_ms) {
+            c++;
+        }
+        if (heap[c].at_ms >= last.at_ms) {
+            break;
+        }
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = last;
+    return top;
+}
+
+static int add_msg(int src, int peer, msg_kind_t kind, int segments, int attempt, double at_ms)
+{
+    if (msg_count == msg_cap) {
+        msg_cap = msg_cap ? msg_cap * 2 : 4096;
+        msgs = realloc(msgs, msg_cap * sizeof(*msgs));
+    }
+    msgs[msg_count] = (sim_msg_t){
+        .src = src, .peer = peer, .kind = kind, .segments = segments,
+        .attempt = attempt, .first_pdu = -1, .ctx = -1,
+    };
+    push((sim_event_t){ .at_ms = at_ms, .type = EV_SEND, .msg = msg_count });
+    return msg_count++;
+}
+
+static int publish_ttl(int node)
+{
+    return nodes[node].hops < 2 ? 2 : nodes[node].hops;
+}
+
+/*
+ * Flood a message and queue the copies the gateway hears. The relay delays
+ * are drawn once per message, so its segments keep their order.
+ */
+static void flood(int m, double at_ms)
+{
+    int src = msgs[m].src;
+    int ttl = publish_ttl(msgs[m].kind == MSG_GATEWAY ? msgs[m].peer : src);
+    bool seen[NODE_COUNT + 1] = {false};
+    int queue[NODE_COUNT + 1];
+    int queue_ttl[NODE_COUNT + 1];
+    double tx_ms[NODE_COUNT + 1];
+    int head = 0, tail = 0;
+
+    msgs[m].first_pdu = pdu_count;
+    pdu_count += msgs[m].segments;
+
+    seen[src] = true;
+    queue[tail] = src;
+    tx_ms[src] = at_ms;
+    queue_ttl[tail++] = ttl + 1;    // The source sends with ttl, relays send with one less
+    while (head < tail) {
+        int n = queue[head];
+        int sent_ttl = queue_ttl[head++] - 1;
+        bool heard = n != GATEWAY && hypot(nodes[n].x - nodes[GATEWAY].x,
+                                           nodes[n].y - nodes[GATEWAY].y) <= RANGE_M;
+        for (int s = 0; heard && s < msgs[m].segments; s++) {
+            for (int t = 0; t < NET_TRANSMITS; t++) {
+                push((sim_event_t){
+                    .at_ms = tx_ms[n] + s * SEG_INTERVAL_MS + t * NET_TRANSMIT_MS,
+                    .type = EV_COPY, .msg = m, .seg = s,
+                });
+            }
+        }
+
+        for (int k = 0; k < nodes[n].neighbour_count; k++) {
+            int i = nodes[n].neighbours[k];
+            if (seen[i] || !scans(i)) {
+                continue;
+            }
+            seen[i] = true;
+            bool dst = i == (msgs[m].kind == MSG_GATEWAY ? msgs[m].peer : GATEWAY);
+            if (!dst && i != GATEWAY && sent_ttl >= 2) {
+                tx_ms[i] = tx_ms[n] + rng_uniform(RELAY_DELAY_MIN_MS, RELAY_DELAY_MAX_MS);
+                queue[tail] = i;
+                queue_ttl[tail++] = sent_ttl;
+            }
+        }
+    }
+}
+
+/* Gateway state */
+
+/*
+ * A FIFO of size entries holds the last size insertions, so it is kept as
+ * the insertion count of each PDU rather than as a ring.
+ */
+typedef struct {
+    int size;
+    int inserted;           // Total insertions
+    int *inserted_at;       // Per PDU: insertion count when it was last inserted, -1 if never
+    bool *handled;          // Per PDU: passed the cache at least once
+} msg_cache_t;
+
+// Entries needed to still hold the PDU now
+static int cache_age(const msg_cache_t *c, int pdu)
+{
+    return c->inserted_at[pdu] < 0 ? -1 : c->inserted - c->inserted_at[pdu];
+}
+
+static void cache_add(msg_cache_t *c, int pdu)
+{
+    c->inserted_at[pdu] = c->inserted++;
+}
+
+// A message from an endpoint; one from an LPN without a Friend never leaves it
+static void send_to_gateway(sim_result_t *r, int node, msg_kind_t kind, int segments, double at_ms)
+{
+    r->messages++;
+    if (!has_friend(node)) {
+        r->friendless_drops++;
+        return;
+    }
+    add_msg(node, GATEWAY, kind, segments, 1, at_ms);
+}
+
+static sim_result_t run(const sim_config_t *cfg)
+{
+    sim_result_t r = {0};
+    msg_count = 0;
+    heap_count = 0;
+    pdu_count = 0;
+    rng_state = 12345;
+    assign_friends(true, cfg->lpn_count);
+
+    // Traffic
+    double boot_ms[NODE_COUNT];
+    for (int i = 0; i < NODE_COUNT; i++) {
+        boot_ms[i] = rng_uniform(0, BOOT_SPREAD_MS);
+        for (double t = boot_ms[i] + LPN_REPORT_MS; t < SIM_MS; t += LPN_REPORT_MS) {
+            send_to_gateway(&r, i, MSG_REPORT, 1, t);
+        }
+        for (double t = boot_ms[i] + ENERGY_REPORT_MS; t < SIM_MS; t += ENERGY_REPORT_MS) {
+            send_to_gateway(&r, i, MSG_REPORT, 1, t);
+        }
+    }
+    for (int p = 0; p < (int)((double)PICKS_PER_HOUR * SIM_MS / 3600000); p++) {
+        int node = rng() % NODE_COUNT;
+        double press_ms = rng_uniform(BOOT_SPREAD_MS + 30000, SIM_MS);
+        double indicate_ms = press_ms - rng_uniform(5000, 30000);
+        if (has_friend(node)) {
+            add_msg(GATEWAY, node, MSG_GATEWAY, 1, 1, indicate_ms);
+        }
+        send_to_gateway(&r, node, MSG_REPORT, 1, press_ms);
+    }
+    // The profiled zone: the bins farthest from the gateway, whose reports cross the whole mesh
+    for (int z = 0; z < PROFILED_NODES; z++) {
+        int node = NODE_COUNT - 1 - z;
+        for (double t = boot_ms[node] + PROFILE_PERIOD_MS; t < SIM_MS; t += PROFILE_PERIOD_MS) {
+            send_to_gateway(&r, node, MSG_PROFILE, PROFILE_SEGMENTS, t);
+        }
+    }
+
+    msg_cache_t cache = { .size = cfg->cache };
+    int pdu_cap = 0;
+    bool rpl[NODE_COUNT] = {false};
+    int *ctx_owner = malloc(cfg->rx_seg * sizeof(int));
+    for (int c = 0; c < cfg->rx_seg; c++) {
+        ctx_owner[c] = -1;
+    }
+
+    while (heap_count > 0) {
+        sim_event_t ev = pop();
+        if (ev.type == EV_SEND) {
+            flood(ev.msg, ev.at_ms);
+            if (pdu_count > pdu_cap) {
+                int cap = pdu_count * 2;
+                cache.inserted_at = realloc(cache.inserted_at, cap * sizeof(int));
+                cache.handled = realloc(cache.handled, cap * sizeof(bool));
+                for (int p = pdu_cap; p < cap; p++) {
+                    cache.inserted_at[p] = -1;
+                    cache.handled[p] = false;
+                }
+                pdu_cap = cap;
+            }
+            continue;
+        }
+
+        sim_msg_t *m = &msgs[ev.msg];
+        int pdu = m->first_pdu + ev.seg;
+        int age = cache_age(&cache, pdu);
+        if (age >= 0 && age < cache.size) {
+            if (m->kind != MSG_GATEWAY && age + 1 > r.cache_need) {
+                r.cache_need = age + 1;
+            }
+            continue;
+        }
+        if (cache.handled[pdu]) {
+            if (m->kind != MSG_GATEWAY) {
+                r.duplicates++;
+            }
+            cache_add(&cache, pdu);
+            continue;
+        }
+        cache_add(&cache, pdu);
+        cache.handled[pdu] = true;
+        if (m->kind == MSG_GATEWAY) {
+            continue;
+        }
+
+        if (!rpl[m->src]) {
+            if (r.sources == cfg->crpl) {
+                r.rpl_drops += ev.seg == 0 || m->kind == MSG_REPORT;
+                continue;
+            }
+            rpl[m->src] = true;
+            r.sources++;
+        }
+
+        if (m->kind == MSG_REPORT) {
+            r.delivered++;
+            continue;
+        }
+
+        // Segmented: the first segment to arrive claims a context
+        if (m->rejected) {
+            continue;
+        }
+        if (m->ctx < 0) {
+            int busy = 0;
+            for (int c = 0; c < cfg->rx_seg; c++) {
+                busy += ctx_owner[c] >= 0;
+                if (m->ctx < 0 && ctx_owner[c] < 0) {
+                    m->ctx = c;
+                }
+            }
+            if (m->ctx < 0) {
+                m->rejected = true;
+                if (m->attempt < SEG_ATTEMPTS) {
+                    r.seg_retries++;
+                    add_msg(m->src, GATEWAY, MSG_PROFILE, m->segments, m->attempt + 1,
+                            ev.at_ms + 200 + 50 * publish_ttl(m->src));
+                } else {
+                    r.seg_drops++;
+                }
+                continue;
+            }
+            ctx_owner[m->ctx] = ev.msg;
+            if (busy + 1 > r.seg_peak) {
+                r.seg_peak = busy + 1;
+            }
+        }
+        if (++m->received == m->segments) {
+            ctx_owner[m->ctx] = -1;
+            r.delivered++;
+            // The ack goes back through the mesh; its echoes reach the cache
+            add_msg(GATEWAY, m->src, MSG_GATEWAY, 1, 1, ev.at_ms);
+        }
+    }
+
+    free(cache.inserted_at);
+    free(cache.handled);
+    free(ctx_owner);
+    return r;
+}
+
+static int ram_bytes(const sim_config_t *c)
+{
+    return MESH_SCALE_RAM_BYTES(c->crpl, c->cache, c->lpn_count, c->sub_list, c->friend_seg_rx,
+                                c->friend_queue, c->rx_seg, c->rx_sdu, c->tx_seg);
+}
+
+static void print_row(const sim_config_t *c, const sim_result_t *r)
+{
+    printf("%-14s %5d %5d %4d %4d %9d %7d %6d %7d %6d %7.1f\n", c->name,
+           c->crpl, c->cache, c->rx_seg, c->lpn_count,
+           r->delivered, r->rpl_drops, r->seg_drops, r->seg_retries, r->duplicates,
+           ram_bytes(c) / 1024.0);
+}
+
+int main(void)
+{
+    build_mesh();
+
+    int relays = 0, max_hops = 0, lpns_in_range = 0;
+    for (int i = 0; i < NODE_COUNT; i++) {
+        relays += nodes[i].relay;
+        if (nodes[i].hops < 0) {
+            printf("FAIL: node %d cannot reach the gateway\n", i);
+            return 1;
+        }
+        if (nodes[i].hops > max_hops) {
+            max_hops = nodes[i].hops;
+        }
+    }
+    for (int k = 0; k < nodes[GATEWAY].neighbour_count; k++) {
+        lpns_in_range += !nodes[nodes[GATEWAY].neighbours[k]].relay;
+    }
+
+    // Stack defaults, with the Friend settings the gateway had before the profile
+    const sim_config_t stock = {
+        .name = "stack default", .crpl = 10, .cache = 10, .lpn_count = 5, .sub_list = 5,
+        .friend_seg_rx = 1, .friend_queue = 16, .rx_seg = 1, .rx_sdu = 384, .tx_seg = 1,
+    };
+    const sim_config_t scale = {
+        .name = "scale profile", .crpl = PROFILE_CRPL, .cache = PROFILE_MSG_CACHE_SIZE,
+        .lpn_count = PROFILE_FRIEND_LPN_COUNT, .sub_list = PROFILE_FRIEND_SUB_LIST_SIZE,
+        .friend_seg_rx = PROFILE_FRIEND_SEG_RX, .friend_queue = PROFILE_FRIEND_QUEUE_SIZE,
+        .rx_seg = PROFILE_RX_SEG_MSG_COUNT, .rx_sdu = PROFILE_RX_SDU_MAX,
+        .tx_seg = PROFILE_TX_SEG_MSG_COUNT,
+    };
+
+    // The tree as it ships: the gateway is the only Friend
+    int shipped_friendless = assign_friends(false, scale.lpn_count);
+
+    sim_result_t stock_r = run(&stock);
+    sim_result_t scale_r = run(&scale);
+
+    printf("%d nodes: %d relays/friends, %d LPNs, gateway up to %d hops away, %d LPNs in its range\n",
+           NODE_COUNT, relays, NODE_COUNT - relays, max_hops, lpns_in_range);
+    printf("%d messages to the gateway in %d s: %d presses/h, %d bins profiled every %d ms\n",
+           scale_r.messages, SIM_MS / 1000, PICKS_PER_HOUR, PROFILED_NODES, PROFILE_PERIOD_MS);
+    printf("%-14s %5s %5s %4s %4s %9s %7s %6s %7s %6s %7s\n", "config", "RPL", "cache", "seg",
+           "LPNs", "delivered", "RPL drop", "seg drop", "retries", "dupes", "RAM KiB");
+    print_row(&stock, &stock_r);
+    print_row(&scale, &scale_r);
+    printf("Without Relay/Friend nodes: %d of %d LPNs have no Friend\n",
+           shipped_friendless, NODE_COUNT - relays);
+    printf("Needed: RPL %d, cache %d, segment contexts %d (peak in use, retries absorb the rest)\n",
+           scale_r.sources, scale_r.cache_need, scale_r.seg_peak);
+
+    int failures = 0;
+    if (stock_r.rpl_drops == 0 || stock_r.duplicates == 0) {
+        printf("FAIL: the stack defaults drop nothing, the load does not reach their limits\n");
+        failures++;
+    }
+    if (scale_r.friendless_drops) {
+        printf("FAIL: %d messages from or to LPNs without a Friend; every LPN needs a Friend with "
+               "a free slot in range\n", scale_r.friendless_drops);
+        failures++;
+    }
+    if (scale_r.delivered != scale_r.messages || scale_r.rpl_drops || scale_r.seg_drops) {
+        printf("FAIL: the scale profile dropped %d of %d messages\n",
+               scale_r.messages - scale_r.delivered, scale_r.messages);
+        failures++;
+    }
+    if (scale_r.duplicates) {
+        printf("FAIL: %d copies got past the message cache\n", scale_r.duplicates);
+        failures++;
+    }
+    if (lpns_in_range > scale.lpn_count) {
+        printf("FAIL: %d LPNs in the gateway's range, %d Friend slots\n", lpns_in_range, scale.lpn_count);
+        failures++;
+    }
+    if (ram_bytes(&scale) > MESH_SCALE_RAM_BUDGET) {
+        printf("FAIL: the scale profile takes %d bytes, budget %d\n", ram_bytes(&scale), MESH_SCALE_RAM_BUDGET);
+        failures++;
+    }
+
+    free(msgs);
+    free(heap);
+    return failures ? 1 : 0;
+}
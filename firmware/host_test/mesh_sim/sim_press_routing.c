@@ -0,0 +1,269 @@
+/*
+ * Airtime of one press report in a 300-node warehouse mesh, sent to the
+ * 0xC000 group as before and to the gateway's unicast address as now.
+ *
+ * The model is managed flooding without collisions:
+ * - Bins stand on a 25 x 12 grid, 3 m apart along the aisle and 4 m across.
+ * - Every third column is mains powered: Relay and Friend, subscribed to
+ *   0xC000 like every endpoint.
+ * - The other bins are Low Power Nodes. Each has a Friend: the nearest
+ *   relay, or the gateway, in radio range.
+ * - The gateway stands at the middle of the left wall.
+ * - A node relays each network PDU once, the first time it sees it, and
+ *   only while the TTL it received is 2 or more. The destination of a
+ *   unicast PDU does not relay it.
+ * - LPNs do not scan. A Friend that hears a group PDU queues it for each
+ *   LPN subscribed to the group. The LPN fetches it on its next poll,
+ *   then polls again because of the More Data flag and gets a Friend
+ *   Update: three PDUs per LPN.
+ *
+ * Each LPN sends one report. The flat TTL rows use the TTL that reaches
+ * the farthest LPN, as a single network-wide setting must; the publication
+ * row uses each LPN's own hop count. Airtime counts one advertising event on
+ * the three channels per transmission.
+ */
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define COLS            25
+#define ROWS            12
+#define NODE_COUNT      (COLS * ROWS)
+#define GATEWAY         NODE_COUNT          // Index of the gateway
+#define SPACING_X_M     3.0
+#define SPACING_Y_M     4.0
+#define RANGE_M         10.0
+#define GROUP_ADDR_DST  (-1)
+
+// Network PDU of a PRESS_REPORT: 9 header, 1 transport, 3 opcode + 3 payload, 4 TransMIC, 4 NetMIC
+#define PRESS_NET_PDU_BYTES     24
+// Friend Update and Poll control PDUs
+#define UPDATE_NET_PDU_BYTES    (9 + 1 + 6 + 8)
+#define POLL_NET_PDU_BYTES      (9 + 1 + 1 + 8)
+
+typedef struct {
+    double x, y;
+    bool relay;         // Relay, Friend, scans
+    int friend;         // LPN only: its Friend
+    int hops;           // To the gateway over relays
+} sim_node_t;
+
+typedef struct {
+    int transmissions;      // Network PDUs on air, flood and Friend queues
+    int lpn_fetches;        // LPNs woken to fetch the PDU from their Friend
+    int processed;          // Nodes that decrypted it at the access layer
+    double airtime_ms;
+    bool reached_gateway;
+} flood_result_t;
+
+static sim_node_t nodes[NODE_COUNT + 1];
+
+// 1 Mbit/s: preamble, access address, header, AdvA, AD length and type, PDU, CRC; three channels
+static double adv_event_ms(int net_pdu_bytes)
+{
+    int bytes = 1 + 4 + 2 + 6 + 2 + net_pdu_bytes + 3;
+    return 3 * bytes * 8 / 1000.0;
+}
+
+static bool in_range(int a, int b)
+{
+    return hypot(nodes[a].x - nodes[b].x, nodes[a].y - nodes[b].y) <= RANGE_M;
+}
+
+static bool scans(int i)
+{
+    return i == GATEWAY || nodes[i].relay;
+}
+
+static void build_mesh(void)
+{
+    for (int i = 0; i < NODE_COUNT; i++) {
+        nodes[i].x = (i % COLS) * SPACING_X_M;
+        nodes[i].y = (i / COLS) * SPACING_Y_M;
+        nodes[i].relay = (i % COLS) % 3 == 1;
+    }
+    nodes[GATEWAY].x = -SPACING_X_M;
+    nodes[GATEWAY].y = (ROWS - 1) * SPACING_Y_M / 2;
+    nodes[GATEWAY].relay = true;
+
+    for (int i = 0; i < NODE_COUNT; i++) {
+        nodes[i].friend = -1;
+        if (nodes[i].relay) {
+            continue;
+        }
+        double best = RANGE_M + 1;
+        for (int f = 0; f <= NODE_COUNT; f++) {
+            double d = hypot(nodes[i].x - nodes[f].x, nodes[i].y - nodes[f].y);
+            if (scans(f) && d < best) {
+                best = d;
+                nodes[i].friend = f;
+            }
+        }
+    }
+
+    // Hops to the gateway: breadth first over the scanning nodes, LPNs one past their Friend
+    int queue[NODE_COUNT + 1];
+    int head = 0, tail = 0;
+    for (int i = 0; i <= NODE_COUNT; i++) {
+        nodes[i].hops = -1;
+    }
+    nodes[GATEWAY].hops = 0;
+    queue[tail++] = GATEWAY;
+    while (head < tail) {
+        int n = queue[head++];
+        for (int i = 0; i < NODE_COUNT; i++) {
+            if (nodes[i].relay && nodes[i].hops < 0 && in_range(n, i)) {
+                nodes[i].hops = nodes[n].hops + 1;
+                queue[tail++] = i;
+            }
+        }
+    }
+    for (int i = 0; i < NODE_COUNT; i++) {
+        if (!nodes[i].relay && nodes[i].friend >= 0 && nodes[nodes[i].friend].hops >= 0) {
+            nodes[i].hops = nodes[nodes[i].friend].hops + 1;
+        }
+    }
+}
+
+// dst is a node index or GROUP_ADDR_DST for 0xC000
+static flood_result_t flood(int src, int dst, int ttl)
+{
+    flood_result_t r = {0};
+    bool seen[NODE_COUNT + 1] = {false};
+    int queue[NODE_COUNT + 1];
+    int queue_ttl[NODE_COUNT + 1];
+    int head = 0, tail = 0;
+
+    seen[src] = true;
+    queue[tail] = src;
+    queue_ttl[tail++] = ttl + 1;    // The source sends with ttl, relays send with one less
+    while (head < tail) {
+        int n = queue[head];
+        int sent_ttl = queue_ttl[head++] - 1;
+        r.transmissions++;
+        r.airtime_ms += adv_event_ms(PRESS_NET_PDU_BYTES);
+
+        for (int i = 0; i <= NODE_COUNT; i++) {
+            if (seen[i] || !scans(i) || !in_range(n, i)) {
+                continue;
+            }
+            seen[i] = true;
+            if (i == dst || dst == GROUP_ADDR_DST) {
+                r.processed++;
+            }
+            if (i == GATEWAY) {
+                r.reached_gateway = true;
+            }
+            if (i != dst && sent_ttl >= 2) {
+                queue[tail] = i;
+                queue_ttl[tail++] = sent_ttl;
+            }
+        }
+    }
+
+    if (dst == GROUP_ADDR_DST) {
+        for (int i = 0; i < NODE_COUNT; i++) {
+            if (i != src && !nodes[i].relay && nodes[i].friend >= 0 && seen[nodes[i].friend]) {
+                r.lpn_fetches++;
+                r.processed++;
+                r.transmissions += 3;
+                r.airtime_ms += adv_event_ms(PRESS_NET_PDU_BYTES) +
+                                adv_event_ms(POLL_NET_PDU_BYTES) + adv_event_ms(UPDATE_NET_PDU_BYTES);
+            }
+        }
+    }
+    return r;
+}
+
+typedef struct {
+    const char *name;
+    double transmissions;
+    double lpn_fetches;
+    double processed;
+    double airtime_ms;
+    int unreached;
+} scenario_t;
+
+static void add(scenario_t *s, const flood_result_t *r)
+{
+    s->transmissions += r->transmissions;
+    s->lpn_fetches += r->lpn_fetches;
+    s->processed += r->processed;
+    s->airtime_ms += r->airtime_ms;
+    s->unreached += !r->reached_gateway;
+}
+
+static void print_row(const scenario_t *s, int reports, double baseline_ms)
+{
+    printf("%-30s %8.1f %8.1f %9.1f %10.2f %7.0f%% %5d\n", s->name,
+           s->transmissions / reports, s->lpn_fetches / reports, s->processed / reports,
+           s->airtime_ms / reports, 100.0 * (1.0 - s->airtime_ms / baseline_ms), s->unreached);
+}
+
+int main(void)
+{
+    build_mesh();
+
+    scenario_t group = { .name = "0xC000, flat TTL" };
+    scenario_t unicast = { .name = "gateway unicast, flat TTL" };
+    scenario_t publication = { .name = "publication, TTL = hops" };
+    int reports = 0;
+    int relays = 0;
+    int max_hops = 0;
+    int beyond_ttl3 = 0;
+    int beyond_ttl7 = 0;
+
+    for (int i = 0; i < NODE_COUNT; i++) {
+        relays += nodes[i].relay;
+        if (nodes[i].hops < 0) {
+            printf("FAIL: node %d cannot reach the gateway\n", i);
+            return 1;
+        }
+        if (nodes[i].hops > max_hops) {
+            max_hops = nodes[i].hops;
+        }
+    }
+
+    for (int i = 0; i < NODE_COUNT; i++) {
+        if (nodes[i].relay) {
+            continue;   // Mains-powered bins report the same way; the LPNs are the ones that count
+        }
+        beyond_ttl3 += nodes[i].hops > 3;
+        beyond_ttl7 += nodes[i].hops > 7;
+
+        flood_result_t r = flood(i, GROUP_ADDR_DST, max_hops);
+        add(&group, &r);
+        r = flood(i, GATEWAY, max_hops);
+        add(&unicast, &r);
+        // The provisioner sets the publication TTL to the hop count, never below 2
+        r = flood(i, GATEWAY, nodes[i].hops < 2 ? 2 : nodes[i].hops);
+        add(&publication, &r);
+        reports++;
+    }
+
+    printf("%d nodes: %d relays/friends, %d LPNs, gateway up to %d hops away\n",
+           NODE_COUNT, relays, reports, max_hops);
+    printf("LPNs out of reach with TTL 3: %d, with the stack default of 7: %d\n",
+           beyond_ttl3, beyond_ttl7);
+    printf("Per press report, averaged over every LPN, flat TTL %d:\n", max_hops);
+    printf("%-30s %8s %8s %9s %10s %8s %5s\n",
+           "destination", "PDUs", "fetches", "processed", "airtime ms", "saved", "lost");
+    print_row(&group, reports, group.airtime_ms);
+    print_row(&unicast, reports, group.airtime_ms);
+    print_row(&publication, reports, group.airtime_ms);
+
+    int failures = 0;
+    if (group.unreached || unicast.unreached || publication.unreached) {
+        printf("FAIL: a report did not reach the gateway\n");
+        failures++;
+    }
+    if (unicast.airtime_ms >= group.airtime_ms || publication.airtime_ms > unicast.airtime_ms) {
+        printf("FAIL: unicast routing does not save airtime\n");
+        failures++;
+    }
+    if (unicast.lpn_fetches != 0 || unicast.processed != reports) {
+        printf("FAIL: a unicast report woke a node other than the gateway\n");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
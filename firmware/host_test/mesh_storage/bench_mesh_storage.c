@@ -0,0 +1,126 @@
+/*
+ * Load/save benchmark for mesh_storage.c against the NVS emulator.
+ *
+ * Host timings only compare code paths; the NVS operation and entry counts
+ * are what carries over to the target, where each written 32-byte entry is
+ * a flash program and reads go through the NVS page cache.
+ *
+ * Usage: bench_mesh_storage_<variant> [iterations]
+ */
+#include "mesh_storage.c"
+#include "mesh_storage_harness.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const char *s_bench_models[] = { "onoff_srv", "onoff_cli" };
+#define MODEL_COUNT (sizeof(s_bench_models) / sizeof(s_bench_models[0]))
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// What a provisioner sends right after provisioning
+static void configure_node(bool flush_each_save)
+{
+    mesh_prov_data_t prov = sample_prov_data();
+    mesh_storage_save_prov_data(&prov);
+    if (flush_each_save) mesh_storage_flush();
+
+    prov.app_idx = 1;   // AppKey add
+    mesh_storage_save_prov_data(&prov);
+    if (flush_each_save) mesh_storage_flush();
+
+    for (size_t i = 0; i < MODEL_COUNT; i++) {
+        mesh_model_binding_t binding = { .bound = true, .app_idx = 1 };
+        mesh_pub_settings_t pub = { .publish_addr = 0xC000, .app_idx = 1, .ttl = 5 };
+
+        mesh_storage_save_model_binding(s_bench_models[i], &binding);
+        if (flush_each_save) mesh_storage_flush();
+        mesh_storage_save_pub_settings(s_bench_models[i], &pub);
+        if (flush_each_save) mesh_storage_flush();
+        for (uint16_t g = 0; g < 4; g++) {
+            mesh_storage_add_subscription(s_bench_models[i], 0xC100 + g);
+            if (flush_each_save) mesh_storage_flush();
+        }
+    }
+    settle();
+}
+
+// Everything app_main reads at boot
+static void load_all(void)
+{
+    mesh_prov_data_t prov;
+    mesh_storage_load_prov_data(&prov);
+    for (size_t i = 0; i < MODEL_COUNT; i++) {
+        mesh_model_binding_t binding;
+        mesh_pub_settings_t pub;
+        mesh_storage_load_model_binding(s_bench_models[i], &binding);
+        mesh_storage_load_pub_settings(s_bench_models[i], &pub);
+        size_t sub_count;
+        mesh_storage_load_subscriptions(s_bench_models[i], NULL, 0, &sub_count);
+    }
+}
+
+typedef enum {
+    SCENARIO_STORM_COALESCED,
+    SCENARIO_STORM_FLUSH_EACH,
+    SCENARIO_COLD_LOAD,
+    SCENARIO_WARM_LOAD,
+} scenario_t;
+
+static void run(const char *name, scenario_t scenario, int iterations)
+{
+    double total_us = 0;
+    nvs_emul_stats_t ops = { 0 };
+
+    for (int i = 0; i < iterations; i++) {
+        // Untimed setup
+        nvs_emul_reset();
+        reboot();
+        if (scenario == SCENARIO_COLD_LOAD || scenario == SCENARIO_WARM_LOAD) {
+            configure_node(false);
+            reboot();
+            if (scenario == SCENARIO_WARM_LOAD) {
+                load_all();
+            }
+        }
+        nvs_emul_reset_stats();
+
+        double start = now_us();
+        switch (scenario) {
+        case SCENARIO_STORM_COALESCED:  configure_node(false); break;
+        case SCENARIO_STORM_FLUSH_EACH: configure_node(true); break;
+        case SCENARIO_COLD_LOAD:
+        case SCENARIO_WARM_LOAD:        load_all(); break;
+        }
+        total_us += now_us() - start;
+
+        const nvs_emul_stats_t *st = nvs_emul_stats();
+        ops = *st;      // Identical every iteration
+    }
+
+    printf("%-28s %10.2f %7lu %7lu %8lu %8lu\n", name, total_us / iterations,
+           (unsigned long)ops.reads, (unsigned long)ops.writes,
+           (unsigned long)ops.commits, (unsigned long)ops.entries_written);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    if (iterations <= 0) {
+        iterations = 1;
+    }
+
+    printf("mesh_storage benchmark (%s, %d iterations)\n", MESH_STORAGE_VARIANT, iterations);
+    printf("%-28s %10s %7s %7s %8s %8s\n", "scenario", "host us", "reads", "writes", "commits", "entries");
+
+    run("config storm, coalesced", SCENARIO_STORM_COALESCED, iterations);
+    run("config storm, flush/save", SCENARIO_STORM_FLUSH_EACH, iterations);
+    run("boot load, cold", SCENARIO_COLD_LOAD, iterations);
+    run("load, cached", SCENARIO_WARM_LOAD, iterations);
+    return 0;
+}
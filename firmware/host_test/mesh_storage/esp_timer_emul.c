@@ -0,0 +1,112 @@
+/*
+ * Deterministic stand-in for esp_timer: a virtual clock that only moves
+ * through esp_timer_emul_advance(), which runs expired one-shot timers in
+ * the caller's context.
+ */
+#include "esp_timer_emul.h"
+#include <string.h>
+
+#define MAX_TIMERS 8
+
+struct esp_timer {
+    bool used;
+    bool armed;
+    uint64_t deadline_us;
+    esp_timer_cb_t callback;
+    void *arg;
+};
+
+static struct esp_timer s_timers[MAX_TIMERS];
+static uint64_t s_now_us = 0;
+
+void esp_timer_emul_reset(void)
+{
+    memset(s_timers, 0, sizeof(s_timers));
+    s_now_us = 0;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < MAX_TIMERS; i++) {
+        if (!s_timers[i].used) {
+            s_timers[i].used = true;
+            s_timers[i].armed = false;
+            s_timers[i].callback = create_args->callback;
+            s_timers[i].arg = create_args->arg;
+            *out_handle = &s_timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer == NULL || !timer->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = true;
+    timer->deadline_us = s_now_us + timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (timer == NULL || !timer->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)s_now_us;
+}
+
+int esp_timer_emul_advance(uint64_t us)
+{
+    uint64_t target = s_now_us + us;
+    int fired = 0;
+
+    // Run timers in deadline order; callbacks may re-arm
+    while (1) {
+        struct esp_timer *next = NULL;
+        for (size_t i = 0; i < MAX_TIMERS; i++) {
+            struct esp_timer *t = &s_timers[i];
+            if (t->used && t->armed && t->deadline_us <= target &&
+                (next == NULL || t->deadline_us < next->deadline_us)) {
+                next = t;
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+        s_now_us = next->deadline_us;
+        next->armed = false;
+        next->callback(next->arg);
+        fired++;
+    }
+
+    s_now_us = target;
+    return fired;
+}
+
+bool esp_timer_emul_armed(void)
+{
+    for (size_t i = 0; i < MAX_TIMERS; i++) {
+        if (s_timers[i].used && s_timers[i].armed) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,33 @@
+#ifndef ESP_TIMER_EMUL_H
+#define ESP_TIMER_EMUL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Forget every timer and reset the clock to zero
+ */
+void esp_timer_emul_reset(void);
+
+/**
+ * @brief Advance the clock, running one-shot timers that expire on the way
+ *
+ * @return Number of callbacks run
+ */
+int esp_timer_emul_advance(uint64_t us);
+
+/**
+ * @brief Check whether any timer is armed
+ */
+bool esp_timer_emul_armed(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESP_TIMER_EMUL_H
@@ -0,0 +1,47 @@
+/*
+ * Helpers shared by the mesh_storage tests and benchmark. Include after
+ * mesh_storage.c: reboot() resets its file-scope state.
+ */
+#pragma once
+
+#include "nvs_emul.h"
+#include "esp_timer_emul.h"
+
+// Power cycle: lose everything that only lived in RAM, keep what reached NVS
+static esp_err_t reboot(void)
+{
+    s_lock = NULL;
+    s_commit_timer = NULL;
+    s_commit_task = NULL;
+    memset(&s_prov, 0, sizeof(s_prov));
+    s_prov_cached = false;
+    s_prov_dirty = false;
+    s_model_count = 0;
+    esp_timer_emul_reset();
+    nvs_emul_power_restore();
+
+    return mesh_storage_init();
+}
+
+// Let the quiet period expire
+static void settle(void)
+{
+    esp_timer_emul_advance(MESH_STORAGE_COMMIT_DELAY_MS * 1000ULL);
+}
+
+static mesh_prov_data_t sample_prov_data(void)
+{
+    mesh_prov_data_t prov = {
+        .provisioned = true,
+        .node_addr = 0x0102,
+        .net_idx = 0x0003,
+        .app_idx = 0x0004,
+        .iv_index = 0x11223344,
+    };
+    for (int i = 0; i < 16; i++) {
+        prov.net_key[i] = 0xA0 + i;
+        prov.app_key[i] = 0xB0 + i;
+        prov.dev_key[i] = 0xC0 + i;
+    }
+    return prov;
+}
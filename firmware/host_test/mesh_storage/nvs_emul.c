@@ -0,0 +1,499 @@
+/*
+ * In-memory stand-in for the ESP-IDF NVS API.
+ *
+ * Entries are typed like the real implementation: reading a key with a
+ * different getter than it was written with reports ESP_ERR_NVS_NOT_FOUND.
+ * Key length, read-only handles and blob/string length checks follow the
+ * behaviour documented for nvs_flash. Writes are durable as soon as the set
+ * returns, as on target; nvs_commit() only counts.
+ *
+ * Two faults can be injected: a partition that runs out of entries, and a
+ * power cut after a given number of flash operations.
+ */
+#include "nvs_emul.h"
+#include "nvs_flash.h"
+#include "esp_rom_crc.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_ENTRIES     256
+#define MAX_HANDLES     16
+#define MAX_VALUE_SIZE  4000    // Largest blob nvs_flash accepts in one page
+#define ENTRY_SIZE      32
+
+typedef enum {
+    TYPE_U8,
+    TYPE_U16,
+    TYPE_U32,
+    TYPE_STR,
+    TYPE_BLOB,
+} entry_type_t;
+
+typedef struct {
+    bool used;
+    char ns[NVS_KEY_NAME_MAX_SIZE];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    entry_type_t type;
+    size_t len;
+    uint8_t data[MAX_VALUE_SIZE];
+} entry_t;
+
+typedef struct {
+    bool open;
+    char ns[NVS_KEY_NAME_MAX_SIZE];
+    nvs_open_mode_t mode;
+} handle_t;
+
+static entry_t s_entries[MAX_ENTRIES];
+static handle_t s_handles[MAX_HANDLES];
+static nvs_emul_stats_t s_stats;
+
+static size_t s_capacity = NVS_EMUL_DEFAULT_CAPACITY;
+static bool s_cut_armed = false;
+static uint32_t s_ops_until_cut = 0;
+static bool s_power_lost = false;
+
+void nvs_emul_reset(void)
+{
+    memset(s_entries, 0, sizeof(s_entries));
+    memset(s_handles, 0, sizeof(s_handles));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_capacity = NVS_EMUL_DEFAULT_CAPACITY;
+    nvs_emul_power_restore();
+}
+
+void nvs_emul_set_capacity(size_t entries)
+{
+    s_capacity = entries;
+}
+
+void nvs_emul_power_cut_after(uint32_t n)
+{
+    s_cut_armed = true;
+    s_ops_until_cut = n;
+    s_power_lost = false;
+}
+
+void nvs_emul_power_restore(void)
+{
+    s_cut_armed = false;
+    s_power_lost = false;
+}
+
+bool nvs_emul_power_lost(void)
+{
+    return s_power_lost;
+}
+
+// Called before every flash operation; false once the power is gone
+static bool flash_op_allowed(void)
+{
+    if (s_power_lost) {
+        return false;
+    }
+    if (s_cut_armed) {
+        if (s_ops_until_cut == 0) {
+            s_power_lost = true;
+            return false;
+        }
+        s_ops_until_cut--;
+    }
+    return true;
+}
+
+static size_t entry_span(entry_type_t type, size_t len)
+{
+    size_t data = (len + ENTRY_SIZE - 1) / ENTRY_SIZE;
+    switch (type) {
+    case TYPE_STR:  return 1 + data;
+    case TYPE_BLOB: return 2 + data;    // Blob index + data chunk header
+    default:        return 1;
+    }
+}
+
+void nvs_emul_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+const nvs_emul_stats_t *nvs_emul_stats(void)
+{
+    return &s_stats;
+}
+
+static entry_t *find_entry(const char *ns, const char *key)
+{
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        if (s_entries[i].used && strcmp(s_entries[i].ns, ns) == 0 && strcmp(s_entries[i].key, key) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static size_t count_namespaces(void)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        if (!s_entries[i].used) {
+            continue;
+        }
+        // Count each namespace at its first key
+        bool first = true;
+        for (size_t j = 0; j < i && first; j++) {
+            first = !(s_entries[j].used && strcmp(s_entries[j].ns, s_entries[i].ns) == 0);
+        }
+        count += first ? 1 : 0;
+    }
+    return count;
+}
+
+size_t nvs_emul_used_entries(void)
+{
+    size_t used = count_namespaces();     // One entry per namespace
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        if (s_entries[i].used) {
+            used += entry_span(s_entries[i].type, s_entries[i].len);
+        }
+    }
+    return used;
+}
+
+static bool namespace_exists(const char *ns)
+{
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        if (s_entries[i].used && strcmp(s_entries[i].ns, ns) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool nvs_emul_exists(const char *namespace_name, const char *key)
+{
+    return find_entry(namespace_name, key) != NULL;
+}
+
+esp_err_t nvs_emul_corrupt_blob(const char *namespace_name, const char *key, size_t offset)
+{
+    entry_t *e = find_entry(namespace_name, key);
+    if (e == NULL || e->type != TYPE_BLOB) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (offset >= e->len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    e->data[offset] ^= 0xFF;
+    return ESP_OK;
+}
+
+static handle_t *get_handle(nvs_handle_t handle)
+{
+    if (handle == 0 || handle > MAX_HANDLES || !s_handles[handle - 1].open) {
+        return NULL;
+    }
+    return &s_handles[handle - 1];
+}
+
+static esp_err_t check_key(const char *key)
+{
+    if (key == NULL || key[0] == '\0') {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t write_entry(nvs_handle_t handle, const char *key, entry_type_t type,
+                             const void *data, size_t len)
+{
+    s_stats.writes++;
+
+    handle_t *h = get_handle(handle);
+    if (h == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (h->mode == NVS_READONLY) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    esp_err_t err = check_key(key);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (len > MAX_VALUE_SIZE) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    // The new value is written before the old one is erased, so it must fit
+    // next to it; a new namespace also takes an entry
+    entry_t *e = find_entry(h->ns, key);
+    size_t needed = entry_span(type, len) + (namespace_exists(h->ns) ? 0 : 1);
+    if (nvs_emul_used_entries() + needed > s_capacity) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    if (!flash_op_allowed()) {
+        return ESP_FAIL;
+    }
+
+    if (e == NULL) {
+        for (size_t i = 0; i < MAX_ENTRIES && e == NULL; i++) {
+            if (!s_entries[i].used) {
+                e = &s_entries[i];
+            }
+        }
+        if (e == NULL) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        e->used = true;
+        strcpy(e->ns, h->ns);
+        strcpy(e->key, key);
+    }
+    e->type = type;
+    e->len = len;
+    memcpy(e->data, data, len);
+    s_stats.entries_written += entry_span(type, len);
+    return ESP_OK;
+}
+
+static esp_err_t read_entry(nvs_handle_t handle, const char *key, entry_type_t type, entry_t **out)
+{
+    s_stats.reads++;
+
+    handle_t *h = get_handle(handle);
+    if (h == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    esp_err_t err = check_key(key);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    entry_t *e = find_entry(h->ns, key);
+    if (e == NULL || e->type != type) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out = e;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    memset(s_entries, 0, sizeof(s_entries));
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_stats(const char *part_name, nvs_stats_t *nvs_stats)
+{
+    if (nvs_stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t used = nvs_emul_used_entries();
+    nvs_stats->used_entries = used;
+    nvs_stats->free_entries = s_capacity - used;
+    nvs_stats->available_entries = s_capacity - used;
+    nvs_stats->total_entries = s_capacity;
+    nvs_stats->namespace_count = count_namespaces();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    s_stats.opens++;
+
+    if (namespace_name == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strlen(namespace_name) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    // Read-only opens of a namespace that was never written fail, as on target
+    if (open_mode == NVS_READONLY && !namespace_exists(namespace_name)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    for (size_t i = 0; i < MAX_HANDLES; i++) {
+        if (!s_handles[i].open) {
+            s_handles[i].open = true;
+            s_handles[i].mode = open_mode;
+            strcpy(s_handles[i].ns, namespace_name);
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    handle_t *h = get_handle(handle);
+    if (h != NULL) {
+        h->open = false;
+    }
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    s_stats.commits++;
+    return get_handle(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    s_stats.erases++;
+
+    handle_t *h = get_handle(handle);
+    if (h == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (h->mode == NVS_READONLY) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    entry_t *e = find_entry(h->ns, key);
+    if (e == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (!flash_op_allowed()) {
+        return ESP_FAIL;
+    }
+    e->used = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    s_stats.erases++;
+
+    handle_t *h = get_handle(handle);
+    if (h == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (h->mode == NVS_READONLY) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (!flash_op_allowed()) {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        if (s_entries[i].used && strcmp(s_entries[i].ns, h->ns) == 0) {
+            s_entries[i].used = false;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return write_entry(handle, key, TYPE_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value)
+{
+    return write_entry(handle, key, TYPE_U16, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return write_entry(handle, key, TYPE_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return write_entry(handle, key, TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return write_entry(handle, key, TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    entry_t *e;
+    esp_err_t err = read_entry(handle, key, TYPE_U8, &e);
+    if (err == ESP_OK) {
+        memcpy(out_value, e->data, sizeof(*out_value));
+    }
+    return err;
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *out_value)
+{
+    entry_t *e;
+    esp_err_t err = read_entry(handle, key, TYPE_U16, &e);
+    if (err == ESP_OK) {
+        memcpy(out_value, e->data, sizeof(*out_value));
+    }
+    return err;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    entry_t *e;
+    esp_err_t err = read_entry(handle, key, TYPE_U32, &e);
+    if (err == ESP_OK) {
+        memcpy(out_value, e->data, sizeof(*out_value));
+    }
+    return err;
+}
+
+// Shared by strings and blobs: a NULL buffer queries the length
+static esp_err_t read_variable(nvs_handle_t handle, const char *key, entry_type_t type,
+                               void *out_value, size_t *length)
+{
+    entry_t *e;
+    esp_err_t err = read_entry(handle, key, type, &e);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (out_value == NULL) {
+        *length = e->len;
+        return ESP_OK;
+    }
+    if (*length < e->len) {
+        *length = e->len;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, e->data, e->len);
+    *length = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return read_variable(handle, key, TYPE_STR, out_value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return read_variable(handle, key, TYPE_BLOB, out_value, length);
+}
+
+/* Other ESP-IDF symbols the firmware sources link against */
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    static char buf[16];
+    snprintf(buf, sizeof(buf), "0x%x", code);
+    return buf;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    // Same reflected CRC-32 (poly 0xEDB88320) as the ROM routine
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,87 @@
+#ifndef NVS_EMUL_H
+#define NVS_EMUL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Operation counters, reset by nvs_emul_reset()
+typedef struct {
+    uint32_t opens;
+    uint32_t reads;             // nvs_get_* calls
+    uint32_t writes;            // nvs_set_* calls
+    uint32_t erases;            // nvs_erase_key / nvs_erase_all calls
+    uint32_t commits;
+    uint32_t entries_written;   // 32-byte flash entries written by successful sets
+} nvs_emul_stats_t;
+
+// Entries of the firmware's 0x40000 NVS partition: 64 pages of 126, one kept free
+#define NVS_EMUL_DEFAULT_CAPACITY   (63 * 126)
+
+/**
+ * @brief Drop every stored entry, zero the counters and clear injected faults
+ */
+void nvs_emul_reset(void);
+
+/**
+ * @brief Zero the counters, keeping the stored entries
+ */
+void nvs_emul_reset_stats(void);
+
+const nvs_emul_stats_t *nvs_emul_stats(void);
+
+/**
+ * @brief Check whether a key exists in a namespace (any type)
+ */
+bool nvs_emul_exists(const char *namespace_name, const char *key);
+
+/**
+ * @brief Flip the bits of one byte of a stored blob
+ *
+ * @return ESP_OK, ESP_ERR_NVS_NOT_FOUND or ESP_ERR_INVALID_ARG if offset is out of range
+ */
+esp_err_t nvs_emul_corrupt_blob(const char *namespace_name, const char *key, size_t offset);
+
+/**
+ * @brief Limit the partition size in 32-byte entries
+ *
+ * Sets that do not fit fail with ESP_ERR_NVS_NOT_ENOUGH_SPACE. Entries are
+ * counted as nvs_flash lays them out: one for an integer, a header plus one
+ * per 32 data bytes for a string, and an extra index entry for a blob.
+ */
+void nvs_emul_set_capacity(size_t entries);
+
+/**
+ * @brief Entries currently used, including one per namespace
+ */
+size_t nvs_emul_used_entries(void);
+
+/**
+ * @brief Simulate power loss after the next n flash operations
+ *
+ * Sets and erases up to the cut succeed; every one after it fails with
+ * ESP_FAIL and leaves the store untouched, as if the device had stopped.
+ * Each completed operation is atomic, like a single nvs_flash entry write.
+ */
+void nvs_emul_power_cut_after(uint32_t n);
+
+/**
+ * @brief Power back on: clear a pending or triggered power cut
+ */
+void nvs_emul_power_restore(void);
+
+/**
+ * @brief Check whether an injected power cut has been reached
+ */
+bool nvs_emul_power_lost(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NVS_EMUL_H
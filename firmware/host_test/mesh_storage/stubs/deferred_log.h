@@ -0,0 +1,10 @@
+#pragma once
+// Host stand-in for components/deferred_log: logging is dropped
+
+#include <stdint.h>
+
+#define DLOG_STR(s) ((uintptr_t)(s))
+#define DLOG_E(tag, fmt, ...) do { (void)(tag); } while (0)
+#define DLOG_W(tag, fmt, ...) do { (void)(tag); } while (0)
+#define DLOG_I(tag, fmt, ...) do { (void)(tag); } while (0)
+#define DLOG_D(tag, fmt, ...) do { (void)(tag); } while (0)
@@ -0,0 +1,5 @@
+#pragma once
+// Host stand-in: mesh_storage.h only needs the standard integer types
+
+#include <stdint.h>
+#include <stdbool.h>
@@ -0,0 +1,10 @@
+#pragma once
+// Host stand-in for the ESP-IDF header of the same name: logging is dropped
+
+#include <stdio.h>     // Pulled in by the real header; callers rely on it for snprintf
+
+#define ESP_LOGE(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGW(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGI(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGV(tag, fmt, ...) do { (void)(tag); } while (0)
@@ -0,0 +1,6 @@
+#pragma once
+// Host stand-in for the ROM CRC helpers
+
+#include <stdint.h>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
@@ -0,0 +1,62 @@
+#pragma once
+// Host stand-in: the tests are single threaded, so a task runs in the
+// context that notifies it, one pass of its loop per notification
+
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+
+#define tskIDLE_PRIORITY    0
+#define TASK_EMUL_MAX       4
+
+typedef void (*TaskFunction_t)(void *arg);
+
+typedef struct task_emul {
+    TaskFunction_t fn;
+    void *arg;
+    uint32_t notified;
+} *TaskHandle_t;
+
+static struct task_emul s_task_emul[TASK_EMUL_MAX];
+static TaskHandle_t s_task_emul_running = NULL;
+
+// A task created again after a reboot() takes its old slot
+static inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                     void *arg, UBaseType_t priority, TaskHandle_t *out_handle)
+{
+    for (size_t i = 0; i < TASK_EMUL_MAX; i++) {
+        TaskHandle_t t = &s_task_emul[i];
+        if (t->fn == NULL || (t->fn == fn && t->arg == arg)) {
+            *t = (struct task_emul){ .fn = fn, .arg = arg };
+            if (out_handle) {
+                *out_handle = t;
+            }
+            return pdPASS;
+        }
+    }
+    return pdFAIL;
+}
+
+static inline void vTaskDelete(TaskHandle_t task)
+{
+}
+
+// Returns once no notification is left, as the task then waits for the next
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    TaskHandle_t t = s_task_emul_running;
+    uint32_t count = t->notified;
+    t->notified = clear_on_exit || count == 0 ? 0 : count - 1;
+    return count;
+}
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    task->notified++;
+    if (task != s_task_emul_running) {
+        TaskHandle_t caller = s_task_emul_running;
+        s_task_emul_running = task;
+        task->fn(task->arg);
+        s_task_emul_running = caller;
+    }
+    return pdPASS;
+}
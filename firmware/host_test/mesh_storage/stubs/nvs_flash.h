@@ -0,0 +1,7 @@
+#pragma once
+// Host stand-in, backed by nvs_emul.c
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
@@ -0,0 +1,2 @@
+#pragma once
+// Host build: the CONFIG_ options come from CMakeLists.txt, per variant
@@ -0,0 +1,746 @@
+/*
+ * Host tests for mesh_storage.c, built once per firmware variant against
+ * the in-memory NVS emulator. The source is included directly so a reboot
+ * can be simulated by dropping its RAM state.
+ */
+#include "mesh_storage.c"
+#include "mesh_storage_harness.h"
+#include <stdio.h>
+
+static int s_failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("    FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            s_failures++; \
+        } \
+    } while (0)
+
+#define RUN(test) do { \
+        int before = s_failures; \
+        nvs_emul_reset(); \
+        CHECK(reboot() == ESP_OK); \
+        test(); \
+        printf("%s %s\n", s_failures == before ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+static void write_legacy_prov_data(const mesh_prov_data_t *prov)
+{
+    nvs_handle_t h;
+    CHECK(nvs_open(MESH_NVS_NAMESPACE, NVS_READWRITE, &h) == ESP_OK);
+    CHECK(nvs_set_u8(h, NVS_KEY_PROVISIONED, prov->provisioned ? 1 : 0) == ESP_OK);
+    CHECK(nvs_set_u16(h, NVS_KEY_NODE_ADDR, prov->node_addr) == ESP_OK);
+    CHECK(nvs_set_u16(h, NVS_KEY_NET_IDX, prov->net_idx) == ESP_OK);
+    CHECK(nvs_set_u16(h, NVS_KEY_APP_IDX, prov->app_idx) == ESP_OK);
+    CHECK(nvs_set_blob(h, NVS_KEY_NET_KEY, prov->net_key, 16) == ESP_OK);
+    CHECK(nvs_set_blob(h, NVS_KEY_APP_KEY, prov->app_key, 16) == ESP_OK);
+    CHECK(nvs_set_blob(h, NVS_KEY_DEV_KEY, prov->dev_key, 16) == ESP_OK);
+    CHECK(nvs_set_u32(h, NVS_KEY_IV_INDEX, prov->iv_index) == ESP_OK);
+    CHECK(nvs_commit(h) == ESP_OK);
+    nvs_close(h);
+}
+
+static bool prov_equal(const mesh_prov_data_t *a, const mesh_prov_data_t *b)
+{
+    return a->provisioned == b->provisioned && a->node_addr == b->node_addr &&
+           a->net_idx == b->net_idx && a->app_idx == b->app_idx && a->iv_index == b->iv_index &&
+           memcmp(a->net_key, b->net_key, 16) == 0 && memcmp(a->app_key, b->app_key, 16) == 0 &&
+           memcmp(a->dev_key, b->dev_key, 16) == 0;
+}
+
+static void test_prov_roundtrip(void)
+{
+    mesh_prov_data_t in = sample_prov_data(), out;
+
+    CHECK(mesh_storage_save_prov_data(&in) == ESP_OK);
+    settle();
+    CHECK(nvs_emul_stats()->writes == 1);
+    CHECK(nvs_emul_stats()->commits == 1);
+
+    CHECK(reboot() == ESP_OK);
+    nvs_emul_reset_stats();
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+    CHECK(prov_equal(&in, &out));
+    CHECK(nvs_emul_stats()->reads == 1);
+
+    CHECK(mesh_storage_is_provisioned());
+}
+
+static void test_prov_not_provisioned(void)
+{
+    mesh_prov_data_t out;
+
+    CHECK(mesh_storage_load_prov_data(&out) != ESP_OK);
+    CHECK(!mesh_storage_is_provisioned());
+
+    mesh_prov_data_t in = sample_prov_data();
+    in.provisioned = false;
+    CHECK(mesh_storage_save_prov_data(&in) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(reboot() == ESP_OK);
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_ERR_NOT_FOUND);
+    CHECK(!mesh_storage_is_provisioned());
+}
+
+#if CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+
+static void test_prov_legacy_migration(void)
+{
+    mesh_prov_data_t in = sample_prov_data(), out;
+    write_legacy_prov_data(&in);
+    CHECK(mesh_storage_is_provisioned());
+
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+    CHECK(prov_equal(&in, &out));
+    CHECK(nvs_emul_exists(MESH_NVS_NAMESPACE, NVS_KEY_PROV_BLOB));
+    CHECK(!nvs_emul_exists(MESH_NVS_NAMESPACE, NVS_KEY_PROVISIONED));
+    CHECK(!nvs_emul_exists(MESH_NVS_NAMESPACE, NVS_KEY_NET_KEY));
+    CHECK(!nvs_emul_exists(MESH_NVS_NAMESPACE, NVS_KEY_IV_INDEX));
+
+    // Second boot reads the blob only
+    CHECK(reboot() == ESP_OK);
+    nvs_emul_reset_stats();
+    memset(&out, 0, sizeof(out));
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+    CHECK(prov_equal(&in, &out));
+    CHECK(nvs_emul_stats()->reads == 1);
+    CHECK(nvs_emul_stats()->writes == 0);
+}
+
+static void test_prov_legacy_unprovisioned_not_migrated(void)
+{
+    mesh_prov_data_t in = sample_prov_data(), out;
+    in.provisioned = false;
+    write_legacy_prov_data(&in);
+
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_ERR_NOT_FOUND);
+    CHECK(!nvs_emul_exists(MESH_NVS_NAMESPACE, NVS_KEY_PROV_BLOB));
+}
+
+#else // CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+
+static void test_prov_legacy_keys_ignored(void)
+{
+    mesh_prov_data_t in = sample_prov_data(), out;
+    write_legacy_prov_data(&in);
+
+    CHECK(!mesh_storage_is_provisioned());
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_ERR_NOT_FOUND);
+    CHECK(!nvs_emul_exists(MESH_NVS_NAMESPACE, NVS_KEY_PROV_BLOB));
+    CHECK(nvs_emul_exists(MESH_NVS_NAMESPACE, NVS_KEY_PROVISIONED));
+}
+
+#endif // CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+
+static void test_prov_interrupted_migration(void)
+{
+    // Reset after the blob commit but before the legacy keys were erased:
+    // both layouts are present and the blob must win
+    mesh_prov_data_t legacy = sample_prov_data(), current = sample_prov_data(), out;
+    legacy.iv_index = 1;
+    write_legacy_prov_data(&legacy);
+    CHECK(mesh_storage_save_prov_data(&current) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(reboot() == ESP_OK);
+
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+    CHECK(prov_equal(&current, &out));
+}
+
+static void test_prov_corrupt_blob_rejected(void)
+{
+    mesh_prov_data_t in = sample_prov_data(), out;
+    CHECK(mesh_storage_save_prov_data(&in) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(reboot() == ESP_OK);
+
+    // Flip a byte inside the device key
+    CHECK(nvs_emul_corrupt_blob(MESH_NVS_NAMESPACE, NVS_KEY_PROV_BLOB, offsetof(prov_blob_t, dev_key) + 3) == ESP_OK);
+
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_ERR_INVALID_CRC);
+    CHECK(!out.provisioned);
+    CHECK(!mesh_storage_is_provisioned());
+}
+
+static void test_prov_bad_size_and_version_rejected(void)
+{
+    mesh_prov_data_t in = sample_prov_data(), out;
+    prov_blob_t blob;
+    nvs_handle_t h;
+
+    // Future version with a valid CRC
+    prov_blob_encode(&in, 0, &blob);
+    blob.version = PROV_BLOB_VERSION + 1;
+    blob.crc = esp_rom_crc32_le(0, (const uint8_t *)&blob, offsetof(prov_blob_t, crc));
+    CHECK(nvs_open(MESH_NVS_NAMESPACE, NVS_READWRITE, &h) == ESP_OK);
+    CHECK(nvs_set_blob(h, NVS_KEY_PROV_BLOB, &blob, sizeof(blob)) == ESP_OK);
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_ERR_INVALID_VERSION);
+
+    // Truncated blob
+    CHECK(nvs_set_blob(h, NVS_KEY_PROV_BLOB, &blob, sizeof(blob) - 4) == ESP_OK);
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_ERR_INVALID_SIZE);
+
+    nvs_close(h);
+}
+
+static void test_prov_clear(void)
+{
+    mesh_prov_data_t in = sample_prov_data(), out;
+    CHECK(mesh_storage_save_prov_data(&in) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(mesh_storage_clear() == ESP_OK);
+    CHECK(!mesh_storage_is_provisioned());
+    CHECK(mesh_storage_load_prov_data(&out) != ESP_OK);
+
+    // A save still pending when storage is cleared must not come back
+    CHECK(mesh_storage_save_prov_data(&in) == ESP_OK);
+    CHECK(mesh_storage_clear() == ESP_OK);
+    CHECK(!esp_timer_emul_armed());
+    settle();
+    CHECK(reboot() == ESP_OK);
+    CHECK(!mesh_storage_is_provisioned());
+}
+
+static void test_saves_wait_for_quiet_period(void)
+{
+    mesh_prov_data_t in = sample_prov_data();
+    mesh_model_binding_t binding = { .bound = true, .app_idx = 1 };
+
+    CHECK(mesh_storage_save_prov_data(&in) == ESP_OK);
+    CHECK(esp_timer_emul_armed());
+
+    // Each save restarts the quiet period
+    esp_timer_emul_advance(MESH_STORAGE_COMMIT_DELAY_MS * 1000ULL - 1000);
+    CHECK(mesh_storage_save_model_binding("onoff_srv", &binding) == ESP_OK);
+    esp_timer_emul_advance(MESH_STORAGE_COMMIT_DELAY_MS * 1000ULL - 1000);
+    CHECK(nvs_emul_stats()->commits == 0);
+
+    esp_timer_emul_advance(1000);
+    CHECK(nvs_emul_stats()->commits == 1);
+    CHECK(nvs_emul_stats()->writes == 2);
+    CHECK(!esp_timer_emul_armed());
+}
+
+static void test_config_storm_single_commit(void)
+{
+    // Provisioning followed by the configuration a provisioner sends right after
+    mesh_prov_data_t prov = sample_prov_data(), out;
+    CHECK(mesh_storage_save_prov_data(&prov) == ESP_OK);
+
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+    out.app_idx = 7;
+    CHECK(mesh_storage_save_prov_data(&out) == ESP_OK);
+
+    const char *models[] = { "onoff_srv", "onoff_cli" };
+    for (int i = 0; i < 2; i++) {
+        mesh_model_binding_t binding = { .bound = true, .app_idx = 7 };
+        mesh_pub_settings_t pub = { .publish_addr = 0xC000, .app_idx = 7, .ttl = 5, .period = 0 };
+        CHECK(mesh_storage_save_model_binding(models[i], &binding) == ESP_OK);
+        CHECK(mesh_storage_save_pub_settings(models[i], &pub) == ESP_OK);
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+        CHECK(mesh_storage_add_subscription(models[i], 0xC001) == ESP_OK);
+        CHECK(mesh_storage_add_subscription(models[i], 0xC002) == ESP_OK);
+#endif
+    }
+    CHECK(nvs_emul_stats()->writes == 0);
+    CHECK(nvs_emul_stats()->commits == 0);
+
+    settle();
+    CHECK(nvs_emul_stats()->commits == 1);
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+    CHECK(nvs_emul_stats()->writes == 5);   // prov + two model records + two subscription chunks
+#else
+    CHECK(nvs_emul_stats()->writes == 3);
+#endif
+
+    CHECK(reboot() == ESP_OK);
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+    CHECK(out.app_idx == 7);
+    for (int i = 0; i < 2; i++) {
+        mesh_model_binding_t binding;
+        mesh_pub_settings_t pub;
+        CHECK(mesh_storage_load_model_binding(models[i], &binding) == ESP_OK);
+        CHECK(binding.bound && binding.app_idx == 7);
+        CHECK(mesh_storage_load_pub_settings(models[i], &pub) == ESP_OK);
+        CHECK(pub.publish_addr == 0xC000 && pub.app_idx == 7 && pub.ttl == 5);
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+        uint16_t addrs[4];
+        size_t count;
+        CHECK(mesh_storage_load_subscriptions(models[i], addrs, 4, &count) == ESP_OK);
+        CHECK(count == 2 && addrs[0] == 0xC001 && addrs[1] == 0xC002);
+#endif
+    }
+}
+
+static void test_flush_before_restart(void)
+{
+    mesh_model_binding_t binding = { .bound = true, .app_idx = 2 }, out;
+
+    // Without a flush the pending save is lost on restart
+    CHECK(mesh_storage_save_model_binding("onoff_srv", &binding) == ESP_OK);
+    CHECK(reboot() == ESP_OK);
+    CHECK(mesh_storage_load_model_binding("onoff_srv", &out) == ESP_ERR_NOT_FOUND);
+
+    CHECK(mesh_storage_save_model_binding("onoff_srv", &binding) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(!esp_timer_emul_armed());
+    CHECK(nvs_emul_stats()->commits == 1);
+    CHECK(reboot() == ESP_OK);
+    CHECK(mesh_storage_load_model_binding("onoff_srv", &out) == ESP_OK);
+    CHECK(out.app_idx == 2);
+
+    // Nothing pending: no flash access
+    nvs_emul_reset_stats();
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(nvs_emul_stats()->writes == 0 && nvs_emul_stats()->commits == 0);
+}
+
+static void test_model_cache_eviction(void)
+{
+    // More models than cache slots: dirty records are committed, not dropped
+    char id[8];
+    mesh_model_binding_t binding = { .bound = true }, out;
+    for (int i = 0; i < MESH_STORAGE_CACHED_MODELS + 2; i++) {
+        snprintf(id, sizeof(id), "mdl%d", i);
+        binding.app_idx = i;
+        CHECK(mesh_storage_save_model_binding(id, &binding) == ESP_OK);
+    }
+    CHECK(mesh_storage_flush() == ESP_OK);
+
+    CHECK(reboot() == ESP_OK);
+    for (int i = 0; i < MESH_STORAGE_CACHED_MODELS + 2; i++) {
+        snprintf(id, sizeof(id), "mdl%d", i);
+        CHECK(mesh_storage_load_model_binding(id, &out) == ESP_OK);
+        CHECK(out.app_idx == i);
+    }
+}
+
+static void test_model_id_too_long(void)
+{
+    mesh_model_binding_t binding = { .bound = true };
+    CHECK(mesh_storage_save_model_binding("model_id_too_long", &binding) == ESP_ERR_INVALID_ARG);
+}
+
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+static bool sub_chunk_exists(size_t chunk, const char *model_id)
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    sub_key(chunk, model_id, key);
+    return nvs_emul_exists(MESH_NVS_NAMESPACE, key);
+}
+
+// Subscriptions of a model read back in full, checking they are sorted
+static size_t load_subs(const char *model_id, uint16_t *addrs)
+{
+    size_t count = 0;
+    esp_err_t err = mesh_storage_load_subscriptions(model_id, addrs, MESH_STORAGE_SUB_MAX, &count);
+    CHECK(err == ESP_OK || err == ESP_ERR_NOT_FOUND);
+    for (size_t i = 1; i < count; i++) {
+        CHECK(addrs[i - 1] < addrs[i]);
+    }
+    return count;
+}
+
+static void test_subscription_add_remove(void)
+{
+    uint16_t addrs[MESH_STORAGE_SUB_MAX];
+    size_t count;
+
+    CHECK(mesh_storage_add_subscription("onoff_srv", 0xC002) == ESP_OK);
+    CHECK(mesh_storage_add_subscription("onoff_srv", 0xC001) == ESP_OK);
+    CHECK(mesh_storage_add_subscription("onoff_srv", 0xC001) == ESP_OK);
+    CHECK(load_subs("onoff_srv", addrs) == 2);
+    CHECK(addrs[0] == 0xC001 && addrs[1] == 0xC002);
+    CHECK(mesh_storage_has_subscription("onoff_srv", 0xC002));
+    CHECK(!mesh_storage_has_subscription("onoff_srv", 0xC003));
+    CHECK(!mesh_storage_has_subscription("onoff_cli", 0xC001));
+
+    // Count only
+    CHECK(mesh_storage_load_subscriptions("onoff_srv", NULL, 0, &count) == ESP_OK);
+    CHECK(count == 2);
+
+    CHECK(mesh_storage_remove_subscription("onoff_srv", 0xC003) == ESP_ERR_NOT_FOUND);
+    CHECK(mesh_storage_remove_subscription("onoff_srv", 0xC001) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(reboot() == ESP_OK);
+    CHECK(load_subs("onoff_srv", addrs) == 1);
+    CHECK(addrs[0] == 0xC002);
+
+    // Removing the last address drops the key
+    CHECK(mesh_storage_remove_subscription("onoff_srv", 0xC002) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(!sub_chunk_exists(0, "onoff_srv"));
+    CHECK(reboot() == ESP_OK);
+    CHECK(mesh_storage_load_subscriptions("onoff_srv", addrs, 1, &count) == ESP_ERR_NOT_FOUND);
+    CHECK(count == 0);
+}
+
+static void test_subscription_many_groups(void)
+{
+    uint16_t addrs[MESH_STORAGE_SUB_MAX];
+
+    // Zone and wave groups joined in no particular order
+    for (int i = 0; i < MESH_STORAGE_SUB_MAX; i++) {
+        uint16_t addr = 0xC000 + (i * 37) % MESH_STORAGE_SUB_MAX;
+        CHECK(mesh_storage_add_subscription("onoff_srv", addr) == ESP_OK);
+    }
+    CHECK(mesh_storage_add_subscription("onoff_srv", 0xD000) == ESP_ERR_NO_MEM);
+    CHECK(mesh_storage_add_subscription("onoff_srv", 0xC000) == ESP_OK);   // Already there
+    CHECK(mesh_storage_flush() == ESP_OK);
+
+    size_t chunks = (MESH_STORAGE_SUB_MAX + MESH_STORAGE_SUB_CHUNK - 1) / MESH_STORAGE_SUB_CHUNK;
+    CHECK(sub_chunk_exists(chunks - 1, "onoff_srv"));
+    CHECK(!sub_chunk_exists(chunks, "onoff_srv"));
+
+    CHECK(reboot() == ESP_OK);
+    CHECK(load_subs("onoff_srv", addrs) == MESH_STORAGE_SUB_MAX);
+    CHECK(addrs[0] == 0xC000 && addrs[MESH_STORAGE_SUB_MAX - 1] == 0xC000 + MESH_STORAGE_SUB_MAX - 1);
+    for (int i = 0; i < MESH_STORAGE_SUB_MAX; i++) {
+        CHECK(mesh_storage_has_subscription("onoff_srv", 0xC000 + i));
+    }
+    CHECK(!mesh_storage_has_subscription("onoff_srv", 0xC000 + MESH_STORAGE_SUB_MAX));
+
+    // Nothing changed since the load: nothing to write
+    nvs_emul_reset_stats();
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(nvs_emul_stats()->writes == 0);
+}
+
+static void test_subscription_rewrites_changed_chunks(void)
+{
+    const int n = 2 * MESH_STORAGE_SUB_CHUNK;
+    for (int i = 0; i < n; i++) {
+        CHECK(mesh_storage_add_subscription("onoff_srv", 0xC100 + i) == ESP_OK);
+    }
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(nvs_emul_stats()->writes == 2);
+
+    // Next group in sequence: only the new last chunk
+    nvs_emul_reset_stats();
+    CHECK(mesh_storage_add_subscription("onoff_srv", 0xC100 + n) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(nvs_emul_stats()->writes == 1);
+    CHECK(sub_chunk_exists(2, "onoff_srv"));
+
+    // Removing from the second chunk leaves the first alone
+    nvs_emul_reset_stats();
+    CHECK(mesh_storage_remove_subscription("onoff_srv", 0xC100 + MESH_STORAGE_SUB_CHUNK) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(nvs_emul_stats()->writes == 1);   // Chunk 1; chunk 2 is now empty and erased
+    CHECK(nvs_emul_stats()->erases == 1);
+    CHECK(!sub_chunk_exists(2, "onoff_srv"));
+
+    // An address below all others shifts every chunk, into a new third one
+    nvs_emul_reset_stats();
+    CHECK(mesh_storage_add_subscription("onoff_srv", 0xC000) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(nvs_emul_stats()->writes == 3);
+
+    uint16_t addrs[MESH_STORAGE_SUB_MAX];
+    CHECK(reboot() == ESP_OK);
+    CHECK(load_subs("onoff_srv", addrs) == (size_t)n + 1);
+    CHECK(addrs[0] == 0xC000 && addrs[n] == 0xC100 + n);
+}
+
+static void test_subscription_save_replaces_set(void)
+{
+    uint16_t in[] = { 0xC005, 0xC001, 0xC003, 0xC001 };
+    uint16_t addrs[MESH_STORAGE_SUB_MAX];
+
+    CHECK(mesh_storage_add_subscription("onoff_cli", 0xC009) == ESP_OK);
+    CHECK(mesh_storage_save_subscriptions("onoff_cli", in, 4) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(reboot() == ESP_OK);
+    CHECK(load_subs("onoff_cli", addrs) == 3);
+    CHECK(addrs[0] == 0xC001 && addrs[1] == 0xC003 && addrs[2] == 0xC005);
+
+    // The same set again is not a change
+    nvs_emul_reset_stats();
+    CHECK(mesh_storage_save_subscriptions("onoff_cli", in, 4) == ESP_OK);
+    CHECK(!esp_timer_emul_armed());
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(nvs_emul_stats()->writes == 0);
+
+    uint16_t too_many[MESH_STORAGE_SUB_MAX + 1];
+    for (int i = 0; i <= MESH_STORAGE_SUB_MAX; i++) {
+        too_many[i] = 0xC000 + i;
+    }
+    CHECK(mesh_storage_save_subscriptions("onoff_cli", too_many, MESH_STORAGE_SUB_MAX + 1) == ESP_ERR_NO_MEM);
+    CHECK(load_subs("onoff_cli", addrs) == 3);
+
+    CHECK(mesh_storage_save_subscriptions("onoff_cli", NULL, 0) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(!sub_chunk_exists(0, "onoff_cli"));
+}
+
+static void test_subscription_relayout(void)
+{
+    // One oversized, unsorted chunk as written with a different chunk size
+    uint16_t raw[MESH_STORAGE_SUB_CHUNK + 8];
+    size_t n = sizeof(raw) / sizeof(raw[0]);
+    for (size_t i = 0; i < n; i++) {
+        raw[i] = 0xC000 + n - 1 - i;
+    }
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    sub_key(0, "onoff_srv", key);
+    nvs_handle_t h;
+    CHECK(nvs_open(MESH_NVS_NAMESPACE, NVS_READWRITE, &h) == ESP_OK);
+    CHECK(nvs_set_blob(h, key, raw, sizeof(raw)) == ESP_OK);
+    CHECK(nvs_commit(h) == ESP_OK);
+    nvs_close(h);
+
+    uint16_t addrs[MESH_STORAGE_SUB_MAX];
+    CHECK(load_subs("onoff_srv", addrs) == n);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(sub_chunk_exists(1, "onoff_srv"));
+
+    CHECK(reboot() == ESP_OK);
+    nvs_emul_reset_stats();
+    CHECK(load_subs("onoff_srv", addrs) == n);
+    CHECK(addrs[0] == 0xC000);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(nvs_emul_stats()->writes == 0);
+}
+
+/* Fault injection */
+
+#else // CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+static void test_subscriptions_not_supported(void)
+{
+    uint16_t addr = 0xC001;
+    size_t count = 1;
+    CHECK(mesh_storage_add_subscription("onoff_srv", addr) == ESP_ERR_NOT_SUPPORTED);
+    CHECK(mesh_storage_remove_subscription("onoff_srv", addr) == ESP_ERR_NOT_SUPPORTED);
+    CHECK(mesh_storage_save_subscriptions("onoff_srv", &addr, 1) == ESP_ERR_NOT_SUPPORTED);
+    CHECK(mesh_storage_load_subscriptions("onoff_srv", &addr, 1, &count) == ESP_ERR_NOT_SUPPORTED);
+    CHECK(!mesh_storage_has_subscription("onoff_srv", addr));
+    CHECK(nvs_emul_stats()->writes == 0);
+}
+
+#endif // CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+static void test_partition_full_keeps_pending(void)
+{
+    mesh_prov_data_t in = sample_prov_data(), out;
+    mesh_model_binding_t binding = { .bound = true, .app_idx = 3 };
+
+    nvs_emul_set_capacity(4);
+    CHECK(mesh_storage_save_prov_data(&in) == ESP_OK);
+    CHECK(mesh_storage_save_model_binding("onoff_srv", &binding) == ESP_OK);
+    CHECK(mesh_storage_flush() == ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+
+    // Still served from RAM and still pending
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+    CHECK(prov_equal(&in, &out));
+
+    nvs_emul_set_capacity(NVS_EMUL_DEFAULT_CAPACITY);
+    CHECK(mesh_storage_flush() == ESP_OK);
+    CHECK(reboot() == ESP_OK);
+    CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+    CHECK(prov_equal(&in, &out));
+    CHECK(mesh_storage_load_model_binding("onoff_srv", &binding) == ESP_OK);
+    CHECK(binding.app_idx == 3);
+
+    nvs_stats_t stats;
+    CHECK(nvs_get_stats(NULL, &stats) == ESP_OK);
+    CHECK(stats.used_entries == nvs_emul_used_entries());
+    CHECK(stats.namespace_count == 1);
+}
+
+#if CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+static void test_power_cut_during_migration(void)
+{
+    mesh_prov_data_t in = sample_prov_data(), out;
+
+    // Cut the power after every possible number of flash operations
+    for (uint32_t cut = 0; ; cut++) {
+        nvs_emul_reset();
+        write_legacy_prov_data(&in);
+        CHECK(reboot() == ESP_OK);
+
+        nvs_emul_power_cut_after(cut);
+        CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+        bool lost = nvs_emul_power_lost();
+
+        CHECK(reboot() == ESP_OK);
+        memset(&out, 0, sizeof(out));
+        CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+        CHECK(prov_equal(&in, &out));
+
+        // Whatever was interrupted, the next boot finishes the migration
+        CHECK(reboot() == ESP_OK);
+        CHECK(!nvs_emul_exists(MESH_NVS_NAMESPACE, NVS_KEY_PROVISIONED));
+
+        if (!lost) {
+            break;
+        }
+    }
+}
+#endif
+
+static void test_power_cut_during_commit(void)
+{
+    const char *models[] = { "onoff_srv", "onoff_cli" };
+    mesh_prov_data_t old_prov = sample_prov_data(), new_prov = sample_prov_data(), out;
+    new_prov.iv_index = old_prov.iv_index + 1;
+
+    for (uint32_t cut = 0; ; cut++) {
+        // Committed configuration A
+        nvs_emul_reset();
+        CHECK(reboot() == ESP_OK);
+        CHECK(mesh_storage_save_prov_data(&old_prov) == ESP_OK);
+        for (int i = 0; i < 2; i++) {
+            mesh_model_binding_t binding = { .bound = true, .app_idx = 1 };
+            CHECK(mesh_storage_save_model_binding(models[i], &binding) == ESP_OK);
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+            CHECK(mesh_storage_add_subscription(models[i], 0xC001) == ESP_OK);
+#endif
+        }
+        CHECK(mesh_storage_flush() == ESP_OK);
+
+        // Configuration B, interrupted while committing
+        CHECK(mesh_storage_save_prov_data(&new_prov) == ESP_OK);
+        for (int i = 0; i < 2; i++) {
+            mesh_model_binding_t binding = { .bound = true, .app_idx = 2 };
+            CHECK(mesh_storage_save_model_binding(models[i], &binding) == ESP_OK);
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+            CHECK(mesh_storage_add_subscription(models[i], 0xC002) == ESP_OK);
+#endif
+        }
+        nvs_emul_power_cut_after(cut);
+        esp_err_t err = mesh_storage_flush();
+        bool lost = nvs_emul_power_lost();
+        CHECK(lost ? err != ESP_OK : err == ESP_OK);
+
+        // Every record reads back whole, as either A or B
+        CHECK(reboot() == ESP_OK);
+        CHECK(mesh_storage_load_prov_data(&out) == ESP_OK);
+        CHECK(out.iv_index == old_prov.iv_index || out.iv_index == new_prov.iv_index);
+        for (int i = 0; i < 2; i++) {
+            mesh_model_binding_t binding;
+            CHECK(mesh_storage_load_model_binding(models[i], &binding) == ESP_OK);
+            CHECK(binding.app_idx == 1 || binding.app_idx == 2);
+            CHECK(lost || binding.app_idx == 2);
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+            uint16_t addrs[4];
+            size_t count;
+            CHECK(mesh_storage_load_subscriptions(models[i], addrs, 4, &count) == ESP_OK);
+            CHECK(count == 1 || count == 2);
+            CHECK(addrs[0] == 0xC001);
+#endif
+        }
+
+        if (!lost) {
+            break;
+        }
+    }
+}
+
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+static bool subs_equal(const uint16_t *a, size_t a_count, const uint16_t *b, size_t b_count)
+{
+    return a_count == b_count && memcmp(a, b, a_count * sizeof(uint16_t)) == 0;
+}
+
+static void test_power_cut_during_subscription_change(void)
+{
+    // Set of 2.5 chunks; one add at the front and one removal at the front
+    const size_t n = 2 * MESH_STORAGE_SUB_CHUNK + MESH_STORAGE_SUB_CHUNK / 2;
+    uint16_t before[MESH_STORAGE_SUB_MAX], after[MESH_STORAGE_SUB_MAX], addrs[MESH_STORAGE_SUB_MAX];
+    for (size_t i = 0; i < n; i++) {
+        before[i] = 0xC010 + i;
+    }
+
+    for (int remove = 0; remove < 2; remove++) {
+        size_t after_count;
+        if (remove) {
+            memcpy(after, before + 1, (n - 1) * sizeof(uint16_t));
+            after_count = n - 1;
+        } else {
+            after[0] = 0xC000;
+            memcpy(after + 1, before, n * sizeof(uint16_t));
+            after_count = n + 1;
+        }
+
+        for (uint32_t cut = 0; ; cut++) {
+            nvs_emul_reset();
+            CHECK(reboot() == ESP_OK);
+            CHECK(mesh_storage_save_subscriptions("onoff_srv", before, n) == ESP_OK);
+            CHECK(mesh_storage_flush() == ESP_OK);
+
+            if (remove) {
+                CHECK(mesh_storage_remove_subscription("onoff_srv", before[0]) == ESP_OK);
+            } else {
+                CHECK(mesh_storage_add_subscription("onoff_srv", 0xC000) == ESP_OK);
+            }
+            nvs_emul_power_cut_after(cut);
+            esp_err_t err = mesh_storage_flush();
+            bool lost = nvs_emul_power_lost();
+            CHECK(lost ? err != ESP_OK : err == ESP_OK);
+
+            // The old or the new set, never a mix
+            CHECK(reboot() == ESP_OK);
+            size_t count = load_subs("onoff_srv", addrs);
+            CHECK(subs_equal(addrs, count, before, n) || subs_equal(addrs, count, after, after_count));
+            CHECK(lost || subs_equal(addrs, count, after, after_count));
+
+            // A repaired set is written back whole and reads back unchanged
+            CHECK(mesh_storage_flush() == ESP_OK);
+            CHECK(reboot() == ESP_OK);
+            uint16_t again[MESH_STORAGE_SUB_MAX];
+            CHECK(subs_equal(again, load_subs("onoff_srv", again), addrs, count));
+
+            if (!lost) {
+                break;
+            }
+        }
+    }
+}
+
+#endif // CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+
+int main(void)
+{
+    printf("mesh_storage host tests (%s)\n", MESH_STORAGE_VARIANT);
+
+    RUN(test_prov_roundtrip);
+    RUN(test_prov_not_provisioned);
+#if CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+    RUN(test_prov_legacy_migration);
+    RUN(test_prov_legacy_unprovisioned_not_migrated);
+#else
+    RUN(test_prov_legacy_keys_ignored);
+#endif
+    RUN(test_prov_interrupted_migration);
+    RUN(test_prov_corrupt_blob_rejected);
+    RUN(test_prov_bad_size_and_version_rejected);
+    RUN(test_prov_clear);
+    RUN(test_saves_wait_for_quiet_period);
+    RUN(test_config_storm_single_commit);
+    RUN(test_flush_before_restart);
+    RUN(test_model_cache_eviction);
+    RUN(test_model_id_too_long);
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+    RUN(test_subscription_add_remove);
+    RUN(test_subscription_many_groups);
+    RUN(test_subscription_rewrites_changed_chunks);
+    RUN(test_subscription_save_replaces_set);
+    RUN(test_subscription_relayout);
+#else
+    RUN(test_subscriptions_not_supported);
+#endif
+    RUN(test_partition_full_keeps_pending);
+#if CONFIG_MESH_STORAGE_LEGACY_MIGRATION
+    RUN(test_power_cut_during_migration);
+#endif
+    RUN(test_power_cut_during_commit);
+#if CONFIG_MESH_STORAGE_SUBSCRIPTIONS
+    RUN(test_power_cut_during_subscription_change);
+#endif
+
+    printf("%d failure(s)\n", s_failures);
+    return s_failures == 0 ? 0 : 1;
+}